@@ -0,0 +1,119 @@
+/*
+ * BSD Zero Clause License
+ *
+ * Copyright (c) 2025 David M Crumpton david.m.crumpton [at] gmail [dot] com
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * alias.c: building alias tables with Vose's method. The weights are
+ * scaled so the average column is exactly full; columns short of full are
+ * topped up from one that is over, which then gives up that much and
+ * joins the short ones if it falls below full itself.
+ *
+ */
+#include <math.h>
+
+#include "alias.h"
+#include "rng.h"
+
+
+static uint32_t
+threshold(double fill)
+{
+	double		t = ldexp(fill, 32);
+
+	if (t <= 0)
+		return 0;
+	return t >= UINT32_MAX ? UINT32_MAX : (uint32_t)t;
+}
+
+/*
+ * Build a from n weights, none negative and not all 0. An outcome of
+ * weight 0 is never drawn. Returns -1 on a bad table.
+ */
+int
+alias_init(struct alias * a, const double *weight, int n)
+{
+	double		scaled[ALIAS_MAX], total = 0;
+	int		small[ALIAS_MAX], large[ALIAS_MAX];
+	int		nsmall = 0, nlarge = 0;
+
+	if (n < 1 || n > ALIAS_MAX)
+		return -1;
+	for (int i = 0; i < n; i++) {
+		if (!(weight[i] >= 0) || isinf(weight[i]))
+			return -1;
+		total += weight[i];
+	}
+	if (!(total > 0))
+		return -1;
+
+	a->n = n;
+	for (int i = 0; i < n; i++) {
+		scaled[i] = weight[i] * n / total;
+		if (scaled[i] < 1)
+			small[nsmall++] = i;
+		else
+			large[nlarge++] = i;
+	}
+	while (nsmall > 0 && nlarge > 0) {
+		int		s = small[--nsmall], l = large[nlarge - 1];
+
+		a->prob[s] = threshold(scaled[s]);
+		a->alias[s] = (uint8_t)l;
+		scaled[l] -= 1 - scaled[s];
+		if (scaled[l] < 1) {
+			nlarge--;
+			small[nsmall++] = l;
+		}
+	}
+	/* Whatever is left is full, give or take rounding */
+	while (nlarge > 0) {
+		int		l = large[--nlarge];
+
+		a->prob[l] = UINT32_MAX;
+		a->alias[l] = (uint8_t)l;
+	}
+	while (nsmall > 0) {
+		int		s = small[--nsmall];
+
+		a->prob[s] = UINT32_MAX;
+		a->alias[s] = (uint8_t)s;
+	}
+	return 0;
+}
+
+/* The chance a draw from a comes out i, as the table holds it */
+double
+alias_probability(const struct alias * a, int i)
+{
+	double		p = 0;
+
+	for (int c = 0; c < a->n; c++) {
+		double		keep = a->alias[c] == c ? 1 : ldexp(a->prob[c], -32);
+
+		if (c == i)
+			p += keep;
+		if (a->alias[c] == i && a->alias[c] != c)
+			p += 1 - keep;
+	}
+	return p / a->n;
+}
+
+/* One draw from the calling thread's stream */
+int
+alias_draw(const struct alias * a)
+{
+	return alias_pick(a, rng_word());
+}
@@ -0,0 +1,71 @@
+/*
+ * BSD Zero Clause License
+ *
+ * Copyright (c) 2025 David M Crumpton david.m.crumpton [at] gmail [dot] com
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * alias.h: Walker's alias method, drawing from any table of weights in
+ * constant time
+ *
+ */
+
+#ifndef ALIAS_H
+#define ALIAS_H
+
+#include <stdint.h>
+
+#define ALIAS_MAX	128	/* weights in one table */
+
+/*
+ * Each of the n columns holds its own outcome up to prob (out of 2^32)
+ * and alias above it, so a draw is one multiply, one compare and one
+ * load whatever the weights.
+ */
+struct alias {
+	int		n;
+	uint32_t	prob[ALIAS_MAX];
+	uint8_t		alias[ALIAS_MAX];
+};
+
+int		alias_init(struct alias * a, const double *weight, int n);
+double		alias_probability(const struct alias * a, int i);
+int		alias_draw(const struct alias * a);
+
+/*
+ * The outcome for a uniform 32 bit word: the high half of u * n picks the
+ * column and the low half is where in it u fell
+ */
+static inline int
+alias_pick(const struct alias * a, uint32_t u)
+{
+	uint64_t	m = (uint64_t)u * (uint32_t)a->n;
+	uint32_t	col = (uint32_t)(m >> 32);
+
+	return (uint32_t)m < a->prob[col] ? (int)col : a->alias[col];
+}
+
+/* Spread a key over all 32 bits for alias_pick(), after MurmurHash3 */
+static inline uint32_t
+alias_mix(uint32_t h)
+{
+	h ^= h >> 16;
+	h *= 0x85ebca6bU;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35U;
+	h ^= h >> 16;
+	return h;
+}
+
+#endif				/* ALIAS_H */
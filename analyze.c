@@ -0,0 +1,347 @@
+/*
+ * BSD Zero Clause License
+ *
+ * Copyright (c) 2025 David M Crumpton david.m.crumpton [at] gmail [dot] com
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * analyze.c: exact outcome distributions without playing sampled games.
+ *
+ * Once the tool and species are dealt, a policy that picks each stroke
+ * from the fang's health alone turns every fang into its own small Markov
+ * chain over health 0..MAX_HEALTH with one successor per state. The
+ * chains only meet through the shared fluoride, so each dealt health is
+ * walked once into a fang trajectory: the round it comes clean and the
+ * fluoride it has drawn after every round. The deal distribution is then
+ * swept over the 32^NUM_FANGS health combinations with nonzero probability
+ * (a million for the four canines; more teeth soon make it impractical), and
+ * each combination's end, the round where the fluoride runs short or the
+ * last fang comes clean, is found from the trajectories.
+ *
+ */
+#include <err.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "analyze.h"
+#include "buffy.h"
+#include "engine.h"
+#include "policy.h"
+#include "pool.h"
+#include "simulate.h"
+#include "tables.h"
+
+#define NEVER		(SIM_MAX_TURNS + 1)	/* a fang that stops short of clean */
+
+/* One dealt health followed round by round */
+struct fang_path {
+	double		p;	/* chance a fang is dealt this health */
+	int		clean;	/* round it reaches MAX_HEALTH, 0 if dealt clean */
+	int		drawn[SIM_MAX_TURNS + 1];	/* fluoride after each round */
+};
+
+struct analyze_job {
+	const struct policy_config *cfg;
+	struct analysis *a;
+};
+
+
+/*
+ * Follow every dealt health through the policy's strokes. Returns how
+ * many healths the deal can produce.
+ */
+static int
+build_paths(const struct policy_config * cfg, int tool_idx, int species, struct fang_path * paths)
+{
+	struct policy  *p = cfg != NULL ? policy_new(cfg) : NULL;
+	game_state_type	state;
+	patient_type	pat;
+	double		pmf[MAX_HEALTH + 1];
+	int		used[MAX_HEALTH + 1], next[MAX_HEALTH + 1];
+	int		dip, effort, n = 0;
+
+	memset(&state, 0, sizeof(state));
+	memset(&pat, 0, sizeof(pat));
+	state.tool_in_use = tool_idx;
+	state.patient_idx = species;
+	state.fluoride = DEFAULT_FLUORIDE;
+	for (int h = 0; h < MAX_HEALTH; h++) {
+		pat.fangs[0].health = h;
+		if (p != NULL)
+			policy_choose(p, &state, &pat, 0, &dip, &effort);
+		else
+			sim_scripted_input(&state, &pat, 0, &dip, &effort);
+		used[h] = TBL_FLUORIDE_USED(tool_idx, dip);
+		next[h] = tbl_clamp(h + fang_health_gain(&state, used[h], effort), MAX_HEALTH);
+	}
+	used[MAX_HEALTH] = 0;
+	next[MAX_HEALTH] = MAX_HEALTH;
+	policy_free(p);
+
+	engine_health_pmf(pmf);
+	for (int h0 = 0; h0 <= MAX_HEALTH; h0++) {
+		struct fang_path *fp = &paths[n];
+		int		h = h0;
+
+		if (pmf[h0] == 0)
+			continue;
+		fp->p = pmf[h0];
+		fp->clean = h0 == MAX_HEALTH ? 0 : NEVER;
+		fp->drawn[0] = 0;
+		for (int r = 1; r <= SIM_MAX_TURNS; r++) {
+			fp->drawn[r] = fp->drawn[r - 1] + used[h];
+			h = next[h];
+			if (h == MAX_HEALTH && fp->clean == NEVER)
+				fp->clean = r;
+		}
+		n++;
+	}
+	return n;
+}
+
+static void
+absorb(struct analyze_cell * out, double *outcome, double p, int turns, int score, int fluoride)
+{
+	*outcome += p;
+	out->score += p * score;
+	out->turns += p * turns;
+	out->fluoride += p * fluoride;
+	out->turn_pmf[turns] += p;
+}
+
+/* Strokes and bonuses from the first rounds rounds of play */
+static int
+score_after(const struct fang_path * const fp[NUM_FANGS], int rounds)
+{
+	int		score = DEFAULT_SCORE + rounds * BONUS_TURN_COMPLETE;
+
+	for (int f = 0; f < NUM_FANGS; f++) {
+		score += (fp[f]->clean < rounds ? fp[f]->clean : rounds) * BONUS_FANG_CLEANED;
+		if (fp[f]->clean > 0 && fp[f]->clean <= rounds)
+			score += BONUS_FANG_HEALTH;
+	}
+	return score;
+}
+
+static int
+drawn_after(const struct fang_path * const fp[NUM_FANGS], int rounds)
+{
+	int		drawn = fp[0]->drawn[rounds];
+
+	for (int f = 1; f < NUM_FANGS; f++)
+		drawn += fp[f]->drawn[rounds];
+	return drawn;
+}
+
+/* Play one dealt combination out from the fang paths */
+static void
+weigh_deal(const struct fang_path * const fp[NUM_FANGS], struct analyze_cell * out)
+{
+	double		p = 1.0;
+	int		last = 0, lo, hi, left, score;
+
+	for (int f = 0; f < NUM_FANGS; f++) {
+		p *= fp[f]->p;
+		if (fp[f]->clean > last)
+			last = fp[f]->clean;
+	}
+
+	/* Fluoride is only ever drawn, so a win is enough of it in total */
+	if (last < NEVER && drawn_after(fp, last) <= DEFAULT_FLUORIDE) {
+		if (last == 0)
+			last = 1;	/* a clean deal still plays out an empty round */
+		absorb(out, &out->win, p, DEFAULT_TURNS + last,
+		       score_after(fp, last) + BONUS_ALL_HEALTH, DEFAULT_FLUORIDE - drawn_after(fp, last));
+		return;
+	}
+	if (drawn_after(fp, SIM_MAX_TURNS) <= DEFAULT_FLUORIDE) {
+		absorb(out, &out->stalled, p, SIM_MAX_TURNS + 1, score_after(fp, SIM_MAX_TURNS),
+		       DEFAULT_FLUORIDE - drawn_after(fp, SIM_MAX_TURNS));
+		return;
+	}
+
+	/* First round that cannot be paid for in full */
+	for (lo = 1, hi = SIM_MAX_TURNS; lo < hi;) {
+		int		mid = (lo + hi) / 2;
+
+		if (drawn_after(fp, mid) > DEFAULT_FLUORIDE)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+	left = DEFAULT_FLUORIDE - drawn_after(fp, lo - 1);
+	score = score_after(fp, lo - 1);
+	for (int f = 0; f < NUM_FANGS; f++) {
+		int		cost = fp[f]->drawn[lo] - fp[f]->drawn[lo - 1];
+
+		if (fp[f]->clean < lo)
+			continue;
+		if (cost > left)
+			break;
+		left -= cost;
+		score += BONUS_FANG_CLEANED;
+		if (fp[f]->clean == lo)
+			score += BONUS_FANG_HEALTH;
+	}
+	absorb(out, &out->no_fluoride, p, DEFAULT_TURNS + lo - 1, score, left);
+}
+
+void
+analyze_cell(const struct policy_config * cfg, int tool_idx, int species, struct analyze_cell * out)
+{
+	const struct fang_path *fp[NUM_FANGS];
+	struct fang_path *paths;
+	int		idx[NUM_FANGS], n, f;
+
+	memset(out, 0, sizeof(*out));
+	out->tool_idx = tool_idx;
+	out->species = species;
+	if ((paths = malloc((MAX_HEALTH + 1) * sizeof(*paths))) == NULL)
+		err(1, "analyzer");
+	n = build_paths(cfg, tool_idx, species, paths);
+
+	/*
+	 * Every combination of paths, counting with the last fang fastest
+	 * and running it in a loop of its own
+	 */
+	for (f = 0; f < NUM_FANGS; f++) {
+		idx[f] = 0;
+		fp[f] = &paths[0];
+	}
+	for (f = 0; n > 0 && f >= 0;) {
+		for (int i = 0; i < n; i++) {
+			fp[NUM_FANGS - 1] = &paths[i];
+			weigh_deal(fp, out);
+		}
+		for (f = NUM_FANGS - 2; f >= 0 && ++idx[f] == n; f--) {
+			idx[f] = 0;
+			fp[f] = &paths[0];
+		}
+		if (f >= 0)
+			fp[f] = &paths[idx[f]];
+	}
+	free(paths);
+}
+
+static void
+analyze_worker(void *arg, int worker, uint64_t lo, uint64_t hi)
+{
+	struct analyze_job *job = arg;
+
+	(void)worker;
+	for (uint64_t c = lo; c < hi; c++) {
+		int		t = (int)(c / NUM_PATIENTS), s = (int)(c % NUM_PATIENTS);
+
+		analyze_cell(job->cfg, t, s, &job->a->cells[t][s]);
+	}
+}
+
+/*
+ * Every (tool, species) cell, one cell per pool item. Only policies that
+ * pick a stroke from the fang's health alone fit the model, so the
+ * scripted hygienist (cfg NULL) and the optimal table are accepted.
+ */
+void
+analyze_all(const struct policy_config * cfg, int nthreads, struct analysis * a)
+{
+	struct analyze_job job = {cfg, a};
+	struct timespec	start, end;
+
+	if (cfg != NULL && strcmp(cfg->name, "scripted") != 0 && strcmp(cfg->name, "optimal") != 0)
+		errx(1, "the analyzer needs a policy that only looks at fang health, "
+		     "scripted or optimal");
+	memset(a, 0, sizeof(*a));
+	a->policy = cfg != NULL ? cfg->name : "scripted";
+	a->threads = nthreads < 1 ? 1 : nthreads;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	pool_run(a->threads, NUM_TOOLS * NUM_PATIENTS, 1, analyze_worker, &job);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	a->elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+/* The cells weighted by how often choose_random_tool() and patient_init() deal them */
+void
+analyze_overall(const struct analysis * a, int daggerset, struct analyze_cell * out)
+{
+	const double   *tw = tool_weight[daggerset != 0];
+	double		tools_total = 0, patients_total = 0;
+
+	for (int t = 0; t < NUM_TOOLS; t++)
+		tools_total += tw[t];
+	for (int s = 0; s < NUM_PATIENTS; s++)
+		patients_total += patient_weight[s];
+
+	memset(out, 0, sizeof(*out));
+	out->tool_idx = out->species = -1;
+	for (int t = 0; t < NUM_TOOLS; t++)
+		for (int s = 0; s < NUM_PATIENTS; s++) {
+			const struct analyze_cell *c = &a->cells[t][s];
+			double		w = tw[t] / tools_total * patient_weight[s] / patients_total;
+
+			if (w == 0)
+				continue;
+
+			out->win += w * c->win;
+			out->no_fluoride += w * c->no_fluoride;
+			out->stalled += w * c->stalled;
+			out->score += w * c->score;
+			out->turns += w * c->turns;
+			out->fluoride += w * c->fluoride;
+			for (int k = 0; k < ANALYZE_TURNS; k++)
+				out->turn_pmf[k] += w * c->turn_pmf[k];
+		}
+}
+
+/* Turn counts that carry at least a tenth of a percent, with their share */
+static void
+print_turns(const struct analyze_cell * c, FILE * out)
+{
+	int		shown = 0;
+
+	fprintf(out, "    turns:");
+	for (int k = 0; k < ANALYZE_TURNS; k++)
+		if (c->turn_pmf[k] >= 0.001) {
+			fprintf(out, " %d=%.1f%%", k, 100 * c->turn_pmf[k]);
+			shown++;
+		}
+	if (shown == 0)
+		fprintf(out, " spread thin");
+	fprintf(out, "\n");
+}
+
+void
+print_analysis(const struct analysis * a, int daggerset, FILE * out)
+{
+	struct analyze_cell all;
+	int		first = daggerset ? 3 : 0;
+
+	fprintf(out, "Exact outcomes of the %s policy, %d cells in %.3f s on %d thread%s\n",
+		a->policy, NUM_TOOLS * NUM_PATIENTS, a->elapsed, a->threads, a->threads == 1 ? "" : "s");
+	fprintf(out, "%-20s %-10s %8s %8s %8s %9s %7s %8s\n", "Tool", "Species",
+		"Win", "Out", "Stalled", "Score", "Turns", "Fluoride");
+	for (int t = first; t < first + 3; t++)
+		for (int s = 0; s < NUM_PATIENTS; s++) {
+			const struct analyze_cell *c = &a->cells[t][s];
+
+			fprintf(out, "%-20s %-10s %7.2f%% %7.2f%% %7.2f%% %9.2f %7.2f %8.2f\n",
+				tools[t].name, patients[s].species, 100 * c->win, 100 * c->no_fluoride,
+				100 * c->stalled, c->score, c->turns, c->fluoride);
+			print_turns(c, out);
+		}
+	analyze_overall(a, daggerset, &all);
+	fprintf(out, "%-31s %7.2f%% %7.2f%% %7.2f%% %9.2f %7.2f %8.2f\n", "All deals",
+		100 * all.win, 100 * all.no_fluoride, 100 * all.stalled, all.score, all.turns, all.fluoride);
+	print_turns(&all, out);
+}
@@ -0,0 +1,60 @@
+/*
+ * BSD Zero Clause License
+ *
+ * Copyright (c) 2025 David M Crumpton david.m.crumpton [at] gmail [dot] com
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * analyze.h: exact outcome probabilities for a policy, from the deal
+ * distribution instead of sampled games
+ *
+ */
+
+#ifndef ANALYZE_H
+#define ANALYZE_H
+
+#include <stdio.h>
+
+#include "buffy.h"
+#include "engine.h"
+#include "policy.h"
+#include "simulate.h"
+
+#define ANALYZE_TURNS	(SIM_MAX_TURNS + 2)	/* final turn counts 0..SIM_MAX_TURNS + 1 */
+
+struct analyze_cell {
+	int		tool_idx;
+	int		species;
+	double		win;
+	double		no_fluoride;
+	double		stalled;
+	double		score;	/* expected final score */
+	double		turns;	/* expected final turn count */
+	double		fluoride;	/* expected fluoride left */
+	double		turn_pmf[ANALYZE_TURNS];
+};
+
+struct analysis {
+	struct analyze_cell cells[NUM_TOOLS][NUM_PATIENTS];
+	const char     *policy;
+	double		elapsed;
+	int		threads;
+};
+
+void		analyze_cell(const struct policy_config * cfg, int tool_idx, int species, struct analyze_cell * out);
+void		analyze_all(const struct policy_config * cfg, int nthreads, struct analysis * a);
+void		analyze_overall(const struct analysis * a, int daggerset, struct analyze_cell * out);
+void		print_analysis(const struct analysis * a, int daggerset, FILE * out);
+
+#endif				/* ANALYZE_H */
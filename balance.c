@@ -0,0 +1,506 @@
+/*
+ * BSD Zero Clause License
+ *
+ * Copyright (c) 2025 David M Crumpton david.m.crumpton [at] gmail [dot] com
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * balance.c: a sweep of sampled games over every tool and species pair.
+ * The games are split evenly between the pairs, each one dealt fresh fangs
+ * from its own stream and then handed the pair's tool and patient, so a
+ * seed gives the same tables on any number of threads. With a store, a
+ * pair whose inputs have not changed since the last sweep is read back
+ * instead of played, and the games of the pairs that are played keep the
+ * streams a full sweep would have given them.
+ *
+ */
+#include <sys/stat.h>
+
+#include <err.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "balance.h"
+#include "buffy.h"
+#include "engine.h"
+#include "gamestate.h"
+#include "policy.h"
+#include "pool.h"
+#include "rng.h"
+#include "simulate.h"
+#include "solver.h"
+#include "tables.h"
+
+#define NUM_CELLS	(NUM_TOOLS * NUM_PATIENTS)
+
+/* Each worker counts into its own copy of the table */
+struct balance_shard {
+	_Alignas(CACHE_LINE) struct balance_cell cells[NUM_TOOLS][NUM_PATIENTS];
+	struct rng	rng;
+	struct policy  *policy;
+};
+
+struct balance_job {
+	struct balance_shard *shards;
+	const struct policy_config *cfg;
+	int		stale[NUM_CELLS];	/* the pairs to play */
+	long		per_cell;
+	uint64_t	seed;
+};
+
+struct balance_store {
+	struct balance_record *records;
+	uint32_t	count;
+};
+
+
+static int
+bin(long v, int width, int nbins)
+{
+	v /= width;
+	if (v < 0)
+		return 0;
+	return v >= nbins ? nbins - 1 : (int)v;
+}
+
+static void
+balance_tally(struct balance_cell * c, int outcome, const game_state_type * state)
+{
+	switch (outcome) {
+	case SIM_WIN:
+		c->wins++;
+		break;
+	case SIM_NO_FLUORIDE:
+		c->no_fluoride++;
+		break;
+	default:
+		c->stalled++;
+	}
+	c->games++;
+	c->score_sum += state->score;
+	c->turns_sum += state->turns;
+	c->fluoride_sum += state->fluoride;
+	c->score_hist[bin(state->score, BALANCE_SCORE_BIN, BALANCE_SCORE_BINS)]++;
+	c->fluoride_hist[bin(state->fluoride, BALANCE_FLUORIDE_BIN, BALANCE_FLUORIDE_BINS)]++;
+}
+
+static void
+balance_worker(void *arg, int worker, uint64_t lo, uint64_t hi)
+{
+	struct balance_job *job = arg;
+	struct balance_shard *shard = &job->shards[worker];
+	game_state_type	state;
+	patient_type	pat;
+
+	if (job->cfg != NULL && shard->policy == NULL)
+		shard->policy = policy_new(job->cfg);
+
+	rng_set_stream(&shard->rng);
+	for (uint64_t i = lo; i < hi; i++) {
+		int		cell = job->stale[i / (uint64_t)job->per_cell];
+		int		t = cell / NUM_PATIENTS, s = cell % NUM_PATIENTS;
+		uint64_t	g = (uint64_t)cell * job->per_cell + i % (uint64_t)job->per_cell;
+
+		rng_seed(&shard->rng, job->seed, g);
+		memset(&state, 0, sizeof(state));
+		memset(&pat, 0, sizeof(pat));
+		engine_init_state(&state);
+		patient_init(&state, &pat);
+		state.tool_in_use = t;
+		state.patient_idx = s;
+		pat.age = patients[s].age;
+		pat.patience = patients[s].patience;
+		balance_tally(&shard->cells[t][s], sim_play_dealt(&state, &pat, shard->policy), &state);
+	}
+	rng_set_stream(NULL);
+}
+
+void
+balance_merge_cell(struct balance_cell * into, const struct balance_cell * from)
+{
+	into->games += from->games;
+	into->wins += from->wins;
+	into->no_fluoride += from->no_fluoride;
+	into->stalled += from->stalled;
+	into->score_sum += from->score_sum;
+	into->turns_sum += from->turns_sum;
+	into->fluoride_sum += from->fluoride_sum;
+	for (int i = 0; i < BALANCE_SCORE_BINS; i++)
+		into->score_hist[i] += from->score_hist[i];
+	for (int i = 0; i < BALANCE_FLUORIDE_BINS; i++)
+		into->fluoride_hist[i] += from->fluoride_hist[i];
+}
+
+static uint64_t
+mix(uint64_t h, long long v)
+{
+	for (size_t i = 0; i < sizeof(v); i++) {
+		h ^= (uint64_t)(v >> (i * 8)) & 0xff;
+		h *= 0x100000001b3ULL;
+	}
+	return h;
+}
+
+/*
+ * Hash everything one pair's games depend on: the rules' constants, the
+ * pair's rows of the turn tables (which carry the tool's stats and the
+ * species' modifier), how many fangs are dealt and how, the policy and
+ * which games the sweep deals it.
+ */
+uint64_t
+balance_fingerprint(const struct policy_config * cfg, int tool_idx, int species, long per_cell, uint64_t seed,
+		    int nfangs)
+{
+	const tool     *t = &tools[tool_idx];
+	uint64_t	h = 0xcbf29ce484222325ULL;
+	const char     *name = cfg != NULL ? cfg->name : "scripted";
+
+	h = mix(h, MAJOR);
+	h = mix(h, MINOR);
+	h = mix(h, PATCH);
+	h = mix(h, DEFAULT_FLUORIDE);
+	h = mix(h, DEFAULT_SCORE);
+	h = mix(h, DEFAULT_TURNS);
+	h = mix(h, BONUS_ALL_HEALTH);
+	h = mix(h, BONUS_FANG_CLEANED);
+	h = mix(h, BONUS_FANG_HEALTH);
+	h = mix(h, BONUS_TURN_COMPLETE);
+	h = mix(h, MAX_HEALTH);
+	h = mix(h, nfangs);
+	h = mix(h, SIM_MAX_TURNS);
+	h = mix(h, (long long)seed);
+	h = mix(h, per_cell);
+	h = mix(h, tool_idx);
+	h = mix(h, species);
+
+	h = mix(h, t->length);
+	h = mix(h, t->dip_amount);
+	h = mix(h, t->effort);
+	h = mix(h, t->pain_factor);
+	h = mix(h, patients[species].age);
+	h = mix(h, patients[species].patience);
+	for (int e = 0; e < TBL_EFFORT; e++)
+		for (int f = 0; f < TBL_FLUORIDE; f++)
+			h = mix(h, TBL_GAIN(tool_idx, species, f, e));
+	for (int d = 0; d < TBL_DIP; d++)
+		h = mix(h, TBL_FLUORIDE_USED(tool_idx, d));
+	for (int b = 0; b < NUM_HEALTH_BUCKETS; b++) {
+		long long	weight;
+
+		memcpy(&weight, &health_buckets[b].weight, sizeof(weight));
+		h = mix(h, health_buckets[b].lo);
+		h = mix(h, health_buckets[b].hi);
+		h = mix(h, weight);
+	}
+
+	for (const char *c = name; *c != '\0'; c++)
+		h = mix(h, *c);
+	if (cfg != NULL && cfg->table != NULL && strcmp(name, "optimal") == 0)
+		for (int hl = 0; hl <= MAX_HEALTH; hl++) {
+			const struct solver_entry *e = solver_entry(cfg->table, tool_idx, species, hl);
+
+			h = mix(h, e->cost << 16 | e->strokes << 8 | e->action);
+		}
+	if (cfg != NULL && strcmp(name, "mcts") == 0) {
+		h = mix(h, cfg->budget_us);
+		h = mix(h, cfg->nodes);
+	}
+	return h;
+}
+
+/* A missing store is an empty one; either has room for a sweep's pairs */
+static int
+store_load(const char *path, struct balance_store * st)
+{
+	struct balance_store_header hdr;
+	struct stat	sb;
+	FILE	       *fp;
+
+	memset(st, 0, sizeof(*st));
+	if ((fp = fopen(path, "rb")) == NULL) {
+		if (errno != ENOENT) {
+			warn("%s", path);
+			return -1;
+		}
+		if ((st->records = calloc(NUM_CELLS, sizeof(*st->records))) == NULL)
+			err(1, "balance store");
+		return 0;
+	}
+	if (fread(&hdr, sizeof(hdr), 1, fp) != 1 || hdr.magic != BALANCE_STORE_MAGIC ||
+	    hdr.version != BALANCE_STORE_VERSION || hdr.cell_size != sizeof(struct balance_cell)) {
+		warnx("%s is not a balance store for this version", path);
+		fclose(fp);
+		return -1;
+	}
+	/* Trust the count only as far as the file can hold that many records */
+	if (fstat(fileno(fp), &sb) == -1) {
+		warn("%s", path);
+		fclose(fp);
+		return -1;
+	}
+	if ((uint64_t)hdr.count > ((uint64_t)sb.st_size - sizeof(hdr)) / sizeof(*st->records)) {
+		warnx("%s is truncated", path);
+		fclose(fp);
+		return -1;
+	}
+	if ((st->records = calloc(hdr.count + NUM_CELLS, sizeof(*st->records))) == NULL)
+		err(1, "balance store");
+	if (fread(st->records, sizeof(*st->records), hdr.count, fp) != hdr.count) {
+		warnx("%s is truncated", path);
+		fclose(fp);
+		free(st->records);
+		return -1;
+	}
+	st->count = hdr.count;
+	fclose(fp);
+	return 0;
+}
+
+static struct balance_record *
+store_find(struct balance_store * st, const char *policy, int tool_idx, int species)
+{
+	for (uint32_t i = 0; i < st->count; i++) {
+		struct balance_record *r = &st->records[i];
+
+		if (r->tool_idx == tool_idx && r->species == species &&
+		    strncmp(r->policy, policy, sizeof(r->policy)) == 0)
+			return r;
+	}
+	return NULL;
+}
+
+/* Written beside the store and renamed over it, like the solver's table */
+static int
+store_save(const char *path, const struct balance_store * st)
+{
+	struct balance_store_header hdr;
+	char		tmp[FILENAME_MAX];
+	FILE	       *fp;
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = BALANCE_STORE_MAGIC;
+	hdr.version = BALANCE_STORE_VERSION;
+	hdr.cell_size = sizeof(struct balance_cell);
+	hdr.count = st->count;
+	snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+	if ((fp = fopen(tmp, "wb")) == NULL) {
+		warn("%s", tmp);
+		return -1;
+	}
+	if (fwrite(&hdr, sizeof(hdr), 1, fp) != 1 ||
+	    fwrite(st->records, sizeof(*st->records), st->count, fp) != st->count) {
+		warn("write %s", tmp);
+		fclose(fp);
+		remove(tmp);
+		return -1;
+	}
+	if (fclose(fp) == EOF || rename(tmp, path) == -1) {
+		warn("%s", path);
+		remove(tmp);
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Play ngames, rounded up to a multiple of the tool and species pairs,
+ * with the scripted hygienist when cfg is NULL. Pairs found in store with
+ * a matching fingerprint are not played again, and the store is brought
+ * up to date afterwards. Returns -1 if the store cannot be used.
+ */
+int
+balance_sweep(const struct policy_config * cfg, long ngames, int nthreads, const char *store, struct balance * b)
+{
+	struct balance_job job;
+	struct balance_store st;
+	struct timespec	start, end;
+	const char     *policy = cfg != NULL ? cfg->name : "scripted";
+	int		nstale = 0, rv = 0;
+
+	if (nthreads < 1)
+		nthreads = 1;
+	memset(b, 0, sizeof(*b));
+	memset(&st, 0, sizeof(st));
+	if (store != NULL && store_load(store, &st) == -1)
+		return -1;
+	job.cfg = cfg;
+	job.per_cell = (ngames + NUM_CELLS - 1) / NUM_CELLS;
+	job.seed = rng_get_seed();
+
+	for (int t = 0; t < NUM_TOOLS; t++)
+		for (int s = 0; s < NUM_PATIENTS; s++) {
+			struct balance_record *r = store != NULL ? store_find(&st, policy, t, s) : NULL;
+
+			b->fingerprint[t][s] = balance_fingerprint(cfg, t, s, job.per_cell, job.seed, NUM_FANGS);
+			if (r != NULL && r->fingerprint == b->fingerprint[t][s]) {
+				b->cells[t][s] = r->cell;
+				b->reused++;
+			} else
+				job.stale[nstale++] = t * NUM_PATIENTS + s;
+		}
+
+	if ((job.shards = aligned_alloc(CACHE_LINE, sizeof(*job.shards) * nthreads)) == NULL)
+		err(1, "balance shards");
+	memset(job.shards, 0, sizeof(*job.shards) * nthreads);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	pool_run(nthreads, (uint64_t)job.per_cell * nstale, SIM_CHUNK, balance_worker, &job);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	for (int i = 0; i < nthreads; i++) {
+		for (int t = 0; t < NUM_TOOLS; t++)
+			for (int s = 0; s < NUM_PATIENTS; s++)
+				balance_merge_cell(&b->cells[t][s], &job.shards[i].cells[t][s]);
+		policy_free(job.shards[i].policy);
+	}
+	free(job.shards);
+	b->games_per_cell = job.per_cell;
+	b->played = job.per_cell * nstale;
+	b->seed = job.seed;
+	b->policy = policy;
+	b->threads = nthreads;
+	b->elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+	if (store != NULL && nstale > 0) {
+		for (int i = 0; i < nstale; i++) {
+			int		t = job.stale[i] / NUM_PATIENTS, s = job.stale[i] % NUM_PATIENTS;
+			struct balance_record *r = store_find(&st, policy, t, s);
+
+			if (r == NULL) {
+				r = &st.records[st.count++];
+				memset(r, 0, sizeof(*r));
+				strlcpy(r->policy, policy, sizeof(r->policy));
+				r->tool_idx = t;
+				r->species = s;
+			}
+			r->fingerprint = b->fingerprint[t][s];
+			r->cell = b->cells[t][s];
+		}
+		rv = store_save(store, &st);
+	}
+	free(st.records);
+	return rv;
+}
+
+/* Lower edge of the bin holding the q-th fraction of the games */
+static long
+hist_quantile(const long *hist, int nbins, int width, long games, double q)
+{
+	long		want = (long)(q * games), seen = 0;
+
+	for (int i = 0; i < nbins; i++) {
+		seen += hist[i];
+		if (seen > want)
+			return (long)i * width;
+	}
+	return (long)(nbins - 1) * width;
+}
+
+static double
+win_rate(const struct balance_cell * c)
+{
+	return c->games > 0 ? (double)c->wins / c->games : 0;
+}
+
+void
+print_balance(const struct balance * b, FILE * out)
+{
+	const struct balance_cell *hard = NULL, *easy = NULL;
+	int		hard_t = 0, hard_s = 0, easy_t = 0, easy_s = 0;
+	long		total = b->games_per_cell * NUM_CELLS;
+
+	fprintf(out, "Balance sweep of %ld games (%ld per pair) in %.3f s on %d thread%s (%.0f games/s)\n",
+		total, b->games_per_cell, b->elapsed, b->threads, b->threads == 1 ? "" : "s",
+		b->elapsed > 0 ? b->played / b->elapsed : 0.0);
+	if (b->reused)
+		fprintf(out, "  Reused %d of %d pairs from the store, played %ld games\n",
+			b->reused, NUM_CELLS, b->played);
+	fprintf(out, "  Seed: %#llx, policy %s\n", (unsigned long long)b->seed, b->policy);
+	fprintf(out, "%-20s %-10s %8s %8s %8s %11s %7s %8s\n", "Tool", "Species",
+		"Win", "Out", "Score", "Score p10-90", "Turns", "Fluoride");
+	for (int t = 0; t < NUM_TOOLS; t++)
+		for (int s = 0; s < NUM_PATIENTS; s++) {
+			const struct balance_cell *c = &b->cells[t][s];
+			double		n = c->games > 0 ? (double)c->games : 1.0;
+
+			fprintf(out, "%-20s %-10s %7.2f%% %7.2f%% %8.1f %5ld-%-5ld %7.2f %8.1f\n",
+				tools[t].name, patients[s].species, 100 * win_rate(c),
+				100.0 * c->no_fluoride / n, c->score_sum / n,
+				hist_quantile(c->score_hist, BALANCE_SCORE_BINS, BALANCE_SCORE_BIN, c->games, 0.1),
+				hist_quantile(c->score_hist, BALANCE_SCORE_BINS, BALANCE_SCORE_BIN, c->games, 0.9),
+				c->turns_sum / n, c->fluoride_sum / n);
+			if (hard == NULL || win_rate(c) < win_rate(hard)) {
+				hard = c;
+				hard_t = t;
+				hard_s = s;
+			}
+			if (easy == NULL || win_rate(c) > win_rate(easy)) {
+				easy = c;
+				easy_t = t;
+				easy_s = s;
+			}
+		}
+	fprintf(out, "  Hardest: %s on %s, %.2f%% wins\n", tools[hard_t].name,
+		patients[hard_s].species, 100 * win_rate(hard));
+	fprintf(out, "  Easiest: %s on %s, %.2f%% wins\n", tools[easy_t].name,
+		patients[easy_s].species, 100 * win_rate(easy));
+}
+
+/*
+ * Tab separated tables for other tools to read: one "outcome" row per
+ * pair, then "score" and "fluoride" rows holding the histogram counts.
+ * A path of "-" writes to standard output.
+ */
+int
+balance_write_tables(const struct balance * b, const char *path)
+{
+	FILE	       *fp = strcmp(path, "-") == 0 ? stdout : fopen(path, "w");
+
+	if (fp == NULL) {
+		warn("%s", path);
+		return -1;
+	}
+	fprintf(fp, "# buffy %s balance sweep, seed %#llx, policy %s, %ld games per pair\n",
+		VERSION, (unsigned long long)b->seed, b->policy, b->games_per_cell);
+	fprintf(fp, "# outcome\ttool\tspecies\tgames\twins\tno_fluoride\tstalled\t"
+		"score_sum\tturns_sum\tfluoride_sum\n");
+	fprintf(fp, "# score\ttool\tspecies\t%d bins of %d from 0, the last open\n",
+		BALANCE_SCORE_BINS, BALANCE_SCORE_BIN);
+	fprintf(fp, "# fluoride\ttool\tspecies\t%d bins of %d from 0\n",
+		BALANCE_FLUORIDE_BINS, BALANCE_FLUORIDE_BIN);
+	for (int t = 0; t < NUM_TOOLS; t++)
+		for (int s = 0; s < NUM_PATIENTS; s++) {
+			const struct balance_cell *c = &b->cells[t][s];
+
+			fprintf(fp, "outcome\t%s\t%s\t%ld\t%ld\t%ld\t%ld\t%lld\t%lld\t%lld\n",
+				tools[t].name, patients[s].species, c->games, c->wins,
+				c->no_fluoride, c->stalled, c->score_sum, c->turns_sum, c->fluoride_sum);
+			fprintf(fp, "score\t%s\t%s", tools[t].name, patients[s].species);
+			for (int i = 0; i < BALANCE_SCORE_BINS; i++)
+				fprintf(fp, "\t%ld", c->score_hist[i]);
+			fprintf(fp, "\nfluoride\t%s\t%s", tools[t].name, patients[s].species);
+			for (int i = 0; i < BALANCE_FLUORIDE_BINS; i++)
+				fprintf(fp, "\t%ld", c->fluoride_hist[i]);
+			fprintf(fp, "\n");
+		}
+	if (fp == stdout)
+		return fflush(fp) == EOF ? -1 : 0;
+	if (fclose(fp) == EOF) {
+		warn("%s", path);
+		return -1;
+	}
+	return 0;
+}
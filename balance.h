@@ -0,0 +1,95 @@
+/*
+ * BSD Zero Clause License
+ *
+ * Copyright (c) 2025 David M Crumpton david.m.crumpton [at] gmail [dot] com
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * balance.h: sampled outcomes of every tool against every species, for
+ * tuning the balance constants
+ *
+ */
+
+#ifndef BALANCE_H
+#define BALANCE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "buffy.h"
+#include "engine.h"
+#include "policy.h"
+
+#define BALANCE_SCORE_BIN	10
+#define BALANCE_SCORE_BINS	100	/* the last bin holds every higher score */
+#define BALANCE_FLUORIDE_BIN	10
+#define BALANCE_FLUORIDE_BINS	(DEFAULT_FLUORIDE / BALANCE_FLUORIDE_BIN + 1)
+
+#define BALANCE_STORE_MAGIC	0x53424642	/* "BFBS" */
+#define BALANCE_STORE_VERSION	1
+
+struct balance_cell {
+	long		games;
+	long		wins;
+	long		no_fluoride;
+	long		stalled;
+	long long	score_sum;
+	long long	turns_sum;
+	long long	fluoride_sum;
+	long		score_hist[BALANCE_SCORE_BINS];
+	long		fluoride_hist[BALANCE_FLUORIDE_BINS];
+};
+
+/*
+ * A pair's results kept in a store between sweeps, one per tool, species
+ * and policy. It stands in for playing the pair again while its
+ * fingerprint still matches the inputs the pair depends on.
+ */
+struct balance_record {
+	uint64_t	fingerprint;
+	char		policy[16];
+	uint8_t		tool_idx;
+	uint8_t		species;
+	uint8_t		pad[6];
+	struct balance_cell cell;
+};
+
+struct balance_store_header {
+	uint32_t	magic;
+	uint16_t	version;
+	uint16_t	cell_size;	/* sizeof(struct balance_cell) */
+	uint32_t	count;
+	uint32_t	reserved;
+};
+
+struct balance {
+	struct balance_cell cells[NUM_TOOLS][NUM_PATIENTS];
+	uint64_t	fingerprint[NUM_TOOLS][NUM_PATIENTS];
+	long		games_per_cell;
+	long		played;	/* games the pairs not taken from the store needed */
+	int		reused;	/* pairs taken from the store */
+	uint64_t	seed;	/* game g of the sweep is dealt from stream g */
+	const char     *policy;
+	double		elapsed;
+	int		threads;
+};
+
+uint64_t	balance_fingerprint(const struct policy_config * cfg, int tool_idx, int species, long per_cell, uint64_t seed,
+			    int nfangs);
+int		balance_sweep(const struct policy_config * cfg, long ngames, int nthreads, const char *store, struct balance * b);
+void		balance_merge_cell(struct balance_cell * into, const struct balance_cell * from);
+void		print_balance(const struct balance * b, FILE * out);
+int		balance_write_tables(const struct balance * b, const char *path);
+
+#endif				/* BALANCE_H */
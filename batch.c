@@ -0,0 +1,673 @@
+/*
+ * BSD Zero Clause License
+ *
+ * Copyright (c) 2025 David M Crumpton david.m.crumpton [at] gmail [dot] com
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * batch.c: the turn of engine_fang_turn() and patient_reaction() applied to
+ * a whole batch of games at once. Fang health, fluoride, patience, mood
+ * and score live in separate contiguous arrays, one lane per game, and a
+ * fang step is a run of compares, blends and adds over eight (AVX2) or
+ * four (SSE4.1) lanes at a time. The scalar kernel is the reference the
+ * vector kernels are checked against.
+ *
+ */
+#include <err.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "buffy.h"
+#include "batch.h"
+#include "engine.h"
+#include "patient.h"
+#include "pool.h"
+#include "rng.h"
+#include "simulate.h"
+#include "tables.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BATCH_X86
+#endif
+
+#define BATCH_VECTOR	8	/* lanes are padded to this */
+#define BATCH_JOB	65536	/* games a worker deals and sorts per call */
+#define BATCH_CHECK_SEED 0x62746664
+
+static enum batch_kernel selected_kernel = BATCH_KERNEL_AUTO;
+
+static const char *kernel_names[] = {"auto", "scalar", "sse4.1", "avx2"};
+
+
+static enum batch_kernel
+resolve_kernel(enum batch_kernel k)
+{
+	if (k != BATCH_KERNEL_AUTO)
+		return k;
+#ifdef BATCH_X86
+	if (__builtin_cpu_supports("avx2"))
+		return BATCH_KERNEL_AVX2;
+	if (__builtin_cpu_supports("sse4.1"))
+		return BATCH_KERNEL_SSE41;
+#endif
+	return BATCH_KERNEL_SCALAR;
+}
+
+int
+batch_set_kernel(const char *name)
+{
+	for (int k = 0; k < (int)(sizeof(kernel_names) / sizeof(kernel_names[0])); k++) {
+		if (strcmp(name, kernel_names[k]) != 0)
+			continue;
+#ifndef BATCH_X86
+		if (k == BATCH_KERNEL_SSE41 || k == BATCH_KERNEL_AVX2)
+			return -1;
+#else
+		if ((k == BATCH_KERNEL_SSE41 && !__builtin_cpu_supports("sse4.1")) ||
+		    (k == BATCH_KERNEL_AVX2 && !__builtin_cpu_supports("avx2")))
+			return -1;
+#endif
+		selected_kernel = k;
+		return 0;
+	}
+	return -1;
+}
+
+const char     *
+batch_kernel_name(void)
+{
+	return kernel_names[resolve_kernel(selected_kernel)];
+}
+
+void
+batch_cell_init(struct batch_cell * cell, int tool_idx, int species)
+{
+	const tool     *t = &tools[tool_idx];
+	game_state_type	state;
+	int		pain_base = t->effort * t->pain_factor;	/* patients have no tolerance */
+
+	memset(cell, 0, sizeof(*cell));
+	memset(&state, 0, sizeof(state));
+	state.tool_in_use = tool_idx;
+	state.patient_idx = species;
+	cell->tool_idx = tool_idx;
+	cell->species = species;
+	cell->dip_amount = t->dip_amount;
+
+	for (int d = 0; d < TBL_DIP; d++) {
+		cell->used[d] = TBL_FLUORIDE_USED(tool_idx, d);
+		cell->gain[d] = fang_health_gain(&state, cell->used[d], t->effort);
+	}
+
+	/* Pain only falls as health rises, so mood steps down with health */
+	cell->unhappy_health = cell->angry_health = -1;
+	for (int h = 0; h <= MAX_HEALTH; h++) {
+		int		mood = TBL_MOOD(pain_base + TBL_HEALTH_PAIN(h));
+
+		if (mood >= MOOD_UNHAPPY)
+			cell->unhappy_health = h;
+		if (mood >= MOOD_ANGRY)
+			cell->angry_health = h;
+	}
+	cell->calm_patience = cell->bliss_patience = INT_MAX;
+	for (int p = TBL_PATIENCE - 1; p >= 0; p--) {
+		int		level = TBL_PATIENCE_LEVEL(p);
+
+		if (level >= PATIENCE_CALM)
+			cell->calm_patience = p;
+		if (level >= PATIENCE_BLISS)
+			cell->bliss_patience = p;
+	}
+}
+
+struct batch   *
+batch_new(int n)
+{
+	struct batch   *b;
+	int		cap = (n + BATCH_VECTOR - 1) / BATCH_VECTOR * BATCH_VECTOR;
+	int32_t       **arrays[NUM_FANGS + 7];
+	int		narrays = 0;
+
+	if ((b = calloc(1, sizeof(*b))) == NULL)
+		err(1, "batch");
+	b->cap = cap;
+	for (int f = 0; f < NUM_FANGS; f++)
+		arrays[narrays++] = &b->health[f];
+	arrays[narrays++] = &b->fluoride;
+	arrays[narrays++] = &b->patience;
+	arrays[narrays++] = &b->mood;
+	arrays[narrays++] = &b->patience_level;
+	arrays[narrays++] = &b->score;
+	arrays[narrays++] = &b->turns;
+	arrays[narrays++] = &b->status;
+	for (int i = 0; i < narrays; i++)
+		if ((*arrays[i] = aligned_alloc(CACHE_LINE, sizeof(int32_t) * cap)) == NULL)
+			err(1, "batch lanes");
+	return b;
+}
+
+void
+batch_free(struct batch * b)
+{
+	if (b == NULL)
+		return;
+	for (int f = 0; f < NUM_FANGS; f++)
+		free(b->health[f]);
+	free(b->fluoride);
+	free(b->patience);
+	free(b->mood);
+	free(b->patience_level);
+	free(b->score);
+	free(b->turns);
+	free(b->status);
+	free(b);
+}
+
+/*
+ * Deal n fresh games of one cell. With games NULL they come from the
+ * calling thread's stream; otherwise lane i is game games[i] of the seed,
+ * dealt from that game's own stream exactly as sim_play_game() would.
+ */
+void
+batch_deal(struct batch * b, const struct batch_cell * cell, int n, uint64_t seed, const uint64_t * games)
+{
+	patient_type	pat;
+	struct rng	r;
+	const int	no_daggers = 0;
+
+	if (n > b->cap)
+		errx(1, "batch of %d games dealt into %d lanes", n, b->cap);
+	b->n = n;
+	b->cell = *cell;
+	for (int i = 0; i < b->cap; i++) {
+		if (i < n) {
+			if (games != NULL) {
+				rng_seed(&r, seed, games[i]);
+				rng_set_stream(&r);
+				/*
+				 * Already sorted by these: the tool, then the
+				 * species. Either tool table takes one draw.
+				 */
+				(void)choose_random_tool(&no_daggers);
+				(void)choose_random_patient();
+			}
+			randomize_fangs(&pat);
+			for (int f = 0; f < NUM_FANGS; f++)
+				b->health[f][i] = pat.fangs[f].health;
+		} else {
+			for (int f = 0; f < NUM_FANGS; f++)
+				b->health[f][i] = MAX_HEALTH;
+		}
+		b->fluoride[i] = DEFAULT_FLUORIDE;
+		b->patience[i] = patients[cell->species].patience;
+		b->mood[i] = 0;
+		b->patience_level[i] = 0;
+		b->score[i] = DEFAULT_SCORE;
+		b->turns[i] = DEFAULT_TURNS;
+		b->status[i] = i < n ? BATCH_PLAYING : SIM_WIN;
+	}
+	if (games != NULL)
+		rng_set_stream(NULL);
+}
+
+static void
+fang_step_scalar(struct batch * b, int fang_idx, int lo, int hi)
+{
+	const struct batch_cell *c = &b->cell;
+	int32_t        *health = b->health[fang_idx];
+
+	for (int i = lo; i < hi; i++) {
+		int		h = health[i];
+
+		if (b->status[i] != BATCH_PLAYING || h >= MAX_HEALTH)
+			continue;
+
+		/* patient_reaction() */
+		if (h > 0)
+			b->patience[i] = b->patience[i] > 0 ? b->patience[i] - 1 : 0;
+		b->mood[i] = (h <= c->unhappy_health) + (h <= c->angry_health);
+		b->patience_level[i] = (b->patience[i] >= c->calm_patience) +
+			(b->patience[i] >= c->bliss_patience);
+
+		/* sim_scripted_input(): gains rise with the dip */
+		int		dip = 0;
+		for (int d = 0; d <= c->dip_amount; d++)
+			dip += c->gain[d] < MAX_HEALTH - h;
+		dip = dip > c->dip_amount ? c->dip_amount : dip;
+
+		if (c->used[dip] > b->fluoride[i]) {
+			b->status[i] = SIM_NO_FLUORIDE;
+			continue;
+		}
+		b->fluoride[i] -= c->used[dip];
+		h = tbl_clamp(h + c->gain[dip], MAX_HEALTH);
+		health[i] = h;
+		b->score[i] += BONUS_FANG_CLEANED + (h >= MAX_HEALTH ? BONUS_FANG_HEALTH : 0);
+	}
+}
+
+#ifdef BATCH_X86
+__attribute__((target("sse4.1")))
+static void
+fang_step_sse41(struct batch * b, int fang_idx)
+{
+	const struct batch_cell *c = &b->cell;
+	int32_t        *health = b->health[fang_idx];
+	const __m128i	playing = _mm_set1_epi32(BATCH_PLAYING);
+	const __m128i	full = _mm_set1_epi32(MAX_HEALTH);
+	const __m128i	zero = _mm_setzero_si128();
+
+	for (int i = 0; i < b->cap; i += 4) {
+		__m128i		h = _mm_load_si128((const __m128i *)(health + i));
+		__m128i		st = _mm_load_si128((const __m128i *)(b->status + i));
+		__m128i		active = _mm_and_si128(_mm_cmpeq_epi32(st, playing), _mm_cmplt_epi32(h, full));
+
+		if (_mm_movemask_epi8(active) == 0)
+			continue;
+
+		/* patient_reaction() */
+		__m128i		p = _mm_load_si128((const __m128i *)(b->patience + i));
+		__m128i		dec = _mm_and_si128(active, _mm_cmpgt_epi32(h, zero));
+		p = _mm_max_epi32(_mm_add_epi32(p, dec), zero);
+		__m128i		mood = _mm_sub_epi32(zero, _mm_add_epi32(
+		    _mm_cmpgt_epi32(_mm_set1_epi32(c->unhappy_health + 1), h),
+		    _mm_cmpgt_epi32(_mm_set1_epi32(c->angry_health + 1), h)));
+		__m128i		level = _mm_sub_epi32(zero, _mm_add_epi32(
+		    _mm_cmpgt_epi32(p, _mm_set1_epi32(c->calm_patience - 1)),
+		    _mm_cmpgt_epi32(p, _mm_set1_epi32(c->bliss_patience - 1))));
+		_mm_store_si128((__m128i *)(b->patience + i), p);
+		_mm_store_si128((__m128i *)(b->mood + i), _mm_blendv_epi8(
+		    _mm_load_si128((const __m128i *)(b->mood + i)), mood, active));
+		_mm_store_si128((__m128i *)(b->patience_level + i), _mm_blendv_epi8(
+		    _mm_load_si128((const __m128i *)(b->patience_level + i)), level, active));
+
+		/* sim_scripted_input() and the matching gain and fluoride */
+		__m128i		need = _mm_sub_epi32(full, h);
+		__m128i		dip = zero;
+		for (int d = 0; d <= c->dip_amount; d++)
+			dip = _mm_sub_epi32(dip, _mm_cmpgt_epi32(need, _mm_set1_epi32(c->gain[d])));
+		dip = _mm_min_epi32(dip, _mm_set1_epi32(c->dip_amount));
+		__m128i		gain = zero, used = zero;
+		for (int d = 0; d <= c->dip_amount; d++) {
+			__m128i		is = _mm_cmpeq_epi32(dip, _mm_set1_epi32(d));
+			gain = _mm_blendv_epi8(gain, _mm_set1_epi32(c->gain[d]), is);
+			used = _mm_blendv_epi8(used, _mm_set1_epi32(c->used[d]), is);
+		}
+
+		__m128i		fl = _mm_load_si128((const __m128i *)(b->fluoride + i));
+		__m128i		broke = _mm_and_si128(active, _mm_cmpgt_epi32(used, fl));
+		__m128i		ok = _mm_andnot_si128(broke, active);
+		_mm_store_si128((__m128i *)(b->status + i),
+		    _mm_blendv_epi8(st, _mm_set1_epi32(SIM_NO_FLUORIDE), broke));
+		_mm_store_si128((__m128i *)(b->fluoride + i), _mm_sub_epi32(fl, _mm_and_si128(used, ok)));
+
+		__m128i		hn = _mm_min_epi32(_mm_max_epi32(_mm_add_epi32(h, gain), zero), full);
+		_mm_store_si128((__m128i *)(health + i), _mm_blendv_epi8(h, hn, ok));
+		__m128i		bonus = _mm_add_epi32(_mm_set1_epi32(BONUS_FANG_CLEANED),
+		    _mm_and_si128(_mm_cmpeq_epi32(hn, full), _mm_set1_epi32(BONUS_FANG_HEALTH)));
+		__m128i		score = _mm_load_si128((const __m128i *)(b->score + i));
+		_mm_store_si128((__m128i *)(b->score + i), _mm_add_epi32(score, _mm_and_si128(bonus, ok)));
+	}
+}
+
+__attribute__((target("avx2")))
+static void
+fang_step_avx2(struct batch * b, int fang_idx)
+{
+	const struct batch_cell *c = &b->cell;
+	int32_t        *health = b->health[fang_idx];
+	const __m256i	playing = _mm256_set1_epi32(BATCH_PLAYING);
+	const __m256i	full = _mm256_set1_epi32(MAX_HEALTH);
+	const __m256i	zero = _mm256_setzero_si256();
+
+	for (int i = 0; i < b->cap; i += 8) {
+		__m256i		h = _mm256_load_si256((const __m256i *)(health + i));
+		__m256i		st = _mm256_load_si256((const __m256i *)(b->status + i));
+		__m256i		active = _mm256_and_si256(_mm256_cmpeq_epi32(st, playing), _mm256_cmpgt_epi32(full, h));
+
+		if (_mm256_movemask_epi8(active) == 0)
+			continue;
+
+		/* patient_reaction() */
+		__m256i		p = _mm256_load_si256((const __m256i *)(b->patience + i));
+		__m256i		dec = _mm256_and_si256(active, _mm256_cmpgt_epi32(h, zero));
+		p = _mm256_max_epi32(_mm256_add_epi32(p, dec), zero);
+		__m256i		mood = _mm256_sub_epi32(zero, _mm256_add_epi32(
+		    _mm256_cmpgt_epi32(_mm256_set1_epi32(c->unhappy_health + 1), h),
+		    _mm256_cmpgt_epi32(_mm256_set1_epi32(c->angry_health + 1), h)));
+		__m256i		level = _mm256_sub_epi32(zero, _mm256_add_epi32(
+		    _mm256_cmpgt_epi32(p, _mm256_set1_epi32(c->calm_patience - 1)),
+		    _mm256_cmpgt_epi32(p, _mm256_set1_epi32(c->bliss_patience - 1))));
+		_mm256_store_si256((__m256i *)(b->patience + i), p);
+		_mm256_store_si256((__m256i *)(b->mood + i), _mm256_blendv_epi8(
+		    _mm256_load_si256((const __m256i *)(b->mood + i)), mood, active));
+		_mm256_store_si256((__m256i *)(b->patience_level + i), _mm256_blendv_epi8(
+		    _mm256_load_si256((const __m256i *)(b->patience_level + i)), level, active));
+
+		/* sim_scripted_input() and the matching gain and fluoride */
+		__m256i		need = _mm256_sub_epi32(full, h);
+		__m256i		dip = zero;
+		for (int d = 0; d <= c->dip_amount; d++)
+			dip = _mm256_sub_epi32(dip, _mm256_cmpgt_epi32(need, _mm256_set1_epi32(c->gain[d])));
+		dip = _mm256_min_epi32(dip, _mm256_set1_epi32(c->dip_amount));
+		__m256i		gain = zero, used = zero;
+		for (int d = 0; d <= c->dip_amount; d++) {
+			__m256i		is = _mm256_cmpeq_epi32(dip, _mm256_set1_epi32(d));
+			gain = _mm256_blendv_epi8(gain, _mm256_set1_epi32(c->gain[d]), is);
+			used = _mm256_blendv_epi8(used, _mm256_set1_epi32(c->used[d]), is);
+		}
+
+		__m256i		fl = _mm256_load_si256((const __m256i *)(b->fluoride + i));
+		__m256i		broke = _mm256_and_si256(active, _mm256_cmpgt_epi32(used, fl));
+		__m256i		ok = _mm256_andnot_si256(broke, active);
+		_mm256_store_si256((__m256i *)(b->status + i),
+		    _mm256_blendv_epi8(st, _mm256_set1_epi32(SIM_NO_FLUORIDE), broke));
+		_mm256_store_si256((__m256i *)(b->fluoride + i), _mm256_sub_epi32(fl, _mm256_and_si256(used, ok)));
+
+		__m256i		hn = _mm256_min_epi32(_mm256_max_epi32(_mm256_add_epi32(h, gain), zero), full);
+		_mm256_store_si256((__m256i *)(health + i), _mm256_blendv_epi8(h, hn, ok));
+		__m256i		bonus = _mm256_add_epi32(_mm256_set1_epi32(BONUS_FANG_CLEANED),
+		    _mm256_and_si256(_mm256_cmpeq_epi32(hn, full), _mm256_set1_epi32(BONUS_FANG_HEALTH)));
+		__m256i		score = _mm256_load_si256((const __m256i *)(b->score + i));
+		_mm256_store_si256((__m256i *)(b->score + i), _mm256_add_epi32(score, _mm256_and_si256(bonus, ok)));
+	}
+}
+#endif				/* BATCH_X86 */
+
+void
+batch_fang_step(struct batch * b, int fang_idx, enum batch_kernel k)
+{
+	switch (resolve_kernel(k)) {
+#ifdef BATCH_X86
+	case BATCH_KERNEL_AVX2:
+		fang_step_avx2(b, fang_idx);
+		break;
+	case BATCH_KERNEL_SSE41:
+		fang_step_sse41(b, fang_idx);
+		break;
+#endif
+	default:
+		fang_step_scalar(b, fang_idx, 0, b->cap);
+	}
+}
+
+/* engine_end_round() for every lane. Returns the lanes still playing. */
+int
+batch_end_round(struct batch * b)
+{
+	int		playing = 0;
+
+	for (int i = 0; i < b->n; i++) {
+		if (b->status[i] != BATCH_PLAYING)
+			continue;
+		b->turns[i]++;
+		b->score[i] += BONUS_TURN_COMPLETE;
+
+		int		healthy = 1;
+		for (int f = 0; f < NUM_FANGS; f++)
+			healthy &= b->health[f][i] >= MAX_HEALTH;
+		if (healthy) {
+			b->score[i] += BONUS_ALL_HEALTH;
+			b->status[i] = SIM_WIN;
+		} else if (b->turns[i] > SIM_MAX_TURNS) {
+			b->status[i] = SIM_STALLED;
+		} else {
+			playing++;
+		}
+	}
+	return playing;
+}
+
+void
+batch_play(struct batch * b, enum batch_kernel k)
+{
+	do {
+		for (int f = 0; f < NUM_FANGS; f++)
+			batch_fang_step(b, f, k);
+	} while (batch_end_round(b) > 0);
+}
+
+void
+batch_tally(const struct batch * b, struct sim_results * res)
+{
+	for (int i = 0; i < b->n; i++) {
+		switch (b->status[i]) {
+		case SIM_WIN:
+			res->wins++;
+			break;
+		case SIM_NO_FLUORIDE:
+			res->no_fluoride++;
+			break;
+		default:
+			res->stalled++;
+		}
+		res->games++;
+		res->score_sum += b->score[i];
+		res->turns_sum += b->turns[i];
+		res->fluoride_sum += b->fluoride[i];
+		sketch_add(&res->score, b->score[i]);
+		sketch_add(&res->turns, b->turns[i]);
+		sketch_add(&res->fluoride, b->fluoride[i]);
+	}
+}
+
+struct batch_shard {
+	_Alignas(CACHE_LINE) struct sim_results res;
+	struct rng	rng;
+	struct batch   *batch;
+	uint8_t		cell_of[BATCH_JOB];
+	uint64_t	games[BATCH_JOB];	/* game numbers sorted by cell */
+	int		start[NUM_TOOLS * NUM_PATIENTS + 1];
+};
+
+struct batch_job {
+	struct batch_shard *shards;
+	struct batch_cell cells[NUM_TOOLS][NUM_PATIENTS];
+	uint64_t	seed;
+	int		daggerset;
+	enum batch_kernel kernel;
+};
+
+/*
+ * Draw the tool and species of a run of games from each game's own
+ * stream, counting sort the games by them, then play each cell a batch at
+ * a time.
+ */
+static void
+batch_worker(void *arg, int worker, uint64_t lo, uint64_t hi)
+{
+	struct batch_job *job = arg;
+	struct batch_shard *shard = &job->shards[worker];
+	int		ncells = NUM_TOOLS * NUM_PATIENTS;
+	int		fill[NUM_TOOLS * NUM_PATIENTS];
+
+	if (shard->batch == NULL)
+		shard->batch = batch_new(BATCH_LANES);
+
+	memset(shard->start, 0, sizeof(shard->start));
+	rng_set_stream(&shard->rng);
+	for (uint64_t g = lo; g < hi; g++) {
+		rng_seed(&shard->rng, job->seed, g);
+		int		t = choose_random_tool(&job->daggerset);
+		int		c = t * NUM_PATIENTS + choose_random_patient();
+
+		shard->cell_of[g - lo] = c;
+		shard->start[c + 1]++;
+	}
+	rng_set_stream(NULL);
+	for (int c = 0; c < ncells; c++) {
+		shard->start[c + 1] += shard->start[c];
+		fill[c] = shard->start[c];
+	}
+	for (uint64_t g = lo; g < hi; g++)
+		shard->games[fill[shard->cell_of[g - lo]]++] = g;
+
+	for (int c = 0; c < ncells; c++) {
+		const struct batch_cell *cell = &job->cells[c / NUM_PATIENTS][c % NUM_PATIENTS];
+
+		for (int i = shard->start[c]; i < shard->start[c + 1]; i += BATCH_LANES) {
+			int		n = shard->start[c + 1] - i;
+
+			batch_deal(shard->batch, cell, n < BATCH_LANES ? n : BATCH_LANES, job->seed, shard->games + i);
+			batch_play(shard->batch, job->kernel);
+			batch_tally(shard->batch, &shard->res);
+		}
+	}
+}
+
+void
+simulate_batches(long ngames, int daggerset, int nthreads, struct sim_results * res)
+{
+	struct batch_job job;
+	struct timespec	start, end;
+
+	if (nthreads < 1)
+		nthreads = 1;
+	if ((job.shards = aligned_alloc(CACHE_LINE, sizeof(*job.shards) * nthreads)) == NULL)
+		err(1, "batch shards");
+	memset(job.shards, 0, sizeof(*job.shards) * nthreads);
+	job.seed = rng_get_seed();
+	for (int t = 0; t < NUM_TOOLS; t++)
+		for (int s = 0; s < NUM_PATIENTS; s++)
+			batch_cell_init(&job.cells[t][s], t, s);
+	job.daggerset = daggerset;
+	job.kernel = resolve_kernel(selected_kernel);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	pool_run(nthreads, ngames, BATCH_JOB, batch_worker, &job);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	memset(res, 0, sizeof(*res));
+	for (int i = 0; i < nthreads; i++) {
+		sim_merge_results(res, &job.shards[i].res);
+		batch_free(job.shards[i].batch);
+	}
+	res->threads = nthreads;
+	res->seed = job.seed;
+	res->elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+	free(job.shards);
+}
+
+static long
+compare_lanes(FILE * out, const char *what, const struct batch * a, const struct batch * b)
+{
+	long		bad = 0;
+
+	for (int i = 0; i < a->n; i++) {
+		int		same = a->fluoride[i] == b->fluoride[i] && a->patience[i] == b->patience[i] &&
+		a->mood[i] == b->mood[i] && a->patience_level[i] == b->patience_level[i] &&
+		a->score[i] == b->score[i] && a->turns[i] == b->turns[i] && a->status[i] == b->status[i];
+
+		for (int f = 0; f < NUM_FANGS; f++)
+			same &= a->health[f][i] == b->health[f][i];
+		if (!same && out != NULL && bad < 5)
+			fprintf(out, "%s differs from the engine: %s/%s lane %d\n", what,
+				tools[a->cell.tool_idx].name, patients[a->cell.species].species, i);
+		bad += !same;
+	}
+	return bad;
+}
+
+/*
+ * Play the same deals through engine_fang_turn() one game at a time and
+ * through every batch kernel this machine has, and count the lanes that
+ * disagree.
+ */
+long
+batch_check_kernels(FILE * out)
+{
+	struct batch   *ref = batch_new(BATCH_LANES), *b = batch_new(BATCH_LANES);
+	struct batch_cell cell;
+	struct rng	r;
+	long		bad = 0;
+	int		n = 1000, nkernels = 0;
+
+	rng_set_stream(&r);
+	for (int t = 0; t < NUM_TOOLS; t++) {
+		for (int s = 0; s < NUM_PATIENTS; s++) {
+			batch_cell_init(&cell, t, s);
+			rng_seed(&r, BATCH_CHECK_SEED, t * NUM_PATIENTS + s);
+			batch_deal(ref, &cell, n, 0, NULL);
+
+			/* The engine itself is the reference */
+			for (int i = 0; i < n; i++) {
+				game_state_type	state;
+				patient_type	pat;
+				struct dent_bits teeth;
+				int		dip, effort, outcome = BATCH_PLAYING;
+
+				memset(&state, 0, sizeof(state));
+				memset(&pat, 0, sizeof(pat));
+				state.fluoride = ref->fluoride[i];
+				state.score = ref->score[i];
+				state.turns = ref->turns[i];
+				state.tool_in_use = t;
+				state.patient_idx = s;
+				pat.patience = ref->patience[i];
+				for (int f = 0; f < NUM_FANGS; f++)
+					pat.fangs[f].health = ref->health[f][i];
+				dent_bits_init(&teeth, &pat);
+
+				while (outcome == BATCH_PLAYING) {
+					for (int f = dent_next(&teeth, 0); f < NUM_FANGS && outcome == BATCH_PLAYING;
+					     f = dent_next(&teeth, f + 1)) {
+						sim_scripted_input(&state, &pat, f, &dip, &effort);
+						if (engine_fang_turn(&state, &pat, f, dip, effort, NULL, 0) == -1)
+							outcome = SIM_NO_FLUORIDE;
+						dent_bits_update(&teeth, f, pat.fangs[f].health);
+					}
+					if (outcome != BATCH_PLAYING)
+						break;
+					if (engine_end_round(&state, &teeth) == 0) {
+						state.score += BONUS_ALL_HEALTH;
+						outcome = SIM_WIN;
+					} else if (state.turns > SIM_MAX_TURNS)
+						outcome = SIM_STALLED;
+				}
+				ref->fluoride[i] = state.fluoride;
+				ref->patience[i] = pat.patience;
+				ref->mood[i] = pat.mood;
+				ref->patience_level[i] = pat.patience_level;
+				ref->score[i] = state.score;
+				ref->turns[i] = state.turns;
+				ref->status[i] = outcome;
+				for (int f = 0; f < NUM_FANGS; f++)
+					ref->health[f][i] = pat.fangs[f].health;
+			}
+
+			for (int k = BATCH_KERNEL_SCALAR; k <= BATCH_KERNEL_AVX2; k++) {
+				if (resolve_kernel(BATCH_KERNEL_AUTO) < k)
+					break;
+				if (t == 0 && s == 0)
+					nkernels++;
+				/* Same deal as the reference */
+				rng_seed(&r, BATCH_CHECK_SEED, t * NUM_PATIENTS + s);
+				batch_deal(b, &cell, n, 0, NULL);
+				batch_play(b, k);
+				bad += compare_lanes(out, kernel_names[k], ref, b);
+			}
+		}
+	}
+	rng_set_stream(NULL);
+	batch_free(ref);
+	batch_free(b);
+	if (out != NULL)
+		fprintf(out, "Checked %d batch kernel%s against the engine: %ld lane%s differ\n",
+			nkernels, nkernels == 1 ? "" : "s", bad, bad == 1 ? "" : "s");
+	return bad;
+}
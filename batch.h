@@ -0,0 +1,91 @@
+/*
+ * BSD Zero Clause License
+ *
+ * Copyright (c) 2025 David M Crumpton david.m.crumpton [at] gmail [dot] com
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * batch.h: struct of arrays engine that plays thousands of games of one
+ * tool and species at once with SIMD kernels
+ *
+ */
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "buffy.h"
+#include "engine.h"
+#include "simulate.h"
+#include "tables.h"
+
+#define BATCH_LANES	4096	/* games per batch */
+#define BATCH_PLAYING	(-1)	/* status of a lane still in play */
+
+enum batch_kernel {
+	BATCH_KERNEL_AUTO,
+	BATCH_KERNEL_SCALAR,
+	BATCH_KERNEL_SSE41,
+	BATCH_KERNEL_AVX2
+};
+
+/*
+ * Everything that is the same for every lane, worked out once from the
+ * turn tables: the scripted dip for a fang is the number of dips that fall
+ * short of what it needs, and pain, mood and patience level reduce to a
+ * couple of health and patience thresholds.
+ */
+struct batch_cell {
+	int		tool_idx;
+	int		species;
+	int		dip_amount;
+	int32_t		gain[TBL_DIP];	/* at full effort, per dip */
+	int32_t		used[TBL_DIP];	/* fluoride used, per dip */
+	int32_t		unhappy_health;	/* mood >= unhappy at or below */
+	int32_t		angry_health;	/* mood == angry at or below */
+	int32_t		calm_patience;	/* level >= calm at or above */
+	int32_t		bliss_patience;	/* level == bliss at or above */
+};
+
+/* Lanes are padded to a whole vector; padding lanes start finished */
+struct batch {
+	int		n;
+	int		cap;
+	struct batch_cell cell;
+	int32_t        *health[NUM_FANGS];
+	int32_t        *fluoride;
+	int32_t        *patience;
+	int32_t        *mood;
+	int32_t        *patience_level;
+	int32_t        *score;
+	int32_t        *turns;
+	int32_t        *status;
+};
+
+int		batch_set_kernel(const char *name);
+const char     *batch_kernel_name(void);
+void		batch_cell_init(struct batch_cell * cell, int tool_idx, int species);
+struct batch   *batch_new(int n);
+void		batch_free(struct batch * b);
+void		batch_deal(struct batch * b, const struct batch_cell * cell, int n, uint64_t seed, const uint64_t * games);
+void		batch_fang_step(struct batch * b, int fang_idx, enum batch_kernel k);
+int		batch_end_round(struct batch * b);
+void		batch_play(struct batch * b, enum batch_kernel k);
+void		batch_tally(const struct batch * b, struct sim_results * res);
+void		simulate_batches(long ngames, int daggerset, int nthreads, struct sim_results * res);
+long		batch_check_kernels(FILE * out);
+
+#endif				/* BATCH_H */
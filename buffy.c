@@ -40,6 +40,27 @@
 #include "patient.h"
 #include "diagnostic.h"
 #include "patient.h"
+#include "engine.h"
+#include "simulate.h"
+#include "mcts.h"
+#include "policy.h"
+#include "pool.h"
+#include "solver.h"
+#include "tables.h"
+#include "tournament.h"
+#include "tune.h"
+#include "analyze.h"
+#include "balance.h"
+#include "batch.h"
+#include "cache.h"
+#include "clinic.h"
+#include "libbuffy.h"
+#include "realtime.h"
+#include "replay.h"
+#include "roster.h"
+#include "rng.h"
+#include "sweep.h"
+#include "watch.h"
 
 #ifdef __FreeBSD__
 #define __dead
@@ -49,10 +70,11 @@
 #define LOGIN_NAME_MAX              64
 #endif				/* End Login Name Max */
 
-#define PATIENT_NAME(idx)    (patients[(idx)].name)
+#define PATIENT_NAME(idx)    (roster_name != NULL ? roster_name : patients[(idx)].name)
 #define PATIENT_SPECIES(idx) (patients[(idx)].species)
 #define SET_SAVE_PATH(src) strlcpy(save_path, (src), sizeof(save_path))
-#define IS_UPPER_FANG	(i < 2)
+#define IS_UPPER_FANG	(i % 4 < 2)	/* teeth go in fours like the canines */
+#define PREVIEW_MAX	16	/* strokes one preview shows */
 
 #define FILE_READABLE 1
 #define FILE_WRITEABLE 2
@@ -80,43 +102,63 @@ fang_info_type	fang_names[] = {
 
 
 
-tool		tools[] = {
-	{"Buffy's Fingernail", "A sharp fingernail for cleaning", 1, 1, 2, 1, 50, 1},
-	{"Small Rock", "A small but rough rock for scraping", 3, 3, 6, 2, 30, 1},
-	{"Shark Tooth", "A sharp shark tooth for precise cleaning", 6, 2, 8, 5, 40, 2},
-	{"Wooden Dagger", "A wooden dagger for simply applying fluoride", 10, 8, 7, 5, 100, 2},
-	{"Bronze Dagger", "A bronze dagger for applying fluoride", 12, 9, 9, 7, 150, 3},
-	{"Steel Dagger", "A steel dagger for strongly applying fluoride", 14, 10, 9, 10, 200, 3}
-};
-
-
-struct patient	patients[] = {
-	{90, 10, 6, MOOD_UNHAPPY, PATIENCE_IMPATIENT, "Dracula", "Vampire", {{0, 0, NULL, 0}, {0, 0, NULL, 0}, {0, 0, NULL, 0}, {0, 0, NULL, 0}}},
-	{110, 15, 5, MOOD_UNHAPPY, PATIENCE_IMPATIENT, "Gorath", "Orc", {{0, 0, NULL, 0}, {0, 0, NULL, 0}, {0, 0, NULL, 0}, {0, 0, NULL, 0}}},
-	{130, 20, 3, MOOD_HAPPY, PATIENCE_IMPATIENT, "Fenrir", "Werewolf", {{0, 0, NULL, 0}, {0, 0, NULL, 0}, {0, 0, NULL, 0}, {0, 0, NULL, 0}}},
-	{150, 25, 2, MOOD_UNHAPPY, PATIENCE_BLISS, "Nagini", "Serpent", {{0, 0, NULL, 0}, {0, 0, NULL, 0}, {0, 0, NULL, 0}, {0, 0, NULL, 0}}},
-	{200, 30, 7, MOOD_HAPPY, PATIENCE_CALM, "Smaug", "Dragon", {{0, 0, NULL, 100}}}	/* Dragon has max health
-											 * fangs */
-};
-
-enum species {
-	VAMPIRE,
-	ORC,
-	WEREWOLF,
-	SERPENT,
-	DRAGON
-};
-
 extern char    *__progname;
 
+static struct replay_writer *recorder = NULL;	/* --record */
+static struct policy *player = NULL;	/* --policy plays in place of the user */
+static struct policy_config policy_cfg = {NULL, NULL, MCTS_DEFAULT_BUDGET_US, MCTS_DEFAULT_NODES};
+static int	realtime_tick = 0;	/* --realtime, ms per tick */
+static struct realtime rt;
+static struct roster roster;	/* --roster */
+static int	band_lo = 0, band_hi = ROSTER_DIFFICULTY_MAX;
+static char    *roster_name = NULL;	/* of the creature dealt from it */
+static struct engine_rules roster_rules;	/* with the tool dealt from it */
+static struct watch watch;	/* --balance-watch */
+static int	watching = 0;
+
 static int	__dead
 usage(void)
 {
-	fprintf(stderr, "%s: [ -b | --not-named-buffy ] [ -f | --fluoride-file <file> ] [ --daggerset ]\n", __progname);
+	fprintf(stderr, "%s: [ -b | --not-named-buffy ] [ -f | --fluoride-file <file> ] [ --daggerset ]\n"
+		"\t[ --simulate <games> [ --threads <n> ] [ --optimal <table> ]\n"
+		"\t  [ --batch ] [ --batch-kernel <kernel> ] ]\n"
+		"\t[ --seed <n> ] [ --record <file> ] [ --replay <file> [ <file> ... ] ]\n"
+		"\t[ --realtime [ --tick <ms> ] ] [ --roster <file> [ --band <lo:hi> ] ]\n"
+		"\t[ --balance-watch <file> ]\n"
+		"\t[ --clinic <patients> [ --hygienists <n> ] [ --arrival <s> ] [ --stock <fluoride> ] ]\n"
+		"\t[ --policy <scripted|optimal|mcts|greedy|conservative|maxdip>\n"
+		"\t  [ --mcts-time <ms> ] [ --mcts-nodes <n> ] ]\n"
+		"\t[ --tournament <policy,...> [ --tournament-games <n> ] [ --threads <n> ] ]\n"
+		"\t[ --analyze [ --threads <n> ] ]\n"
+		"\t[ --balance <games> [ --balance-tables <file> ] [ --balance-store <file> ]\n"
+		"\t  [ --threads <n> ] ]\n"
+		"\t[ --tune <targets> --tune-params <bounds> [ --tune-candidates <n> ] ]\n"
+		"\t[ --cache <dir> [ --cache-size <MB> ] ]\n"
+		"\t[ --sweep <games> --sweep-dir <dir> [ --shards <n> ] [ --shard <i> ] ]\n"
+		"\t[ --merge <dir> ]\n"
+		"\t[ --solve <table> ] [ --validate-tables ]\n", __progname);
 	exit(EXIT_FAILURE);
 }
 
 
+/*
+ * Seeded headless runs whose results cannot depend on the clock may be
+ * answered from the cache
+ */
+static int
+cacheable(int seeded)
+{
+	return seeded && !(policy_cfg.name != NULL && strcmp(policy_cfg.name, "mcts") == 0 &&
+			   policy_cfg.budget_us > 0);
+}
+
+/* A cache hit keeps the timing of the run that stored it; say so */
+static void
+print_cached(FILE * out)
+{
+	fprintf(out, "From the cache: the time and threads are those of the run that stored it\n");
+}
+
 static char	inline *
 return_concat_homedir(const char *append_str)
 {
@@ -136,19 +178,6 @@ return_concat_homedir(const char *append_str)
 }
 
 
-static int	inline
-choose_random_tool(const int *isdaggerset)
-{
-
-	if (*isdaggerset) {
-		return arc4random_uniform(3) + 3;	/* daggers idx 3, 4, or
-							 * 5 */
-	} else {
-		return arc4random_uniform(3);
-	}
-}
-
-
 static inline
 int
 check_file(const char *filename)
@@ -183,13 +212,8 @@ static void
 init_game_state(const int bflag, game_state_type * state)
 {
 
-	state->fluoride = DEFAULT_FLUORIDE;
-	state->tool_dip = DEFAULT_TOOL_DIP;
-	state->tool_effort = DEFAULT_TOOL_EFFORT;
-	state->fluoride_used = DEFAULT_FLUORIDE_USED;
+	engine_init_state(state);
 	state->bflag = bflag;
-	state->score = DEFAULT_SCORE;
-	state->turns = DEFAULT_TURNS;
 
 	/* If bflag is set, we will use the user login name */
 	if (bflag) {
@@ -201,36 +225,91 @@ init_game_state(const int bflag, game_state_type * state)
 		strlcpy(character_name, DEFAULT_CHARACTER_NAME, sizeof(DEFAULT_CHARACTER_NAME));
 
 	state->character_name = character_name;
-	state->tool_in_use = choose_random_tool(&state->daggerset);
-
-	for (int i = 0; i < 4; i++) {
-		state->last_tool_dip[i] = DEFAULT_TOOL_DIP;
-		state->last_tool_effort[i] = DEFAULT_TOOL_EFFORT;
-	}
 }
+
+
+/*
+ * "?" at the dip prompt: what each dip and effort pair after it would do
+ * to the fang, or every dip of the tool at the fang's last effort when
+ * none is given. A pair missing its effort takes the last one too.
+ */
 static void
-randomize_fangs(patient_type * pat)
+print_preview(const struct buffy_ctx * ctx, const char *input)
 {
-	for (int i = 0; i < 4; i++) {
-		pat->fangs[i].length = 4 + arc4random_uniform(3);	/* 4–6 */
-		pat->fangs[i].sharpness = 5 + arc4random_uniform(4);	/* 5–8 */
-
-		/* Bias health toward lower values (dirty teeth) */
-		int		r = arc4random_uniform(MAX_HEALTH);
-		if (r < 60)
-			pat->fangs[i].health = 60 + arc4random_uniform(11);	/* 60–70 */
-		else if (r < 90)
-			pat->fangs[i].health = 71 + arc4random_uniform(10);	/* 71–80 */
-		else
-			pat->fangs[i].health = 90 + arc4random_uniform(11);	/* 90–100 */
+	struct buffy_input cand[PREVIEW_MAX];
+	struct buffy_preview out[PREVIEW_MAX];
+	patient_type	shown;
+	char		mood_str[16], pat_str[16];
+	const char     *p = input;
+	char	       *end;
+	int		last = ctx->state.last_tool_effort[ctx->fang];
+	int		n = 0;
+
+	memset(cand, 0, sizeof(cand));
+	while (n < PREVIEW_MAX) {
+		long		dip, effort;
+
+		dip = strtol(p, &end, 10);
+		if (end == p)
+			break;
+		p = end;
+		effort = strtol(p, &end, 10);
+		if (end == p)
+			effort = last;
+		p = end;
+		if (dip < 0 || effort < 0) {
+			my_print_err("Preview needs non-negative dip and effort pairs.\n");
+			return;
+		}
+		cand[n].dip = (int)dip;
+		cand[n++].effort = (int)effort;
 	}
+	if (n == 0)
+		for (int d = 0; d <= engine_live->tools[ctx->state.tool_in_use].dip_amount && n < PREVIEW_MAX; d++) {
+			cand[n].dip = d;
+			cand[n++].effort = last;
+		}
+
+	buffy_preview(ctx, cand, n, out);
+	memset(&shown, 0, sizeof(shown));
+	for (int i = 0; i < n; i++) {
+		if (out[i].used == -1) {
+			my_printf("  dip %d, effort %d: not enough fluoride (%d left)\n",
+				  out[i].dip, out[i].effort, ctx->state.fluoride);
+			continue;
+		}
+		shown.mood = out[i].mood;
+		shown.patience_level = out[i].patience_level;
+		get_patient_state_strings(&shown, mood_str, pat_str);
+		my_printf("  dip %d, effort %d: health %d -> %d, fluoride %d -> %d, %s/%s\n",
+			  out[i].dip, out[i].effort, ctx->pat.fangs[ctx->fang].health, out[i].health,
+			  ctx->state.fluoride, out[i].fluoride, mood_str, pat_str);
+	}
+	my_refresh();
 }
 
+/* get_input(), or against the clock under --realtime */
+static void
+read_line(const char *prompt, char *buffer, size_t size)
+{
+	if (realtime_tick)
+		rt_get_input(&rt, prompt, buffer, size);
+	else
+		get_input(prompt, buffer, size);
+}
 
+/* What the player asked for at the dip prompt */
+enum provider_cmd {
+	CMD_STROKE,
+	CMD_UNDO,
+	CMD_REDO
+};
 
-static void
-get_provider_input(const int *current_tool, int *tool_dip, int *tool_effort, const game_state_type * state)
+static enum provider_cmd
+get_provider_input(const int *current_tool, int *tool_dip, int *tool_effort, const struct buffy_ctx * ctx,
+		   const struct buffy_history * hist)
 {
+	const game_state_type *state = &ctx->state;
 	int		valid = 0;
 	char		input[32];
 	char	       *endptr;
@@ -239,12 +318,28 @@ get_provider_input(const int *current_tool, int *tool_dip, int *tool_effort, con
 	/* Prompt for tool dip */
 	while (!valid) {
 		prompt[0] = 0;
-		snprintf(prompt, sizeof(prompt), "How much to dip the %s in the fluoride [%d]? ", tools[state->tool_in_use].name, state->last_tool_dip[*current_tool]);
-		get_input(prompt, input, sizeof(input));
+		snprintf(prompt, sizeof(prompt), "How much to dip the %s in the fluoride [%d]? ", engine_live->tools[state->tool_in_use].name, state->last_tool_dip[*current_tool]);
+		read_line(prompt, input, sizeof(input));
 		if (strlen(input) == 0 && state->using_curses < 1) {
 			my_print_err("Input error. Please try again.\n");
 			continue;
 		}
+		if (input[0] == '?') {
+			print_preview(ctx, input + 1);
+			continue;
+		}
+		if (input[0] == 'u' || input[0] == 'r') {
+			/* A recording only holds the strokes that were kept */
+			if (recorder != NULL)
+				my_print_err("Undo and redo are off while recording.\n");
+			else if (input[0] == 'u' && buffy_undos(hist) == 0)
+				my_print_err("Nothing to undo.\n");
+			else if (input[0] == 'r' && !buffy_can_redo(ctx, hist))
+				my_print_err("Nothing to redo.\n");
+			else
+				return input[0] == 'u' ? CMD_UNDO : CMD_REDO;
+			continue;
+		}
 		/* If user just presses enter, use last value */
 		if (input[0] == '\n' || strlen(input) == 0) {
 			*tool_dip = state->last_tool_dip[*current_tool];
@@ -253,7 +348,7 @@ get_provider_input(const int *current_tool, int *tool_dip, int *tool_effort, con
 		}
 		*tool_dip = (int)strtol(input, &endptr, 10);
 		if (endptr == input || *tool_dip < 0) {
-			my_print_err("Invalid input for %s dip. Please enter a non-negative integer.\n", tools[state->tool_in_use].name);
+			my_print_err("Invalid input for %s dip. Please enter a non-negative integer.\n", engine_live->tools[state->tool_in_use].name);
 			continue;
 		}
 		valid = 1;
@@ -263,7 +358,7 @@ get_provider_input(const int *current_tool, int *tool_dip, int *tool_effort, con
 	/* Prompt for tool effort */
 	while (!valid) {
 		snprintf(prompt, sizeof(prompt), "How much effort to apply to the fang [%d]? ", state->last_tool_effort[*current_tool]);
-		get_input(prompt, input, sizeof(input));
+		read_line(prompt, input, sizeof(input));
 		if (strlen(input) == 0 && state->using_curses < 1) {
 			my_print_err("Input error. Please try again.\n");
 			continue;
@@ -275,74 +370,15 @@ get_provider_input(const int *current_tool, int *tool_dip, int *tool_effort, con
 		}
 		*tool_effort = (int)strtol(input, &endptr, 10);
 		if (endptr == input || *tool_effort < 0) {
-			my_print_err("Invalid input for %s effort. Please enter a non-negative integer.\n", tools[state->tool_in_use].name);
+			my_print_err("Invalid input for %s effort. Please enter a non-negative integer.\n", engine_live->tools[state->tool_in_use].name);
 			continue;
 		}
 		valid = 1;
 	}
+	return CMD_STROKE;
 }
 
 
-static int
-calculate_fluoride_used_from_dip(int tool_dip, game_state_type * state)
-{
-
-
-	/*
-	 * Cap dip and effort to tool's maximum values
-	 */
-	if (tool_dip > tools[state->tool_in_use].dip_amount)
-		tool_dip = tools[state->tool_in_use].dip_amount;
-
-	int		length = tools[state->tool_in_use].length;
-	int		dip = tool_dip * length;
-
-	int		used = dip;	/* Only dip amount uses fluoride */
-
-	if (used > state->fluoride) {
-		return -1;
-	}
-
-	state->fluoride_used = used;
-	state->fluoride -= used;
-	return used;
-}
-
-static void
-calculate_fang_health(const game_state_type * state, patient_fangs_type * fang, int fluoride_on_tool, int tool_effort)
-{
-	/* Cap fluoride and effort to tool's max */
-	if (fluoride_on_tool > tools[state->tool_in_use].dip_amount)
-		fluoride_on_tool = tools[state->tool_in_use].dip_amount;
-	if (tool_effort > tools[state->tool_in_use].effort)
-		tool_effort = tools[state->tool_in_use].effort;
-
-	int		effectiveness = tools[state->tool_in_use].effectiveness;
-	int		durability = tools[state->tool_in_use].durability;
-
-	/* Health gain formula includes effectiveness and durability */
-	int		health_gain = ((fluoride_on_tool / 2) + (tool_effort / 3)) * effectiveness * durability / 100;
-
-	/* Adjust health gain based on patient species */
-	if (state->patient_idx == VAMPIRE) {
-		health_gain += 2;
-	} else if (state->patient_idx == ORC) {
-		health_gain -= 1;
-	} else if (state->patient_idx == WEREWOLF) {
-		health_gain += 1;
-	} else if (state->patient_idx == SERPENT) {
-		health_gain = (int)(health_gain * 0.8);
-	} else if (state->patient_idx == DRAGON) {
-		health_gain = (int)(health_gain * 0.5);
-	}
-
-	fang->health += health_gain;
-	if (fang->health > MAX_HEALTH)
-		fang->health = MAX_HEALTH;
-	else if (fang->health < 0)
-		fang->health = 0;
-}
-
 static inline char *
 fang_health_to_color(const int health)
 {
@@ -368,6 +404,12 @@ fang_idx_to_name(const int fang_index)
 	case 3:
 		return "Mandibular Right Canine";
 	}
+	if (fang_index > 3 && fang_index < NUM_FANGS) {
+		static char	name[32];
+
+		snprintf(name, sizeof(name), "Tooth %d", fang_index + 1);
+		return name;
+	}
 	return "Unknown Fang";
 }
 
@@ -427,11 +469,11 @@ print_patient_info(const game_state_type * state, const patient_type * pat, cons
 static void
 print_tool_info(const game_state_type * state)
 {
-	my_printf("Using tool: %s\n", tools[state->tool_in_use].name);
-	my_printf("Tool Description: %s\n", tools[state->tool_in_use].description);
-	my_printf("Tool Dip Amount: %d\n", tools[state->tool_in_use].dip_amount);
-	my_printf("Tool Effort: %d\n", tools[state->tool_in_use].effort);
-	my_printf("Tool Durability: %d\n", tools[state->tool_in_use].durability);
+	my_printf("Using tool: %s\n", engine_live->tools[state->tool_in_use].name);
+	my_printf("Tool Description: %s\n", engine_live->tools[state->tool_in_use].description);
+	my_printf("Tool Dip Amount: %d\n", engine_live->tools[state->tool_in_use].dip_amount);
+	my_printf("Tool Effort: %d\n", engine_live->tools[state->tool_in_use].effort);
+	my_printf("Tool Durability: %d\n", engine_live->tools[state->tool_in_use].durability);
 }
 
 
@@ -447,22 +489,6 @@ print_game_state(const game_state_type * state)
 
 
 
-static void
-patient_init(game_state_type * state, patient_type * pat)
-{
-	/* Choose a random patient from the patients array */
-	int		idx = arc4random_uniform(sizeof(patients) / sizeof(patients[0]));
-	struct patient *chosen = &patients[idx];
-
-	/* Copy chosen patient's data */
-	pat->age = chosen->age;
-	state->patient_idx = idx;
-	/* Randomize fangs for this patient */
-	randomize_fangs(pat);
-
-	pat->patience = chosen->patience;
-}
-
 /*
  * We want to do certain things on game end, like printing the game state and
  * the patient information, so we define a function to do that
@@ -483,31 +509,28 @@ continuation_err(const game_state_type * state, const patient_type * pat)
 	print_game_state(state);
 	print_patient_info(state, pat, 0);
 
-	print_fang_info(0, &pat->fangs[0], 1);
-	print_fang_info(1, &pat->fangs[1], 1);
-	print_fang_info(2, &pat->fangs[2], 1);
-	print_fang_info(3, &pat->fangs[3], 1);
+	for (int i = 0; i < NUM_FANGS; i++)
+		print_fang_info(i, &pat->fangs[i], 1);
 	print_tool_info(state);
 	my_printf("Buffy the Fluoride Dispenser: Fang Edition is done!\n");
 }
 
-static int	inline
-all_fangs_healthy(const patient_type * pat)
-{
-	for (int i = 0; i < 4; i++) {
-		if (pat->fangs[i].health < MAX_HEALTH) {
-			return -1;
-		}
-	}
-	return 0;
-}
-
 
+/*
+ * The interactive host of the engine in libbuffy.c: it shows each event
+ * and gathers the input the next step needs from the player or a policy.
+ */
 static int
 apply_fluoride_to_fangs(game_state_type * state, patient_type * pat)
 {
-	int		tool_dip = DEFAULT_TOOL_DIP;
-	int		tool_effort = DEFAULT_TOOL_EFFORT;
+	static struct buffy_history hist;
+	struct buffy_ctx ctx;
+	struct buffy_event ev[BUFFY_MAX_EVENTS];
+	struct buffy_input in = {DEFAULT_TOOL_DIP, DEFAULT_TOOL_EFFORT, ENGINE_CONTINUE};
+	enum provider_cmd cmd = CMD_STROKE;
+
+	if (player != NULL)
+		policy_new_game(player);
 
 	/* Initialize game state */
 	print_fang_logo();
@@ -516,142 +539,211 @@ apply_fluoride_to_fangs(game_state_type * state, patient_type * pat)
 	my_refresh();
 	sleep(4);
 
-	/* Main cleaning loop */
-	int		cleaning = 1;
-	do {
-		char		answer[4];
-		char	       *fangs_formatted;
-		char		reaction[160];
-		const int	MAX_FANGS = 4;
-
-		/* Process each fang */
-		for (int i = 0; i < MAX_FANGS; i++) {	
-			/* Skip fangs that are already healthy */
-			if (pat->fangs[i].health >= MAX_HEALTH) {
-				my_printf("Fang %s is already healthy and shiny!\n", fang_idx_to_name(i));
-				continue;
-			}
-
-			/* Display fang art based on position */
-			my_werase();
-			if (IS_UPPER_FANG) {
-				fangs_formatted = fang_art(UPPER_FANGS, FANG_ROWS_UPPER,
-				   pat->fangs[MAXILLARY_LEFT_CANINE].health,
-				 pat->fangs[MAXILLARY_RIGHT_CANINE].health);
-			} else {
-				fangs_formatted = fang_art(LOWER_FANGS, FANG_ROWS_LOWER,
-				  pat->fangs[MANDIBULAR_LEFT_CANINE].health,
-				pat->fangs[MANDIBULAR_RIGHT_CANINE].health);
-			}
-
-			my_printf("%s", fangs_formatted);
-			print_working_info("Applying fluoride to %s's fang %s:\n",
-					   PATIENT_NAME(state->patient_idx), fang_idx_to_name(i));
+	/* The engine plays its own copy of the game from here on */
+	buffy_resume(&ctx, state, pat);
+	ctx.pat.name = roster_name;
+	buffy_history_init(&hist);
+	state = &ctx.state;
+	pat = &ctx.pat;
+	if (realtime_tick)
+		rt_start(&rt, realtime_tick, &ctx);
 
-			print_fang_info(i, &pat->fangs[i], 1);
-			print_stats_info(state, pat);
+	/* Main cleaning loop */
+	while (ctx.need != BUFFY_NEED_NONE) {
+		int		n;
 
-			my_refresh();
-			get_provider_input(&i, &tool_dip, &tool_effort, state);
+		/* Between strokes, the only time the rules may change */
+		if (watching) {
+			char	       *note;
 
-			patient_reaction(reaction, sizeof(reaction), &tool_effort, pat,
-				     &tools[state->tool_in_use].pain_factor,
-				       PATIENT_NAME(state->patient_idx), i);
+			watch_quiesce(&watch);
+			if ((note = watch_note(&watch)) != NULL) {
+				my_printf("%s\n", note);
+				free(note);
+			}
+		}
 
-			/* Handle reaction display */
-			if (reaction[0] != '\0' && !state->using_curses)
-				comment_printf(reaction);
+		if (cmd == CMD_UNDO) {
+			n = buffy_undo(&ctx, &hist, ev);
+			my_printf("Took back the stroke on fang %s.\n", fang_idx_to_name(ctx.fang));
+		} else if (cmd == CMD_REDO)
+			n = buffy_redo(&ctx, &hist, ev);
+		else
+			n = buffy_play(&ctx, &hist, &in, ev);
+		cmd = CMD_STROKE;
 
-			/* Update state variables */
-			state->tool_dip = tool_dip;
-			state->tool_effort = tool_effort;
-			state->last_tool_dip[i] = tool_dip;
-			state->last_tool_effort[i] = tool_effort;
+		for (int k = 0; k < n; k++) {
+			char		answer[4];
+			char	       *fangs_formatted;
+			char		reaction[160];
+			int		i = ev[k].fang;
 
-			/* Check fluoride availability */
-			if ((state->fluoride_used = calculate_fluoride_used_from_dip(tool_dip, state)) == -1)
-				goto no_fluoride_left;
+			switch (ev[k].type) {
+			case BUFFY_EV_SKIP:
+				my_printf("Fang %s is already healthy and shiny!\n", fang_idx_to_name(i));
+				break;
+			case BUFFY_EV_ASK_STROKE:
+				/* Display fang art based on position */
+				my_werase();
+				if (IS_UPPER_FANG) {
+					fangs_formatted = fang_art(UPPER_FANGS, FANG_ROWS_UPPER,
+					   pat->fangs[MAXILLARY_LEFT_CANINE].health,
+					 pat->fangs[MAXILLARY_RIGHT_CANINE].health);
+				} else {
+					fangs_formatted = fang_art(LOWER_FANGS, FANG_ROWS_LOWER,
+					  pat->fangs[MANDIBULAR_LEFT_CANINE].health,
+					pat->fangs[MANDIBULAR_RIGHT_CANINE].health);
+				}
+
+				my_printf("%s", fangs_formatted);
+				print_working_info("Applying fluoride to %s's fang %s:\n",
+						   PATIENT_NAME(state->patient_idx), fang_idx_to_name(i));
+
+				print_fang_info(i, &pat->fangs[i], 1);
+				/* The art only has room for the canines */
+				if (NUM_FANGS > 4 && dent_dirtiest(&ctx.teeth) >= 0) {
+					int		d = dent_dirtiest(&ctx.teeth);
+
+					my_printf("%d of %d teeth to go, the dirtiest is %s at %d.\n",
+						  ctx.teeth.bits.count, NUM_FANGS, fang_idx_to_name(d),
+						  pat->fangs[d].health);
+				}
+				print_stats_info(state, pat);
 
-			/* Calculate fang health */
-			calculate_fang_health(state, &pat->fangs[i], state->fluoride_used, tool_effort);
+				my_refresh();
+				if (player != NULL) {
+					policy_choose(player, state, pat, i, &in.dip, &in.effort);
+					my_printf("%s picks dip %d and effort %d.\n",
+						  player->name, in.dip, in.effort);
+				} else
+					cmd = get_provider_input(&i, &in.dip, &in.effort, &ctx, &hist);
+				break;
+			case BUFFY_EV_STROKE:
+				replay_record_stroke(recorder, ev[k].dip, ev[k].effort, ev[k].checksum);
+				buffy_reaction_text(&ctx, &ev[k], reaction, sizeof(reaction));
 
-			/* Update score */
-			state->score += BONUS_FANG_CLEANED;
-			if (pat->fangs[i].health >= MAX_HEALTH)
-				state->score += BONUS_FANG_HEALTH;
+				/* Handle reaction display */
+				if (reaction[0] != '\0' && !state->using_curses)
+					comment_printf(reaction);
 
-			/* Display updated stats if curses */
-			if (state->using_curses)
-				print_stats_info(state, pat);
+				/* Out of fluoride; the game over event follows */
+				if (ev[k].used == -1)
+					break;
 
-			if (reaction[0] && state->using_curses)
-				comment_printf(reaction);
+				/* Display updated stats if curses */
+				if (state->using_curses)
+					print_stats_info(state, pat);
 
-			my_refresh();
+				if (reaction[0] && state->using_curses)
+					comment_printf(reaction);
 
-			/* Debug logging */
-			if (debugging)
-				log_game_turn(state->turns, state, pat, reaction);
-		}
+				my_refresh();
 
-		/* Increment turn and check for completion */
-			state->turns++;
-		state->score += BONUS_TURN_COMPLETE;
-
-		if (all_fangs_healthy(pat) == 0)
-			goto success;
-
-		/* Ask user for continuation */
-		get_input("Continue applying fluoride to fangs? (y/q/s): ", answer, sizeof(answer));
-
-		if (answer[0] == 'y' || answer[0] == 'Y' || answer[0] == '\n' || strlen(answer) == 0) {
-			/* All tools use some fluoride */
-			my_printf("%s applies fluoride to %s's fangs with the %s.\n",
-					  state->character_name, PATIENT_NAME(state->patient_idx),
-					  tools[state->tool_in_use].name);
-			my_printf("%s dip effort: %d\n", tools[state->tool_in_use].name, tool_effort);
-		} else if (answer[0] == 'q' || answer[0] == 'Q') {
-			cleaning = 0;
-			goto quit_game;
-		} else if (answer[0] == 's' || answer[0] == 'S') {
-			goto save_game;
-		} else {
-			goto success;
+				/* Debug logging */
+				if (debugging)
+					log_game_turn(state->turns, state, pat, reaction);
+				break;
+			case BUFFY_EV_ASK_ANSWER:
+				/* Ask user for continuation */
+				if (player != NULL) {
+					/* A policy keeps going until the game stalls */
+					strlcpy(answer, player->hopeless || state->turns > SIM_MAX_TURNS ? "q" : "y", sizeof(answer));
+					my_printf("Continue applying fluoride to fangs? (y/q/s): %s\n", answer);
+				} else
+					read_line("Continue applying fluoride to fangs? (y/q/s): ", answer, sizeof(answer));
+				in.answer = engine_continue_choice(answer);
+
+				/* A save holds the species, not the creature and tool dealt */
+				while (in.answer == ENGINE_SAVE && roster.map != NULL) {
+					my_print_err("A game dealt from a --roster cannot be saved.\n");
+					read_line("Continue applying fluoride to fangs? (y/q): ", answer, sizeof(answer));
+					in.answer = engine_continue_choice(answer);
+				}
+				replay_record_answer(recorder, in.answer);
+
+				if (in.answer == ENGINE_CONTINUE) {
+					/* All tools use some fluoride */
+					my_printf("%s applies fluoride to %s's fangs with the %s.\n",
+						  state->character_name, PATIENT_NAME(state->patient_idx),
+						  engine_live->tools[state->tool_in_use].name);
+					my_printf("%s dip effort: %d\n", engine_live->tools[state->tool_in_use].name, in.effort);
+				}
+				break;
+			case BUFFY_EV_ROUND:
+			case BUFFY_EV_OVER:
+				break;
+			}
 		}
+	}
 
-	} while (cleaning);
-
-success:
-	end_curses();
-	my_printf("%s has successfully cleaned all of %s's fangs.\n",
-		  state->character_name, PATIENT_NAME(state->patient_idx));
-	state->score += BONUS_ALL_HEALTH;
-	print_game_state(state);
+	switch (ctx.outcome) {
+	case BUFFY_WIN:
+		end_curses();
+		my_printf("%s has successfully cleaned all of %s's fangs.\n",
+			  state->character_name, PATIENT_NAME(state->patient_idx));
+		replay_record_end(recorder, REPLAY_WIN, state);
+		print_game_state(state);
+		break;
+	case BUFFY_SAVE:
+		end_curses();
+		replay_record_end(recorder, REPLAY_SAVE, state);
+		my_printf("Saving game to: %s\n", save_path);
+		save_game(state, sizeof(game_state), pat, sizeof(patient));
+		print_game_state(state);
+		break;
+	case BUFFY_QUIT:
+		end_curses();
+		replay_record_end(recorder, REPLAY_QUIT, state);
+		my_printf("%s quits the game.\n", state->character_name);
+		print_game_state(state);
+		break;
+	case BUFFY_NO_FLUORIDE:
+		replay_record_end(recorder, REPLAY_NO_FLUORIDE, state);
+		my_print_err("Fluoride used (%d) exceeds available fluoride (%d).\n",
+			     state->fluoride_used, state->fluoride);
+		end_curses();
+		continuation_err(state, pat);
+		break;
+	}
+	if (realtime_tick) {
+		rt_stop(&rt);
+		rt_report(&rt);
+	}
+	if (watching)
+		watch_stop(&watch);
 	return 0;
+}
 
-save_game:
-	end_curses();
-	my_printf("Saving game to: %s\n", save_path);
-	save_game(state, sizeof(game_state), pat, sizeof(patient));
-	print_game_state(state);
-	return 0;
 
-quit_game:
-	end_curses();
-	my_printf("%s quits the game.\n", state->character_name);
-	print_game_state(state);
-	return 0;
 
-no_fluoride_left:
-	my_print_err("Fluoride used (%d) exceeds available fluoride (%d).\n",
-		     state->fluoride_used, state->fluoride);
-	end_curses();
-	continuation_err(state, pat);
-	return 0;
+/*
+ * Swap the dealt patient for a creature of the --band from the roster, and
+ * the dealt tool for one of the roster's of the same kind if it has any.
+ * The creature plays as its species; the tool goes in a copy of the rules
+ * that the game plays by, leaving tools[] as built.
+ */
+static void
+roster_deal(game_state_type * state, patient_type * pat)
+{
+	const struct roster_patient *rp = &roster.patient[roster_pick_patient(&roster, band_lo, band_hi)];
+	long		t = roster_pick_tool(&roster, state->daggerset);
+
+	free(roster_name);
+	if ((roster_name = strdup(roster_str(&roster, rp->name))) == NULL)
+		err(1, "roster");
+	state->patient_idx = rp->species;
+	pat->age = rp->age;
+	pat->patience = rp->patience;
+	pat->pain_tolerance = rp->pain_tolerance;
+	if (t != -1) {
+		roster_rules = engine_rules;
+		roster_tool(&roster, (uint32_t)t, &roster_rules.tools[state->tool_in_use]);
+		if (engine_rules_build(&roster_rules) == -1)
+			errx(1, "%s does not fit the turn tables", roster_rules.tools[state->tool_in_use].name);
+		engine_live = &roster_rules;
+	}
 }
 
-
-
 static int
 main_program(const int reloadflag, game_state_type * state)
 {
@@ -660,8 +752,15 @@ main_program(const int reloadflag, game_state_type * state)
 	 * it again
 	 */
 	if (!reloadflag) {
+		/*
+		 * Deal from the start of the seed's stream, so a recording or
+		 * game 0 of a simulation with the same seed gets this game.
+		 */
+		rng_set_seed(rng_get_seed());
 		init_game_state(state->bflag, &game_state);
 		patient_init(&game_state, &patient);
+		if (roster.map != NULL)
+			roster_deal(&game_state, &patient);
 	}
 
 	/* Use dagger only with --daggerset option */
@@ -673,6 +772,10 @@ main_program(const int reloadflag, game_state_type * state)
 		state->tool_effort = DEFAULT_DAGGER_EFFORT;
 	}
 
+	/* Over the tools as dealt, before curses so a failure can be read */
+	if (watching && watch_start(&watch) == -1)
+		exit(EXIT_FAILURE);
+
 	initialize_curses();
 #ifdef __OpenBSD__
 
@@ -686,6 +789,8 @@ main_program(const int reloadflag, game_state_type * state)
 			errx(1, "unveil");
 			return EXIT_FAILURE;
 		}
+	if (watching && unveil(watch.dir, "r") == -1)
+		err(1, "unveil");
 
 	if (pledge("stdio rpath wpath cpath proc unveil tty", NULL) == -1)
 		errx(1, "pledge");
@@ -701,7 +806,44 @@ main(int argc, char *argv[])
 	int		ch;
 	int		fflag = 0;
 	int		curses = 0;
+	long		simulate = 0;
+	long		threads = 0;
+	int		batch = 0;
+	int		analyze = 0;
+	long		balance = 0;
+	const char     *balance_path = NULL;
+	const char     *balance_store = NULL;
+	const char     *tune_targets = NULL;
+	const char     *tune_params = NULL;
+	long		tune_candidates = TUNE_CANDIDATES;
+	const char     *cache_path = NULL;
+	long		cache_mb = CACHE_DEFAULT_MB;
+	long		sweep = 0;
+	long		nshards = SWEEP_SHARDS;
+	long		shard = -1;
+	const char     *sweep_dir = NULL;
+	const char     *merge_dir = NULL;
+	const char     *tournament = NULL;
+	long		tournament_games = TOURNAMENT_GAMES;
+	long		tick = 0;
+	const char     *roster_path = NULL;
+	const char     *watch_path = NULL;
+	long		clinic = 0;
+	long		hygienists = 0;
+	long		arrival = 0;
+	long long	stock = 0;
+	int		banded = 0;
+	char		band_end;
+	int		seeded = 0;
+	uint64_t	seed;
+	const char     *record_path = NULL;
+	const char     *replay_path = NULL;
+	struct solver_table optimal_table;
+	double		ms;
+	const char     *solve_path = NULL;
+	const char     *optimal_path = NULL;
 	char		login_name[256];
+	char	       *endptr;
 
 	/* options descriptor */
 	static struct option longopts[] = {
@@ -713,14 +855,53 @@ main(int argc, char *argv[])
 		{"version", no_argument, NULL, 'v'},
 		{"fluoride-file", required_argument, NULL, 'f'},
 		{"daggerset", no_argument, &game_state.daggerset, 1},
+		{"simulate", required_argument, NULL, 'S'},
+		{"threads", required_argument, NULL, 'T'},
+		{"solve", required_argument, NULL, 'P'},
+		{"optimal", required_argument, NULL, 'O'},
+		{"validate-tables", no_argument, NULL, 'V'},
+		{"batch", no_argument, NULL, 'B'},
+		{"batch-kernel", required_argument, NULL, 'K'},
+		{"seed", required_argument, NULL, 'R'},
+		{"record", required_argument, NULL, 'W'},
+		{"replay", required_argument, NULL, 'Y'},
+		{"policy", required_argument, NULL, 'L'},
+		{"mcts-time", required_argument, NULL, 'M'},
+		{"mcts-nodes", required_argument, NULL, 'N'},
+		{"analyze", no_argument, NULL, 'A'},
+		{"balance", required_argument, NULL, 'G'},
+		{"balance-tables", required_argument, NULL, 'H'},
+		{"balance-store", required_argument, NULL, 'J'},
+		{"tune", required_argument, NULL, 'U'},
+		{"tune-params", required_argument, NULL, 'X'},
+		{"tune-candidates", required_argument, NULL, 'C'},
+		{"cache", required_argument, NULL, 'D'},
+		{"cache-size", required_argument, NULL, 'Z'},
+		{"sweep", required_argument, NULL, 'Q'},
+		{"sweep-dir", required_argument, NULL, 'F'},
+		{"shards", required_argument, NULL, 'I'},
+		{"shard", required_argument, NULL, 'E'},
+		{"merge", required_argument, NULL, 'g'},
+		{"tournament", required_argument, NULL, 'k'},
+		{"tournament-games", required_argument, NULL, 'n'},
+		{"realtime", no_argument, NULL, 'r'},
+		{"tick", required_argument, NULL, 't'},
+		{"roster", required_argument, NULL, 'o'},
+		{"band", required_argument, NULL, 'd'},
+		{"balance-watch", required_argument, NULL, 'w'},
+		{"clinic", required_argument, NULL, 'a'},
+		{"hygienists", required_argument, NULL, 'h'},
+		{"arrival", required_argument, NULL, 'e'},
+		{"stock", required_argument, NULL, 's'},
 	{NULL, 0, NULL, 0}};
 
 #ifdef __OpenBSD__
 
-	if (pledge("stdio rpath wpath cpath unveil proc tty", NULL) == -1)
+	if (pledge("stdio rpath wpath cpath fattr unveil proc tty", NULL) == -1)
 		errx(1, "pledge");
 #endif
 	*save_path = '\0';
+	engine_tables_init();
 	while ((ch = getopt_long(argc, argv, "cbvf:", longopts, NULL)) != -1)
 		switch (ch) {
 		case 'v':
@@ -785,6 +966,170 @@ main(int argc, char *argv[])
 
 			}
 			break;
+		case 'S':
+			simulate = strtol(optarg, &endptr, 10);
+			if (endptr == optarg || *endptr != '\0' || simulate < 1)
+				errx(1, "--simulate needs a positive number of games");
+			break;
+		case 'T':
+			threads = strtol(optarg, &endptr, 10);
+			if (endptr == optarg || *endptr != '\0' || threads < 1 || threads > 1024)
+				errx(1, "--threads needs a number from 1 to 1024");
+			break;
+		case 'P':
+			solve_path = optarg;
+			break;
+		case 'O':
+			optimal_path = optarg;
+			break;
+		case 'B':
+			batch = 1;
+			break;
+		case 'K':
+			if (batch_set_kernel(optarg) == -1)
+				errx(1, "--batch-kernel needs one of auto, scalar, sse4.1 "
+				     "or avx2 that this machine supports");
+			batch = 1;
+			break;
+		case 'R':
+			if (rng_parse_seed(optarg, &seed) == -1)
+				errx(1, "--seed needs a decimal or 0x hex number");
+			rng_set_seed(seed);
+			seeded = 1;
+			break;
+		case 'W':
+			record_path = optarg;
+			break;
+		case 'Y':
+			replay_path = optarg;
+			break;
+		case 'r':
+			if (realtime_tick == 0)
+				realtime_tick = RT_TICK_MS;
+			break;
+		case 't':
+			tick = strtol(optarg, &endptr, 10);
+			if (endptr == optarg || *endptr != '\0' || tick < 1 || tick > 1000)
+				errx(1, "--tick needs a number of milliseconds from 1 to 1000");
+			break;
+		case 'o':
+			roster_path = optarg;
+			break;
+		case 'd':
+			if (sscanf(optarg, "%d:%d%c", &band_lo, &band_hi, &band_end) != 2 ||
+			    band_lo < 0 || band_lo > band_hi || band_hi > ROSTER_DIFFICULTY_MAX)
+				errx(1, "--band needs difficulties lo:hi within 0:%d", ROSTER_DIFFICULTY_MAX);
+			banded = 1;
+			break;
+		case 'w':
+			watch_path = optarg;
+			break;
+		case 'a':
+			clinic = strtol(optarg, &endptr, 10);
+			if (endptr == optarg || *endptr != '\0' || clinic < 1)
+				errx(1, "--clinic needs a positive number of patients");
+			break;
+		case 'h':
+			hygienists = strtol(optarg, &endptr, 10);
+			if (endptr == optarg || *endptr != '\0' || hygienists < 1 || hygienists > CLINIC_MAX_HYGIENISTS)
+				errx(1, "--hygienists needs a number from 1 to %d", CLINIC_MAX_HYGIENISTS);
+			break;
+		case 'e':
+			arrival = strtol(optarg, &endptr, 10);
+			if (endptr == optarg || *endptr != '\0' || arrival < 1 || arrival > 86400)
+				errx(1, "--arrival needs a mean of 1 to 86400 seconds between patients");
+			break;
+		case 's':
+			stock = strtoll(optarg, &endptr, 10);
+			if (endptr == optarg || *endptr != '\0' || stock < 1)
+				errx(1, "--stock needs a positive amount of fluoride");
+			break;
+		case 'L':
+			if (!policy_known(optarg))
+				errx(1, "--policy needs one of scripted, optimal, mcts, greedy, "
+				     "conservative or maxdip");
+			policy_cfg.name = optarg;
+			break;
+		case 'M':
+			ms = strtod(optarg, &endptr);
+			if (endptr == optarg || *endptr != '\0' || ms < 0 || ms > 60000)
+				errx(1, "--mcts-time needs milliseconds from 0 to 60000");
+			policy_cfg.budget_us = (long)(ms * 1000);
+			break;
+		case 'N':
+			policy_cfg.nodes = strtol(optarg, &endptr, 10);
+			if (endptr == optarg || *endptr != '\0' || policy_cfg.nodes < 0)
+				errx(1, "--mcts-nodes needs a non-negative number");
+			break;
+		case 'A':
+			/* analyze_cell() walks 32^NUM_FANGS dealt healths */
+			if (NUM_FANGS > 4)
+				errx(1, "--analyze enumerates every fang health and only runs with 4 fangs or fewer");
+			analyze = 1;
+			break;
+		case 'G':
+			balance = strtol(optarg, &endptr, 10);
+			if (endptr == optarg || *endptr != '\0' || balance < 1)
+				errx(1, "--balance needs a positive number of games");
+			break;
+		case 'H':
+			balance_path = optarg;
+			break;
+		case 'J':
+			balance_store = optarg;
+			break;
+		case 'U':
+			tune_targets = optarg;
+			break;
+		case 'D':
+			cache_path = optarg;
+			break;
+		case 'Z':
+			cache_mb = strtol(optarg, &endptr, 10);
+			if (endptr == optarg || *endptr != '\0' || cache_mb < 1)
+				errx(1, "--cache-size needs a positive number of megabytes");
+			break;
+		case 'Q':
+			sweep = strtol(optarg, &endptr, 10);
+			if (endptr == optarg || *endptr != '\0' || sweep < 1)
+				errx(1, "--sweep needs a positive number of games");
+			break;
+		case 'F':
+			sweep_dir = optarg;
+			break;
+		case 'I':
+			nshards = strtol(optarg, &endptr, 10);
+			if (endptr == optarg || *endptr != '\0' || nshards < 1 || nshards > SWEEP_MAX_SHARDS)
+				errx(1, "--shards needs a number from 1 to %d", SWEEP_MAX_SHARDS);
+			break;
+		case 'E':
+			shard = strtol(optarg, &endptr, 10);
+			if (endptr == optarg || *endptr != '\0' || shard < 0)
+				errx(1, "--shard needs a shard number from 0");
+			break;
+		case 'g':
+			merge_dir = optarg;
+			break;
+		case 'k':
+			tournament = optarg;
+			break;
+		case 'n':
+			tournament_games = strtol(optarg, &endptr, 10);
+			if (endptr == optarg || *endptr != '\0' || tournament_games < TOURNAMENT_SECTIONS)
+				errx(1, "--tournament-games needs at least %d games", TOURNAMENT_SECTIONS);
+			break;
+		case 'X':
+			tune_params = optarg;
+			break;
+		case 'C':
+			tune_candidates = strtol(optarg, &endptr, 10);
+			if (endptr == optarg || *endptr != '\0' || tune_candidates < 2 || tune_candidates > 4096)
+				errx(1, "--tune-candidates needs a number from 2 to 4096");
+			break;
+		case 'V':
+			if (engine_tables_validate(stdout) != 0 || batch_check_kernels(stdout) != 0)
+				exit(EXIT_FAILURE);
+			exit(EXIT_SUCCESS);
 		case 0:
 			if (game_state.daggerset)
 				fprintf(stderr, "Player will use a dagger to "
@@ -799,11 +1144,238 @@ main(int argc, char *argv[])
 			usage();
 		}
 	argc -= optind;
-	/* argv += optind; */
+	argv += optind;
+
+	/* Further operands are more recordings to check */
+	if (replay_path) {
+		char	      **files;
+
+		if ((files = calloc(argc + 1, sizeof(*files))) == NULL)
+			err(1, "replay");
+		files[0] = (char *)replay_path;
+		memcpy(files + 1, argv, argc * sizeof(*files));
+		exit(replay_files(files, argc + 1) == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
 
 	if (argc != 0)
 		usage();
 
+	if (solve_path) {
+		struct solver_table table;
+
+		if (solver_write(solve_path) == -1 || solver_open(solve_path, &table) == -1)
+			exit(EXIT_FAILURE);
+		printf("Optimal policy written to %s\n", solve_path);
+		solver_print_summary(&table);
+		solver_close(&table);
+		exit(EXIT_SUCCESS);
+	}
+
+	/* --optimal alone picks the policy it holds */
+	if (optimal_path) {
+		if (solver_open(optimal_path, &optimal_table) == -1)
+			exit(EXIT_FAILURE);
+		policy_cfg.table = &optimal_table;
+		if (policy_cfg.name == NULL)
+			policy_cfg.name = "optimal";
+	}
+
+	if (cache_path && cache_open(cache_path, (long long)cache_mb << 20) == -1)
+		exit(EXIT_FAILURE);
+
+	if (analyze) {
+		struct analysis a;
+		struct cache_key key;
+		int		hit;
+
+		cache_key_init(&key, "analyze");
+		cache_key_policy(&key, &policy_cfg);
+		if (!(hit = cache_get(&key, &a, sizeof(a)) == 0)) {
+			analyze_all(policy_cfg.name != NULL ? &policy_cfg : NULL,
+				    threads ? (int)threads : pool_default_threads(), &a);
+			cache_put(&key, &a, sizeof(a));
+		}
+		a.policy = policy_cfg.name != NULL ? policy_cfg.name : "scripted";
+		if (hit)
+			print_cached(stdout);
+		print_analysis(&a, game_state.daggerset, stdout);
+		exit(EXIT_SUCCESS);
+	}
+
+	if (tournament) {
+		struct tournament *t;
+
+		if ((t = malloc(sizeof(*t))) == NULL)
+			err(1, "tournament");
+		if (tournament_init(t, tournament, &policy_cfg) == -1)
+			exit(EXIT_FAILURE);
+		t->games = tournament_games;
+		t->daggerset = game_state.daggerset;
+		t->threads = threads ? (int)threads : pool_default_threads();
+		tournament_run(t);
+		print_tournament(t, stdout);
+		free(t);
+		exit(EXIT_SUCCESS);
+	}
+
+	if (tune_targets) {
+		struct tune	t;
+
+		tune_init(&t);
+		if (tune_params == NULL)
+			errx(1, "--tune needs --tune-params to say what it may change");
+		if (tune_parse_targets(&t, tune_targets) == -1 || tune_parse_params(&t, tune_params) == -1)
+			exit(EXIT_FAILURE);
+		t.candidates = (int)tune_candidates;
+		t.daggerset = game_state.daggerset;
+		t.threads = threads ? (int)threads : pool_default_threads();
+		tune_run(&t);
+		print_tune(&t, stdout);
+		exit(EXIT_SUCCESS);
+	}
+
+	if (balance) {
+		struct balance *b;
+		struct cache_key key;
+		int		hit;
+
+		if ((b = malloc(sizeof(*b))) == NULL)
+			err(1, "balance");
+		cache_key_init(&key, "balance");
+		cache_key_policy(&key, &policy_cfg);
+		cache_key_int(&key, balance);
+		cache_key_int(&key, (long long)rng_get_seed());
+		if (!(hit = cacheable(seeded) && cache_get(&key, b, sizeof(*b)) == 0)) {
+			if (balance_sweep(policy_cfg.name != NULL ? &policy_cfg : NULL, balance,
+					  threads ? (int)threads : pool_default_threads(), balance_store, b) == -1)
+				exit(EXIT_FAILURE);
+			if (cacheable(seeded))
+				cache_put(&key, b, sizeof(*b));
+		}
+		b->policy = policy_cfg.name != NULL ? policy_cfg.name : "scripted";
+		if (hit)
+			print_cached(stdout);
+		print_balance(b, stdout);
+		if (balance_path && balance_write_tables(b, balance_path) == -1)
+			exit(EXIT_FAILURE);
+		free(b);
+		exit(EXIT_SUCCESS);
+	}
+
+	if (merge_dir) {
+		struct sim_results *res;
+		int		n;
+
+		if ((res = malloc(sizeof(*res))) == NULL)
+			err(1, "merge");
+		if (sweep_merge(merge_dir, res, &n) == -1)
+			exit(EXIT_FAILURE);
+		printf("Merged %d shard%s from %s\n", n, n == 1 ? "" : "s", merge_dir);
+		print_sim_results(res);
+		free(res);
+		exit(EXIT_SUCCESS);
+	}
+
+	/*
+	 * Every process of a sweep must deal the same games, and a resumed
+	 * one the same as before, so the seed has to be given
+	 */
+	if (sweep) {
+		struct sweep	sw;
+		struct sim_results *res;
+		int		played, resumed, n;
+
+		if (sweep_dir == NULL)
+			errx(1, "--sweep needs --sweep-dir to keep its shards in");
+		if (!seeded)
+			errx(1, "--sweep needs --seed so every shard deals from the same games");
+		if (policy_cfg.name != NULL && strcmp(policy_cfg.name, "scripted") != 0)
+			sim_use_policy(&policy_cfg);
+		if (sweep_init(&sw, sweep_dir, sweep, (int)nshards, game_state.daggerset,
+			       threads ? (int)threads : pool_default_threads(), &policy_cfg) == -1)
+			exit(EXIT_FAILURE);
+		if (shard >= 0) {
+			switch (sweep_run_shard(&sw, (int)shard)) {
+			case 1:
+				printf("Shard %ld of %ld is already in %s\n", shard, nshards, sweep_dir);
+				break;
+			case 0:
+				printf("Shard %ld of %ld written to %s\n", shard, nshards, sweep_dir);
+				break;
+			default:
+				exit(EXIT_FAILURE);
+			}
+			exit(EXIT_SUCCESS);
+		}
+		if (sweep_run(&sw, &played, &resumed) == -1)
+			exit(EXIT_FAILURE);
+		if ((res = malloc(sizeof(*res))) == NULL)
+			err(1, "sweep");
+		if (sweep_merge(sweep_dir, res, &n) == -1)
+			exit(EXIT_FAILURE);
+		printf("Swept %d shard%s: %d played, %d resumed from %s\n", n, n == 1 ? "" : "s",
+		       played, resumed, sweep_dir);
+		print_sim_results(res);
+		free(res);
+		exit(EXIT_SUCCESS);
+	}
+
+	if ((hygienists || arrival || stock) && !clinic)
+		errx(1, "--hygienists, --arrival and --stock need --clinic");
+	if (clinic) {
+		struct clinic_config cfg;
+		struct clinic_results *res;
+
+		if ((res = malloc(sizeof(*res))) == NULL)
+			err(1, "clinic");
+		memset(&cfg, 0, sizeof(cfg));
+		cfg.patients = clinic;
+		cfg.hygienists = hygienists ? (int)hygienists : CLINIC_HYGIENISTS;
+		cfg.arrival_s = arrival ? (int)arrival : CLINIC_ARRIVAL_S;
+		/* A game's fluoride for every patient unless told otherwise */
+		cfg.stock = stock ? stock : (long long)clinic * DEFAULT_FLUORIDE;
+		cfg.daggerset = game_state.daggerset;
+		cfg.seed = rng_get_seed();
+		cfg.policy = policy_cfg.name != NULL ? &policy_cfg : NULL;
+		clinic_run(&cfg, res);
+		print_clinic(res, stdout);
+		free(res);
+		exit(EXIT_SUCCESS);
+	}
+
+	/* Headless play never touches curses, prompts or the save file */
+	if (simulate) {
+		struct sim_results res;
+		struct cache_key key;
+		int		hit;
+
+		if (policy_cfg.name != NULL && strcmp(policy_cfg.name, "scripted") != 0)
+			sim_use_policy(&policy_cfg);
+		if (threads == 0)
+			threads = pool_default_threads();
+		if (batch && policy_cfg.name != NULL && strcmp(policy_cfg.name, "scripted") != 0)
+			errx(1, "--batch plays the scripted hygienist only");
+		cache_key_init(&key, batch ? "batch" : "simulate");
+		cache_key_policy(&key, &policy_cfg);
+		cache_key_int(&key, simulate);
+		cache_key_int(&key, game_state.daggerset);
+		cache_key_int(&key, (long long)rng_get_seed());
+		if (!(hit = cacheable(seeded) && cache_get(&key, &res, sizeof(res)) == 0)) {
+			if (batch)
+				simulate_batches(simulate, game_state.daggerset, threads, &res);
+			else
+				simulate_games(simulate, game_state.daggerset, threads, &res);
+			if (cacheable(seeded))
+				cache_put(&key, &res, sizeof(res));
+		}
+		if (batch)
+			printf("Batch kernel: %s\n", batch_kernel_name());
+		if (hit)
+			print_cached(stdout);
+		print_sim_results(&res);
+		exit(EXIT_SUCCESS);
+	}
+
 	/*
 	 * Initialize game state if fflag is not since we are not restoring a
 	 * saved game
@@ -821,9 +1393,61 @@ main(int argc, char *argv[])
 		init_game_state(bflag, &game_state);
 	}
 
+	if (tick != 0) {
+		if (realtime_tick == 0)
+			errx(1, "--tick needs --realtime");
+		realtime_tick = (int)tick;
+	}
+
+	if (banded && roster_path == NULL)
+		errx(1, "--band needs --roster");
+	if (roster_path) {
+		struct timespec	start, end;
+		uint32_t	first, n;
+
+		if (record_path)
+			errx(1, "--record cannot deal from a --roster");
+		if (fflag)
+			errx(1, "--roster needs a fresh game, not a restored one");
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		if (roster_load(roster_path, &roster) == -1)
+			exit(EXIT_FAILURE);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		roster_band(&roster, band_lo, band_hi, &first, &n);
+		if (n == 0)
+			errx(1, "%s has no patient of difficulty %d to %d", roster_path, band_lo, band_hi);
+		fprintf(stderr, "Loaded %u patients and %u tools from %s in %.2f ms, %u of difficulty %d to %d\n",
+			roster.npatients, roster.ntools, roster_path,
+			(end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6,
+			n, band_lo, band_hi);
+	}
+
+	if (watch_path) {
+		if (record_path)
+			errx(1, "--record replays the built-in balance, not a --balance-watch file");
+		if (watch_init(&watch, watch_path) == -1)
+			exit(EXIT_FAILURE);
+		watching = 1;
+	}
+
+	/* Opened before main_program() unveils the save file alone */
+	if (record_path && realtime_tick)
+		errx(1, "--record cannot keep the clock of --realtime");
+	if (record_path) {
+		if (fflag)
+			errx(1, "--record needs a fresh game, not a restored one");
+		if ((recorder = replay_writer_open(record_path, rng_get_seed(), game_state.daggerset)) == NULL)
+			exit(EXIT_FAILURE);
+	}
+
 
+	if (policy_cfg.name != NULL)
+		player = policy_new(&policy_cfg);
 
-	exit(main_program(fflag, &game_state));
+	ch = main_program(fflag, &game_state);
+	replay_writer_close(recorder);
+	policy_free(player);
+	exit(ch);
 }
 #else
 #include "unittest/unittest.c"
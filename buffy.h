@@ -24,6 +24,18 @@
 #ifndef BUFFY_H
 #define BUFFY_H
 
+/*
+ * Teeth per patient, four canines unless built with -DNUM_FANGS=n. The
+ * canines are always the first four: the art and the patients[] table
+ * name them.
+ */
+#ifndef NUM_FANGS
+#define NUM_FANGS	4
+#endif
+#if NUM_FANGS < 4 || NUM_FANGS > 255
+#error "NUM_FANGS must be 4 to 255"
+#endif
+
 typedef struct game_state {
 	int		daggerset;
 	int		fluoride;
@@ -35,8 +47,8 @@ typedef struct game_state {
 	int		turns;
 	int		using_curses;
 	int		color_mode;
-	int		last_tool_dip[4];
-	int		last_tool_effort[4];
+	int		last_tool_dip[NUM_FANGS];
+	int		last_tool_effort[NUM_FANGS];
 	int		tool_in_use;
 	int		patient_idx;
 	char	       *character_name;
@@ -58,7 +70,7 @@ typedef struct patient {
 	int		patience_level;
 	char	       *name;
 	char	       *species;
-	patient_fangs_type fangs[4];
+	patient_fangs_type fangs[NUM_FANGS];
 }		patient_type;
 
 typedef struct tool {
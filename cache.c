@@ -0,0 +1,301 @@
+/*
+ * BSD Zero Clause License
+ *
+ * Copyright (c) 2025 David M Crumpton david.m.crumpton [at] gmail [dot] com
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * cache.c: a content addressed store for the results of headless runs.
+ * An entry is named by a 128 bit hash of the engine version, the whole
+ * balance configuration (the constants, tools[], species and patients and
+ * the turn tables built from them) and the run's own parameters, so a
+ * changed input simply misses. Each hit refreshes the entry's mtime, and
+ * once the directory grows past its limit the entries used longest ago
+ * are removed first.
+ *
+ */
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include <dirent.h>
+#include <err.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "buffy.h"
+#include "cache.h"
+#include "engine.h"
+#include "gamestate.h"
+#include "policy.h"
+#include "simulate.h"
+#include "solver.h"
+#include "tables.h"
+
+#define CACHE_SUFFIX	".bfc"
+
+struct cache_entry {
+	char		name[64];
+	off_t		size;
+	time_t		used;
+};
+
+static char	cache_dir[PATH_MAX - 128];	/* room for an entry name */
+static long long cache_max;
+static int	cache_on = 0;
+
+
+int
+cache_open(const char *dir, long long max_bytes)
+{
+	struct stat	st;
+
+	if (mkdir(dir, 0755) == -1 && errno != EEXIST) {
+		warn("%s", dir);
+		return -1;
+	}
+	if (stat(dir, &st) == -1 || !S_ISDIR(st.st_mode)) {
+		warnx("%s is not a directory", dir);
+		return -1;
+	}
+	if (strlcpy(cache_dir, dir, sizeof(cache_dir)) >= sizeof(cache_dir)) {
+		warnx("%s: name too long", dir);
+		return -1;
+	}
+	cache_max = max_bytes;
+	cache_on = 1;
+	return 0;
+}
+
+int
+cache_enabled(void)
+{
+	return cache_on;
+}
+
+/* FNV-1a and a rotate-multiply hash side by side */
+void
+cache_key_bytes(struct cache_key * k, const void *p, size_t n)
+{
+	const unsigned char *b = p;
+
+	for (size_t i = 0; i < n; i++) {
+		k->h[0] = (k->h[0] ^ b[i]) * 0x100000001b3ULL;
+		k->h[1] = ((k->h[1] ^ b[i]) << 23 | (k->h[1] ^ b[i]) >> 41) * 0x9e3779b97f4a7c15ULL;
+	}
+}
+
+void
+cache_key_int(struct cache_key * k, long long v)
+{
+	cache_key_bytes(k, &v, sizeof(v));
+}
+
+void
+cache_key_str(struct cache_key * k, const char *s)
+{
+	cache_key_bytes(k, s, strlen(s) + 1);
+}
+
+/* Everything a result depends on before the run's own parameters */
+void
+cache_key_init(struct cache_key * k, const char *kind)
+{
+	k->h[0] = 0xcbf29ce484222325ULL;
+	k->h[1] = 0x6a09e667f3bcc909ULL;
+	cache_key_str(k, kind);
+	cache_key_int(k, MAJOR);
+	cache_key_int(k, MINOR);
+	cache_key_int(k, PATCH);
+	cache_key_int(k, CACHE_VERSION);
+
+	cache_key_int(k, DEFAULT_FLUORIDE);
+	cache_key_int(k, DEFAULT_SCORE);
+	cache_key_int(k, DEFAULT_TURNS);
+	cache_key_int(k, BONUS_ALL_HEALTH);
+	cache_key_int(k, BONUS_FANG_CLEANED);
+	cache_key_int(k, BONUS_FANG_HEALTH);
+	cache_key_int(k, BONUS_TURN_COMPLETE);
+	cache_key_int(k, MAX_HEALTH);
+	cache_key_int(k, NUM_FANGS);
+	cache_key_int(k, SIM_MAX_TURNS);
+	for (int t = 0; t < NUM_TOOLS; t++) {
+		cache_key_int(k, tools[t].length);
+		cache_key_int(k, tools[t].dip_amount);
+		cache_key_int(k, tools[t].effort);
+		cache_key_int(k, tools[t].effectiveness);
+		cache_key_int(k, tools[t].durability);
+		cache_key_int(k, tools[t].pain_factor);
+	}
+	for (int s = 0; s < NUM_PATIENTS; s++) {
+		cache_key_int(k, patients[s].age);
+		cache_key_int(k, patients[s].patience);
+		cache_key_int(k, species_gain[s].percent);
+		cache_key_int(k, species_gain[s].bonus);
+	}
+	cache_key_bytes(k, &engine_rules.tables, sizeof(engine_rules.tables));
+	cache_key_bytes(k, tool_weight, sizeof(tool_weight));
+	cache_key_bytes(k, patient_weight, sizeof(patient_weight));
+	cache_key_bytes(k, health_buckets, sizeof(health_buckets));
+}
+
+void
+cache_key_policy(struct cache_key * k, const struct policy_config * cfg)
+{
+	const char     *name = cfg != NULL && cfg->name != NULL ? cfg->name : "scripted";
+
+	cache_key_str(k, name);
+	if (strcmp(name, "optimal") == 0 && cfg->table != NULL)
+		cache_key_bytes(k, cfg->table->entries, sizeof(struct solver_entry) *
+				NUM_TOOLS * NUM_PATIENTS * (MAX_HEALTH + 1));
+	if (strcmp(name, "mcts") == 0) {
+		cache_key_int(k, cfg->budget_us);
+		cache_key_int(k, cfg->nodes);
+	}
+}
+
+static void
+entry_path(const struct cache_key * k, char *path, size_t len)
+{
+	snprintf(path, len, "%s/%016llx%016llx" CACHE_SUFFIX, cache_dir,
+		 (unsigned long long)k->h[0], (unsigned long long)k->h[1]);
+}
+
+/* Returns 0 and fills result on a hit, -1 on a miss */
+int
+cache_get(const struct cache_key * k, void *result, size_t size)
+{
+	struct cache_header hdr;
+	char		path[PATH_MAX];
+	FILE	       *fp;
+	int		rv = -1;
+
+	if (!cache_on)
+		return -1;
+	entry_path(k, path, sizeof(path));
+	if ((fp = fopen(path, "rb")) == NULL)
+		return -1;
+	if (fread(&hdr, sizeof(hdr), 1, fp) == 1 && hdr.magic == CACHE_MAGIC &&
+	    hdr.version == CACHE_VERSION && hdr.key[0] == k->h[0] && hdr.key[1] == k->h[1] &&
+	    hdr.size == size && fread(result, size, 1, fp) == 1)
+		rv = 0;
+	fclose(fp);
+	if (rv == 0)
+		(void)utimes(path, NULL);	/* most recently used */
+	return rv;
+}
+
+int
+cache_put(const struct cache_key * k, const void *result, size_t size)
+{
+	struct cache_header hdr;
+	char		path[PATH_MAX], tmp[PATH_MAX + 16];
+	FILE	       *fp;
+
+	if (!cache_on)
+		return 0;
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = CACHE_MAGIC;
+	hdr.version = CACHE_VERSION;
+	hdr.key[0] = k->h[0];
+	hdr.key[1] = k->h[1];
+	hdr.size = size;
+	entry_path(k, path, sizeof(path));
+
+	/* Renamed into place so a reader never sees half an entry */
+	snprintf(tmp, sizeof(tmp), "%s.%ld", path, (long)getpid());
+	if ((fp = fopen(tmp, "wb")) == NULL) {
+		warn("%s", tmp);
+		return -1;
+	}
+	if (fwrite(&hdr, sizeof(hdr), 1, fp) != 1 || fwrite(result, size, 1, fp) != 1) {
+		warn("write %s", tmp);
+		fclose(fp);
+		remove(tmp);
+		return -1;
+	}
+	if (fclose(fp) == EOF || rename(tmp, path) == -1) {
+		warn("%s", path);
+		remove(tmp);
+		return -1;
+	}
+	cache_evict();
+	return 0;
+}
+
+static int
+by_use(const void *a, const void *b)
+{
+	const struct cache_entry *x = a, *y = b;
+
+	if (x->used != y->used)
+		return x->used < y->used ? -1 : 1;
+	return strcmp(x->name, y->name);
+}
+
+/*
+ * Remove the least recently used entries until the directory fits its
+ * limit. Returns how many were removed.
+ */
+long
+cache_evict(void)
+{
+	struct cache_entry *entries = NULL;
+	struct dirent  *de;
+	struct stat	st;
+	char		path[PATH_MAX];
+	long long	total = 0;
+	long		n = 0, cap = 0, removed = 0;
+	DIR	       *dir;
+
+	if (!cache_on || (dir = opendir(cache_dir)) == NULL)
+		return 0;
+	while ((de = readdir(dir)) != NULL) {
+		size_t		len = strlen(de->d_name);
+
+		if (len < sizeof(CACHE_SUFFIX) || len >= sizeof(entries->name) ||
+		    strcmp(de->d_name + len - (sizeof(CACHE_SUFFIX) - 1), CACHE_SUFFIX) != 0)
+			continue;
+		snprintf(path, sizeof(path), "%s/%.63s", cache_dir, de->d_name);
+		if (stat(path, &st) == -1 || !S_ISREG(st.st_mode))
+			continue;
+		if (n == cap) {
+			cap = cap ? cap * 2 : 64;
+			if ((entries = realloc(entries, cap * sizeof(*entries))) == NULL)
+				err(1, "cache");
+		}
+		strlcpy(entries[n].name, de->d_name, sizeof(entries[n].name));
+		entries[n].size = st.st_size;
+		entries[n].used = st.st_mtime;
+		total += st.st_size;
+		n++;
+	}
+	closedir(dir);
+
+	if (total > cache_max) {
+		qsort(entries, n, sizeof(*entries), by_use);
+		for (long i = 0; i < n && total > cache_max; i++) {
+			snprintf(path, sizeof(path), "%s/%s", cache_dir, entries[i].name);
+			if (unlink(path) == 0) {
+				total -= entries[i].size;
+				removed++;
+			}
+		}
+	}
+	free(entries);
+	return removed;
+}
@@ -0,0 +1,60 @@
+/*
+ * BSD Zero Clause License
+ *
+ * Copyright (c) 2025 David M Crumpton david.m.crumpton [at] gmail [dot] com
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * cache.h: results of headless runs kept on disk under a hash of every
+ * input that decides them
+ *
+ */
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "policy.h"
+
+#define CACHE_MAGIC	0x41434642	/* "BFCA" */
+#define CACHE_VERSION	1
+#define CACHE_DEFAULT_MB	64
+
+/* Two independent 64 bit hashes, so the name of an entry is its content */
+struct cache_key {
+	uint64_t	h[2];
+};
+
+struct cache_header {
+	uint32_t	magic;
+	uint16_t	version;
+	uint16_t	reserved;
+	uint64_t	key[2];
+	uint64_t	size;	/* of the result that follows */
+};
+
+int		cache_open(const char *dir, long long max_bytes);
+int		cache_enabled(void);
+void		cache_key_init(struct cache_key * k, const char *kind);
+void		cache_key_bytes(struct cache_key * k, const void *p, size_t n);
+void		cache_key_int(struct cache_key * k, long long v);
+void		cache_key_str(struct cache_key * k, const char *s);
+void		cache_key_policy(struct cache_key * k, const struct policy_config * cfg);
+int		cache_get(const struct cache_key * k, void *result, size_t size);
+int		cache_put(const struct cache_key * k, const void *result, size_t size);
+long		cache_evict(void);
+
+#endif				/* CACHE_H */
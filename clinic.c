@@ -0,0 +1,391 @@
+/*
+ * BSD Zero Clause License
+ *
+ * Copyright (c) 2025 David M Crumpton david.m.crumpton [at] gmail [dot] com
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * clinic.c: a discrete event simulation of a clinic. Patients dealt as the
+ * game deals them arrive at random, wait in a waiting room of fixed size
+ * and are seated with the first free hygienist, who keeps one tool all
+ * day and cleans stroke by stroke through engine_fang_turn(). Every
+ * stroke draws on one stock of fluoride; the first that finds too little
+ * closes the clinic.
+ *
+ * The event list is a binary heap of 64 bit keys, the due time in
+ * milliseconds above the hygienist's number, so one integer compare
+ * orders two events and ties go the same way on every run. Only the next
+ * arrival and each busy hygienist's next stroke are ever pending, and a
+ * hygienist who carries on replaces the top of the heap in one sift down
+ * rather than a pop and a push.
+ *
+ */
+#include <err.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "buffy.h"
+#include "clinic.h"
+#include "dentition.h"
+#include "engine.h"
+#include "policy.h"
+#include "rng.h"
+#include "simulate.h"
+#include "sketch.h"
+#include "tables.h"
+
+#define WHO_BITS	13
+#define KEY(at, who)	((uint64_t)(at) << WHO_BITS | (uint64_t)(who))
+#define KEY_AT(k)	((int64_t)((k) >> WHO_BITS))
+#define KEY_WHO(k)	((int)((k) & ((1 << WHO_BITS) - 1)))
+#define ARRIVAL		CLINIC_MAX_HYGIENISTS	/* after a stroke due at the same time */
+
+#if CLINIC_MAX_HYGIENISTS >= (1 << WHO_BITS)
+#error "CLINIC_MAX_HYGIENISTS does not fit the event keys"
+#endif
+
+/* What stroke() says when there is no stroke to time */
+#define LEFT_TREATED	-1
+#define LEFT_GAVE_UP	-2
+#define OUT_OF_FLUORIDE	-3
+
+struct chair {
+	game_state_type	state;
+	patient_type	pat;
+	struct dent_bits teeth;
+	struct policy  *policy;
+	int64_t		arrived;
+	int		fang;	/* the next to look at */
+};
+
+struct waiting {
+	patient_type	pat;
+	int		species;
+	int64_t		arrived;
+};
+
+struct clinic {
+	const struct clinic_config *cfg;
+	struct clinic_results *res;
+	struct chair   *chairs;
+	int	       *idle;	/* stack of free hygienists */
+	int		nidle;
+	struct waiting *room;	/* ring */
+	int		room_size;
+	int		head;
+	int		waiting;
+	uint64_t       *heap;
+	int		n;
+	long long	stock;
+	double		arrival_ms;	/* mean */
+};
+
+
+static inline void
+heap_push(struct clinic * c, uint64_t k)
+{
+	int		i = c->n++;
+
+	while (i > 0 && c->heap[(i - 1) / 2] > k) {
+		c->heap[i] = c->heap[(i - 1) / 2];
+		i = (i - 1) / 2;
+	}
+	c->heap[i] = k;
+}
+
+/* Put k in place of the earliest event */
+static inline void
+heap_replace_top(struct clinic * c, uint64_t k)
+{
+	int		i = 0;
+
+	for (;;) {
+		int		child = 2 * i + 1;
+
+		if (child >= c->n)
+			break;
+		if (child + 1 < c->n && c->heap[child + 1] < c->heap[child])
+			child++;
+		if (k <= c->heap[child])
+			break;
+		c->heap[i] = c->heap[child];
+		i = child;
+	}
+	c->heap[i] = k;
+}
+
+static inline void
+heap_pop(struct clinic * c)
+{
+	if (--c->n > 0)
+		heap_replace_top(c, c->heap[c->n]);
+}
+
+/* Milliseconds to the next arrival, exponentially distributed */
+static int64_t
+interarrival(const struct clinic * c)
+{
+	double		u = rng_word() / 4294967296.0;
+
+	return (int64_t)(-log1p(-u) * c->arrival_ms);
+}
+
+static void
+seat(struct clinic * c, struct chair * ch, const struct waiting * w, int64_t now)
+{
+	game_state_type *st = &ch->state;
+
+	ch->pat = w->pat;
+	ch->arrived = w->arrived;
+	ch->fang = 0;
+	st->patient_idx = w->species;
+	st->score = DEFAULT_SCORE;
+	st->turns = DEFAULT_TURNS;
+	for (int i = 0; i < NUM_FANGS; i++) {
+		st->last_tool_dip[i] = DEFAULT_TOOL_DIP;
+		st->last_tool_effort[i] = DEFAULT_TOOL_EFFORT;
+	}
+	dent_bits_init(&ch->teeth, &ch->pat);
+	if (ch->policy != NULL)
+		policy_new_game(ch->policy);
+	c->res->seated++;
+	c->res->wait_ms += now - w->arrived;
+	sketch_add(&c->res->wait, (long)((now - w->arrived) / 1000));
+}
+
+/*
+ * Clean the next fang that needs it, closing out the round at the last
+ * one. Returns how long the stroke takes in milliseconds, or why there is
+ * no stroke to take.
+ */
+static int
+stroke(struct clinic * c, struct chair * ch)
+{
+	game_state_type *st = &ch->state;
+	int		i = dent_next(&ch->teeth, ch->fang);
+	int		dip, effort, used;
+
+	if (i >= NUM_FANGS) {
+		if (engine_end_round(st, &ch->teeth) == 0)
+			return LEFT_TREATED;
+		if (st->turns > CLINIC_MAX_ROUNDS)
+			return LEFT_GAVE_UP;
+		i = dent_next(&ch->teeth, 0);
+	}
+	if (ch->policy != NULL) {
+		policy_choose(ch->policy, st, &ch->pat, i, &dip, &effort);
+		if (ch->policy->hopeless)
+			return LEFT_GAVE_UP;
+	} else
+		sim_scripted_input(st, &ch->pat, i, &dip, &effort);
+
+	/* The chair draws on the clinic's stock as a game draws on its own */
+	st->fluoride = c->stock > INT_MAX ? INT_MAX : (int)c->stock;
+	if ((used = engine_fang_turn(st, &ch->pat, i, dip, effort, NULL, 0)) == -1)
+		return OUT_OF_FLUORIDE;
+	c->stock -= used;
+	c->res->used += used;
+	c->res->strokes++;
+	dent_bits_update(&ch->teeth, i, ch->pat.fangs[i].health);
+	ch->fang = i + 1;
+	return (CLINIC_STROKE_S + st->tool_effort * CLINIC_EFFORT_S) * 1000;
+}
+
+/*
+ * Hygienist h is free at now: the next stroke, or the next patient from
+ * the waiting room when this one leaves. Returns when h is next due, -1
+ * when h has nobody left to see, or OUT_OF_FLUORIDE.
+ */
+static int64_t
+work(struct clinic * c, int h, int64_t now)
+{
+	struct chair   *ch = &c->chairs[h];
+
+	for (;;) {
+		int		d = stroke(c, ch);
+
+		if (d > 0) {
+			c->res->busy_ms += d;
+			return now + d;
+		}
+		if (d == OUT_OF_FLUORIDE)
+			return OUT_OF_FLUORIDE;
+		if (d == LEFT_TREATED) {
+			c->res->treated++;
+			sketch_add(&c->res->stay, (long)((now - ch->arrived) / 1000));
+		} else
+			c->res->gave_up++;
+
+		if (c->waiting == 0) {
+			c->idle[c->nidle++] = h;
+			return -1;
+		}
+		seat(c, ch, &c->room[c->head], now);
+		c->head = (c->head + 1) % c->room_size;
+		c->waiting--;
+	}
+}
+
+/* A patient walks in; the next one is already on the way */
+static int64_t
+arrive(struct clinic * c, int64_t now)
+{
+	struct waiting	w;
+	game_state_type	dealt;
+	int		h;
+
+	memset(&w, 0, sizeof(w));
+	patient_init(&dealt, &w.pat);
+	w.species = dealt.patient_idx;
+	w.arrived = now;
+	c->res->arrived++;
+
+	if (c->nidle == 0) {
+		if (c->waiting == c->room_size)
+			c->res->turned_away++;
+		else {
+			c->room[(c->head + c->waiting) % c->room_size] = w;
+			c->waiting++;
+		}
+		return -1;
+	}
+	h = c->idle[--c->nidle];
+	seat(c, &c->chairs[h], &w, now);
+	return work(c, h, now);
+}
+
+/*
+ * Run the clinic until every patient has come and gone or the fluoride
+ * runs out. The arrivals and the deals come from one stream of the seed,
+ * so a seed always gives the same day.
+ */
+void
+clinic_run(const struct clinic_config * cfg, struct clinic_results * res)
+{
+	struct clinic	c;
+	struct rng	rng;
+	struct timespec	start, end;
+	int		h;
+
+	memset(res, 0, sizeof(*res));
+	memset(&c, 0, sizeof(c));
+	res->cfg = *cfg;
+	res->exhausted_ms = -1;
+	c.cfg = cfg;
+	c.res = res;
+	c.stock = cfg->stock;
+	c.arrival_ms = cfg->arrival_s * 1000.0;
+	c.room_size = cfg->hygienists * CLINIC_WAITING;
+	if ((c.chairs = calloc(cfg->hygienists, sizeof(*c.chairs))) == NULL ||
+	    (c.idle = calloc(cfg->hygienists, sizeof(*c.idle))) == NULL ||
+	    (c.room = calloc(c.room_size, sizeof(*c.room))) == NULL ||
+	    (c.heap = calloc(cfg->hygienists + 1, sizeof(*c.heap))) == NULL)
+		err(1, "clinic");
+
+	rng_seed(&rng, cfg->seed, CLINIC_STREAM);
+	rng_set_stream(&rng);
+	for (h = cfg->hygienists - 1; h >= 0; h--) {
+		struct chair   *ch = &c.chairs[h];
+
+		ch->state.daggerset = cfg->daggerset;
+		engine_init_state(&ch->state);
+		if (cfg->policy != NULL)
+			ch->policy = policy_new(cfg->policy);
+		res->tools[ch->state.tool_in_use]++;
+		c.idle[c.nidle++] = h;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if (cfg->patients > 0)
+		heap_push(&c, KEY(interarrival(&c), ARRIVAL));
+	while (c.n > 0) {
+		uint64_t	top = c.heap[0];
+		int64_t		now = KEY_AT(top), next;
+
+		res->events++;
+		res->end_ms = now;
+		if (KEY_WHO(top) == ARRIVAL) {
+			h = c.nidle > 0 ? c.idle[c.nidle - 1] : -1;
+			if (res->arrived + 1 < cfg->patients)
+				heap_replace_top(&c, KEY(now + interarrival(&c), ARRIVAL));
+			else
+				heap_pop(&c);
+			if ((next = arrive(&c, now)) >= 0)
+				heap_push(&c, KEY(next, h));
+		} else {
+			h = KEY_WHO(top);
+			if ((next = work(&c, h, now)) >= 0)
+				heap_replace_top(&c, KEY(next, h));
+			else
+				heap_pop(&c);
+		}
+		if (next == OUT_OF_FLUORIDE) {
+			res->exhausted_ms = now;
+			res->unserved = cfg->hygienists - c.nidle + c.waiting;
+			break;
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	rng_set_stream(NULL);
+	res->elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+	for (h = 0; h < cfg->hygienists; h++)
+		if (c.chairs[h].policy != NULL)
+			policy_free(c.chairs[h].policy);
+	free(c.chairs);
+	free(c.idle);
+	free(c.room);
+	free(c.heap);
+}
+
+void
+print_clinic(const struct clinic_results * res, FILE * out)
+{
+	const struct clinic_config *cfg = &res->cfg;
+	double		hours = res->end_ms / 3.6e6;
+	double		seated = res->seated > 0 ? (double)res->seated : 1.0;
+	const char     *sep = "";
+
+	fprintf(out, "Clinic of %d hygienist%s saw %ld patients over %.1f hours, %lld events in %.3f s (%.0f events/s)\n",
+		cfg->hygienists, cfg->hygienists == 1 ? "" : "s", res->arrived, hours, res->events,
+		res->elapsed, res->elapsed > 0 ? res->events / res->elapsed : 0.0);
+	fprintf(out, "  Seed: %#llx\n", (unsigned long long)cfg->seed);
+	fprintf(out, "  Tools: ");
+	for (int t = 0; t < NUM_TOOLS; t++)
+		if (res->tools[t] > 0) {
+			fprintf(out, "%s%d %s", sep, res->tools[t], tools[t].name);
+			sep = ", ";
+		}
+	fprintf(out, "\n");
+	fprintf(out, "  Treated: %ld (%.2f%%), gave up on %ld, turned away %ld, unserved %ld\n",
+		res->treated, res->arrived > 0 ? 100.0 * res->treated / res->arrived : 0.0,
+		res->gave_up, res->turned_away, res->unserved);
+	fprintf(out, "  Throughput: %.2f patients treated per hour, %lld strokes\n",
+		hours > 0 ? res->treated / hours : 0.0, res->strokes);
+	fprintf(out, "  Queueing delay: mean %.0f s (p50 %ld, p90 %ld, p99 %ld s)\n",
+		res->wait_ms / 1000.0 / seated, sketch_quantile(&res->wait, 0.5),
+		sketch_quantile(&res->wait, 0.9), sketch_quantile(&res->wait, 0.99));
+	fprintf(out, "  Time to treat: p50 %ld, p90 %ld s from arrival\n",
+		sketch_quantile(&res->stay, 0.5), sketch_quantile(&res->stay, 0.9));
+	fprintf(out, "  Hygienists busy: %.1f%%\n",
+		res->end_ms > 0 ? 100.0 * res->busy_ms / ((double)res->end_ms * cfg->hygienists) : 0.0);
+	if (res->exhausted_ms >= 0)
+		fprintf(out, "  Fluoride: all %lld ran out after %.2f hours\n", cfg->stock, res->exhausted_ms / 3.6e6);
+	else
+		fprintf(out, "  Fluoride: %lld of %lld drawn, %lld left\n", res->used, cfg->stock, cfg->stock - res->used);
+}
@@ -0,0 +1,79 @@
+/*
+ * BSD Zero Clause License
+ *
+ * Copyright (c) 2025 David M Crumpton david.m.crumpton [at] gmail [dot] com
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * clinic.h: a discrete event simulation of a whole clinic, where patients
+ * arrive over time, queue for a handful of hygienists and are cleaned
+ * from one shared stock of fluoride
+ *
+ */
+
+#ifndef CLINIC_H
+#define CLINIC_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "buffy.h"
+#include "engine.h"
+#include "policy.h"
+#include "sketch.h"
+
+#define CLINIC_HYGIENISTS	4	/* --hygienists default */
+#define CLINIC_MAX_HYGIENISTS	4096
+#define CLINIC_ARRIVAL_S	900	/* --arrival default, mean seconds between patients */
+#define CLINIC_WAITING		8	/* waiting room seats per hygienist */
+#define CLINIC_STROKE_S		20	/* a stroke takes this long */
+#define CLINIC_EFFORT_S		5	/* and this much more per point of effort */
+#define CLINIC_MAX_ROUNDS	25	/* passes over the fangs before giving up */
+#define CLINIC_STREAM		0x636c696e	/* "clin", away from the game streams */
+
+struct clinic_config {
+	long		patients;
+	int		hygienists;
+	int		arrival_s;
+	long long	stock;	/* of fluoride, shared by every chair */
+	int		daggerset;
+	uint64_t	seed;
+	const struct policy_config *policy;	/* NULL for the scripted hygienist */
+};
+
+struct clinic_results {
+	struct clinic_config cfg;
+	int		tools[NUM_TOOLS];	/* hygienists holding each */
+	long		arrived;
+	long		treated;	/* every fang healthy */
+	long		gave_up;	/* hopeless, or past CLINIC_MAX_ROUNDS */
+	long		turned_away;	/* the waiting room was full */
+	long		unserved;	/* in a chair or waiting when the fluoride ran out */
+	long long	events;
+	long long	strokes;
+	long long	used;	/* fluoride drawn */
+	int64_t		exhausted_ms;	/* when a stroke found too little, or -1 */
+	int64_t		end_ms;	/* of the last event */
+	long long	busy_ms;	/* summed over hygienists */
+	long long	wait_ms;	/* summed over patients seated */
+	long		seated;
+	struct sketch	wait;	/* seconds in the waiting room */
+	struct sketch	stay;	/* seconds from arrival to leaving, when treated */
+	double		elapsed;	/* seconds of wall clock */
+};
+
+void		clinic_run(const struct clinic_config * cfg, struct clinic_results * res);
+void		print_clinic(const struct clinic_results * res, FILE * out);
+
+#endif				/* CLINIC_H */
@@ -0,0 +1,119 @@
+/*
+ * BSD Zero Clause License
+ *
+ * Copyright (c) 2025 David M Crumpton david.m.crumpton [at] gmail [dot] com
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * dentition.c: the heap of dirty teeth. A stroke moves one tooth, so an
+ * update sifts it up or down, or takes it out once it is clean.
+ *
+ */
+#include <string.h>
+
+#include "buffy.h"
+#include "dentition.h"
+
+
+/* Lower health first; the lower tooth number breaks ties */
+static inline int
+dent_before(const struct dentition * d, int a, int b)
+{
+	return d->health[a] < d->health[b] || (d->health[a] == d->health[b] && a < b);
+}
+
+static void
+dent_place(struct dentition * d, int i, int tooth)
+{
+	d->heap[i] = (uint8_t)tooth;
+	d->pos[tooth] = (uint8_t)i;
+}
+
+static void
+dent_sift_up(struct dentition * d, int i)
+{
+	int		tooth = d->heap[i];
+
+	while (i > 0 && dent_before(d, tooth, d->heap[(i - 1) / 2])) {
+		dent_place(d, i, d->heap[(i - 1) / 2]);
+		i = (i - 1) / 2;
+	}
+	dent_place(d, i, tooth);
+}
+
+static void
+dent_sift_down(struct dentition * d, int i)
+{
+	int		tooth = d->heap[i];
+
+	for (;;) {
+		int		c = 2 * i + 1;
+
+		if (c >= d->bits.count)
+			break;
+		if (c + 1 < d->bits.count && dent_before(d, d->heap[c + 1], d->heap[c]))
+			c++;
+		if (!dent_before(d, d->heap[c], tooth))
+			break;
+		dent_place(d, i, d->heap[c]);
+		i = c;
+	}
+	dent_place(d, i, tooth);
+}
+
+void
+dent_init(struct dentition * d, const patient_type * pat)
+{
+	int		n = 0;
+
+	dent_bits_init(&d->bits, pat);
+	memset(d->pos, DENT_NONE, sizeof(d->pos));
+	for (int i = 0; i < NUM_FANGS; i++) {
+		d->health[i] = (uint8_t)(pat->fangs[i].health < 0 ? 0 : pat->fangs[i].health);
+		if (pat->fangs[i].health < MAX_HEALTH)
+			dent_place(d, n++, i);
+	}
+	for (int i = n / 2 - 1; i >= 0; i--)
+		dent_sift_down(d, i);
+}
+
+/* Tell d the tooth's health after a stroke */
+void
+dent_update(struct dentition * d, int tooth, int health)
+{
+	int		i = d->pos[tooth], last;
+
+	dent_bits_update(&d->bits, tooth, health);
+	d->health[tooth] = (uint8_t)(health < 0 ? 0 : health > MAX_HEALTH ? MAX_HEALTH : health);
+	if (i == DENT_NONE) {
+		/* Only a clean tooth that went bad again lands here */
+		if (health < MAX_HEALTH) {
+			dent_place(d, d->bits.count - 1, tooth);
+			dent_sift_up(d, d->bits.count - 1);
+		}
+		return;
+	}
+	if (health >= MAX_HEALTH) {
+		/* The last tooth in the heap takes its place */
+		d->pos[tooth] = DENT_NONE;
+		last = d->bits.count;
+		if (i == last)
+			return;
+		tooth = d->heap[last];
+		dent_place(d, i, tooth);
+	}
+	/* The tooth at i moves one way at most */
+	dent_sift_up(d, i);
+	dent_sift_down(d, d->pos[tooth]);
+}
@@ -0,0 +1,106 @@
+/*
+ * BSD Zero Clause License
+ *
+ * Copyright (c) 2025 David M Crumpton david.m.crumpton [at] gmail [dot] com
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * dentition.h: which of a patient's teeth still need cleaning, as a bitset
+ * for finding the next one and a heap for finding the dirtiest
+ *
+ */
+
+#ifndef DENTITION_H
+#define DENTITION_H
+
+#include <stdint.h>
+
+#include "buffy.h"
+
+#define DENT_WORDS	((NUM_FANGS + 63) / 64)
+#define DENT_NONE	0xff	/* pos[] of a healthy tooth */
+
+/*
+ * A bit per tooth below MAX_HEALTH. Kept beside patient_type, which is
+ * saved as it stands; the simulators need no more than this.
+ */
+struct dent_bits {
+	uint64_t	word[DENT_WORDS];
+	int		count;
+};
+
+/* The bits and a heap of the same teeth ordered by health, lowest first */
+struct dentition {
+	struct dent_bits bits;
+	uint8_t		heap[NUM_FANGS];
+	uint8_t		pos[NUM_FANGS];	/* of each tooth in heap */
+	uint8_t		health[NUM_FANGS];
+};
+
+void		dent_init(struct dentition * d, const patient_type * pat);
+void		dent_update(struct dentition * d, int tooth, int health);
+
+static inline void
+dent_bits_init(struct dent_bits * b, const patient_type * pat)
+{
+	for (int w = 0; w < DENT_WORDS; w++)
+		b->word[w] = 0;
+	b->count = 0;
+	for (int i = 0; i < NUM_FANGS; i++)
+		if (pat->fangs[i].health < MAX_HEALTH) {
+			b->word[i >> 6] |= 1ULL << (i & 63);
+			b->count++;
+		}
+}
+
+/* Tell b the tooth's health after a stroke */
+static inline void
+dent_bits_update(struct dent_bits * b, int tooth, int health)
+{
+	uint64_t	m = 1ULL << (tooth & 63);
+	int		was = (b->word[tooth >> 6] & m) != 0, now = health < MAX_HEALTH;
+
+	b->word[tooth >> 6] ^= was != now ? m : 0;
+	b->count += now - was;
+}
+
+static inline int
+dent_all_healthy(const struct dent_bits * b)
+{
+	return b->count == 0;
+}
+
+/* The first tooth from on that needs cleaning, or NUM_FANGS */
+static inline int
+dent_next(const struct dent_bits * b, int from)
+{
+	for (int w = from >> 6; w < DENT_WORDS; w++) {
+		uint64_t	bits = b->word[w];
+
+		if (w == from >> 6)
+			bits &= ~0ULL << (from & 63);
+		if (bits)
+			return w * 64 + __builtin_ctzll(bits);
+	}
+	return NUM_FANGS;
+}
+
+/* The tooth with the least health, or -1 when all are clean */
+static inline int
+dent_dirtiest(const struct dentition * d)
+{
+	return d->bits.count ? d->heap[0] : -1;
+}
+
+#endif				/* DENTITION_H */
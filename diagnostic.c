@@ -31,7 +31,7 @@ log_game_turn(int turn, const game_state_type * state, const patient_type * pati
 		patient->patience
 	);
 
-	for (int i = 0; i < 4; i++) {
+	for (int i = 0; i < NUM_FANGS; i++) {
 		fprintf(fp, ",%d", patient->fangs[i].health);
 	}
 
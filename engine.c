@@ -0,0 +1,361 @@
+/*
+ * BSD Zero Clause License
+ *
+ * Copyright (c) 2025 David M Crumpton david.m.crumpton [at] gmail [dot] com
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * engine.c: the rules of a fang cleaning, free of any terminal I/O so the
+ * same turn logic drives both the interactive game and the simulator
+ *
+ */
+#include <stdlib.h>
+
+#include <err.h>
+
+#include "alias.h"
+#include "buffy.h"
+#include "engine.h"
+#include "patient.h"
+#include "rng.h"
+#include "tables.h"
+
+
+tool		tools[NUM_TOOLS] = {
+	{"Buffy's Fingernail", "A sharp fingernail for cleaning", 1, 1, 2, 1, 50, 1},
+	{"Small Rock", "A small but rough rock for scraping", 3, 3, 6, 2, 30, 1},
+	{"Shark Tooth", "A sharp shark tooth for precise cleaning", 6, 2, 8, 5, 40, 2},
+	{"Wooden Dagger", "A wooden dagger for simply applying fluoride", 10, 8, 7, 5, 100, 2},
+	{"Bronze Dagger", "A bronze dagger for applying fluoride", 12, 9, 9, 7, 150, 3},
+	{"Steel Dagger", "A steel dagger for strongly applying fluoride", 14, 10, 9, 10, 200, 3}
+};
+
+
+struct patient	patients[NUM_PATIENTS] = {
+	{90, 10, 6, MOOD_UNHAPPY, PATIENCE_IMPATIENT, "Dracula", "Vampire", {{0, 0, NULL, 0}, {0, 0, NULL, 0}, {0, 0, NULL, 0}, {0, 0, NULL, 0}}},
+	{110, 15, 5, MOOD_UNHAPPY, PATIENCE_IMPATIENT, "Gorath", "Orc", {{0, 0, NULL, 0}, {0, 0, NULL, 0}, {0, 0, NULL, 0}, {0, 0, NULL, 0}}},
+	{130, 20, 3, MOOD_HAPPY, PATIENCE_IMPATIENT, "Fenrir", "Werewolf", {{0, 0, NULL, 0}, {0, 0, NULL, 0}, {0, 0, NULL, 0}, {0, 0, NULL, 0}}},
+	{150, 25, 2, MOOD_UNHAPPY, PATIENCE_BLISS, "Nagini", "Serpent", {{0, 0, NULL, 0}, {0, 0, NULL, 0}, {0, 0, NULL, 0}, {0, 0, NULL, 0}}},
+	{200, 30, 7, MOOD_HAPPY, PATIENCE_CALM, "Smaug", "Dragon", {{0, 0, NULL, 100}}}	/* Dragon has max health
+											 * fangs */
+};
+
+
+/* How often each tool is dealt, without and with --daggerset */
+double		tool_weight[2][NUM_TOOLS] = {
+	{1, 1, 1, 0, 0, 0},
+	{0, 0, 0, 1, 1, 1}
+};
+
+/* How often each patient comes in, in patients[] order */
+double		patient_weight[NUM_PATIENTS] = {1, 1, 1, 1, 1};
+
+/* Health is biased toward dirty teeth; within a bucket every health is even */
+struct health_bucket health_buckets[NUM_HEALTH_BUCKETS] = {
+	{60, 70, 60},
+	{71, 80, 30},
+	{90, 100, 10}
+};
+
+static struct alias tool_alias[2];
+static struct alias patient_alias;
+static struct alias health_alias;
+
+/*
+ * The chance a fang is dealt each health, from health_buckets[]. The
+ * analyzer weighs its deals with the same numbers.
+ */
+void
+engine_health_pmf(double pmf[MAX_HEALTH + 1])
+{
+	double		total = 0;
+
+	for (int b = 0; b < NUM_HEALTH_BUCKETS; b++)
+		total += health_buckets[b].weight;
+	for (int h = 0; h <= MAX_HEALTH; h++)
+		pmf[h] = 0;
+	for (int b = 0; b < NUM_HEALTH_BUCKETS; b++) {
+		const struct health_bucket *hb = &health_buckets[b];
+
+		for (int h = hb->lo; h <= hb->hi; h++)
+			pmf[h] += hb->weight / total / (hb->hi - hb->lo + 1);
+	}
+}
+
+/* Build the deal's samplers from the weights above */
+void
+engine_deal_init(void)
+{
+	double		pmf[MAX_HEALTH + 1];
+
+	for (int b = 0; b < NUM_HEALTH_BUCKETS; b++)
+		if (health_buckets[b].lo < 0 || health_buckets[b].hi > MAX_HEALTH ||
+		    health_buckets[b].lo > health_buckets[b].hi)
+			errx(1, "health bucket %d is not within 0-%d", b, MAX_HEALTH);
+	engine_health_pmf(pmf);
+	if (alias_init(&tool_alias[0], tool_weight[0], NUM_TOOLS) == -1 ||
+	    alias_init(&tool_alias[1], tool_weight[1], NUM_TOOLS) == -1 ||
+	    alias_init(&patient_alias, patient_weight, NUM_PATIENTS) == -1 ||
+	    alias_init(&health_alias, pmf, MAX_HEALTH + 1) == -1)
+		errx(1, "the deal's weights are not a distribution");
+}
+
+int
+choose_random_tool(const int *isdaggerset)
+{
+	return alias_draw(&tool_alias[*isdaggerset != 0]);
+}
+
+int
+choose_random_patient(void)
+{
+	return alias_draw(&patient_alias);
+}
+
+void
+randomize_fangs(patient_type * pat)
+{
+	for (int i = 0; i < NUM_FANGS; i++) {
+		pat->fangs[i].length = 4 + rng_uniform(3);	/* 4–6 */
+		pat->fangs[i].sharpness = 5 + rng_uniform(4);	/* 5–8 */
+		pat->fangs[i].health = alias_draw(&health_alias);
+	}
+}
+
+void
+patient_init(game_state_type * state, patient_type * pat)
+{
+	/* Choose a random patient from the patients array */
+	int		idx = choose_random_patient();
+	struct patient *chosen = &patients[idx];
+
+	/* Copy chosen patient's data */
+	pat->age = chosen->age;
+	state->patient_idx = idx;
+	/* Randomize fangs for this patient */
+	randomize_fangs(pat);
+
+	pat->patience = chosen->patience;
+}
+
+/*
+ * Reset the numeric part of the game state and pick a tool. The character
+ * name is left to the caller since only the interactive game has one.
+ */
+void
+engine_init_state(game_state_type * state)
+{
+	state->fluoride = DEFAULT_FLUORIDE;
+	state->tool_dip = DEFAULT_TOOL_DIP;
+	state->tool_effort = DEFAULT_TOOL_EFFORT;
+	state->fluoride_used = DEFAULT_FLUORIDE_USED;
+	state->score = DEFAULT_SCORE;
+	state->turns = DEFAULT_TURNS;
+	state->tool_in_use = choose_random_tool(&state->daggerset);
+
+	for (int i = 0; i < NUM_FANGS; i++) {
+		state->last_tool_dip[i] = DEFAULT_TOOL_DIP;
+		state->last_tool_effort[i] = DEFAULT_TOOL_EFFORT;
+	}
+}
+
+/* How each species takes to cleaning, in patients[] order */
+struct species_gain species_gain[NUM_PATIENTS] = {
+	{100, 2},		/* Vampire */
+	{100, -1},		/* Orc */
+	{100, 1},		/* Werewolf */
+	{80, 0},		/* Serpent */
+	{50, 0}			/* Dragon */
+};
+
+/*
+ * Health gained by one stroke of tool t on a species, before the fang is
+ * clamped to 0..MAX_HEALTH. Takes the tool and species by value so the
+ * tuner can try stats that are not in tools[] or species_gain[].
+ */
+int
+health_gain_for(const tool * t, const struct species_gain * sg, int fluoride_on_tool, int tool_effort)
+{
+	/* Cap fluoride and effort to tool's max */
+	if (fluoride_on_tool > t->dip_amount)
+		fluoride_on_tool = t->dip_amount;
+	if (tool_effort > t->effort)
+		tool_effort = t->effort;
+
+	/* Health gain formula includes effectiveness and durability */
+	int		health_gain = ((fluoride_on_tool / 2) + (tool_effort / 3)) * t->effectiveness * t->durability / 100;
+
+	/* Adjust health gain based on patient species */
+	if (sg->percent != 100)
+		health_gain = (int)(health_gain * (sg->percent / 100.0));
+	return health_gain + sg->bonus;
+}
+
+/*
+ * Health gained by one stroke of the tool in use. Does not modify anything
+ * so callers may use it to look ahead. This is the reference the turn
+ * tables are built from; play goes through fang_health_gain().
+ */
+int
+fang_health_gain_formula(const game_state_type * state, int fluoride_on_tool, int tool_effort)
+{
+	return health_gain_for(&tools[state->tool_in_use], &species_gain[state->patient_idx],
+			       fluoride_on_tool, tool_effort);
+}
+
+int
+fang_health_gain(const game_state_type * state, int fluoride_on_tool, int tool_effort)
+{
+	return TBL_GAIN(state->tool_in_use, state->patient_idx, fluoride_on_tool, tool_effort);
+}
+
+/* Fluoride drawn by a dip of tool t */
+int
+fluoride_used_for(const tool * t, int tool_dip)
+{
+	/*
+	 * Cap dip and effort to tool's maximum values
+	 */
+	if (tool_dip > t->dip_amount)
+		tool_dip = t->dip_amount;
+
+	return tool_dip * t->length;	/* Only dip amount uses fluoride */
+}
+
+/* Reference for the fluoride_used table */
+int
+fluoride_used_formula(int tool_idx, int tool_dip)
+{
+	return fluoride_used_for(&tools[tool_idx], tool_dip);
+}
+
+int
+calculate_fluoride_used_from_dip(int tool_dip, game_state_type * state)
+{
+	int		used = TBL_FLUORIDE_USED(state->tool_in_use, tool_dip);
+
+	if (used > state->fluoride) {
+		return -1;
+	}
+
+	state->fluoride_used = used;
+	state->fluoride -= used;
+	return used;
+}
+
+void
+calculate_fang_health(const game_state_type * state, patient_fangs_type * fang, int fluoride_on_tool, int tool_effort)
+{
+	fang->health += fang_health_gain(state, fluoride_on_tool, tool_effort);
+	if (fang->health > MAX_HEALTH)
+		fang->health = MAX_HEALTH;
+	else if (fang->health < 0)
+		fang->health = 0;
+}
+
+int
+all_fangs_healthy(const patient_type * pat)
+{
+	for (int i = 0; i < NUM_FANGS; i++) {
+		if (pat->fangs[i].health < MAX_HEALTH) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Clean one fang: the patient reacts to the effort, the dip draws fluoride
+ * and the fang health and score are updated. A NULL reaction skips the
+ * comment text. Returns the fluoride used, or -1 when the dip needs more
+ * fluoride than is left, which ends the game.
+ */
+int
+engine_fang_turn(game_state_type * state, patient_type * pat, int fang_idx, int tool_dip, int tool_effort, char *reaction, size_t reaction_len)
+{
+	patient_reaction(reaction, reaction_len, &tool_effort, pat,
+			 &engine_live->tools[state->tool_in_use].pain_factor,
+			 patients[state->patient_idx].name, fang_idx);
+
+	/* Update state variables */
+	state->tool_dip = tool_dip;
+	state->tool_effort = tool_effort;
+	state->last_tool_dip[fang_idx] = tool_dip;
+	state->last_tool_effort[fang_idx] = tool_effort;
+
+	/* Check fluoride availability */
+	if ((state->fluoride_used = calculate_fluoride_used_from_dip(tool_dip, state)) == -1)
+		return -1;
+
+	/* Calculate fang health */
+	calculate_fang_health(state, &pat->fangs[fang_idx], state->fluoride_used, tool_effort);
+
+	/* Update score */
+	state->score += engine_live->bonus.fang_cleaned;
+	if (pat->fangs[fang_idx].health >= MAX_HEALTH)
+		state->score += engine_live->bonus.fang_health;
+
+	return state->fluoride_used;
+}
+
+/*
+ * Close out a pass over all fangs. Returns 0 when every fang is healthy,
+ * the same as all_fangs_healthy() without looking at each one.
+ */
+int
+engine_end_round(game_state_type * state, const struct dent_bits * teeth)
+{
+	state->turns++;
+	state->score += engine_live->bonus.turn_complete;
+	return dent_all_healthy(teeth) ? 0 : -1;
+}
+
+enum engine_choice
+engine_continue_choice(const char *answer)
+{
+	switch (answer[0]) {
+	case 'y':
+	case 'Y':
+	case '\n':
+	case '\0':
+		return ENGINE_CONTINUE;
+	case 'q':
+	case 'Q':
+		return ENGINE_QUIT;
+	case 's':
+	case 'S':
+		return ENGINE_SAVE;
+	default:
+		return ENGINE_STOP;
+	}
+}
+
+/* FNV-1a over everything a stroke can change, folded to 16 bits */
+uint16_t
+engine_checksum(const game_state_type * state, const patient_type * pat)
+{
+	int		v[] = {state->fluoride, state->score, state->turns, pat->patience,
+	pat->mood, pat->patience_level};
+	uint32_t	h = 2166136261U;
+
+	for (size_t i = 0; i < sizeof(v) / sizeof(v[0]); i++) {
+		h ^= (uint32_t)v[i];
+		h *= 16777619U;
+	}
+	for (int i = 0; i < NUM_FANGS; i++) {
+		h ^= (uint32_t)pat->fangs[i].health;
+		h *= 16777619U;
+	}
+	return (uint16_t)(h ^ (h >> 16));
+}
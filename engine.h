@@ -0,0 +1,97 @@
+/*
+ * BSD Zero Clause License
+ *
+ * Copyright (c) 2025 David M Crumpton david.m.crumpton [at] gmail [dot] com
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * engine.h: the game rules shared by the interactive game and the headless
+ * simulator
+ *
+ */
+
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <sys/types.h>
+
+#include <stdint.h>
+
+#include "buffy.h"
+#include "dentition.h"
+
+enum species {
+	VAMPIRE,
+	ORC,
+	WEREWOLF,
+	SERPENT,
+	DRAGON
+};
+
+/* What the player answered to "Continue applying fluoride?" */
+enum engine_choice {
+	ENGINE_CONTINUE,
+	ENGINE_QUIT,
+	ENGINE_SAVE,
+	ENGINE_STOP		/* anything else ends the game as a success */
+};
+
+/*
+ * A species scales a stroke's health gain by percent, truncating, then
+ * adds bonus
+ */
+struct species_gain {
+	int		percent;
+	int		bonus;
+};
+
+/* Healths lo to hi, dealt in proportion to weight */
+struct health_bucket {
+	int		lo;
+	int		hi;
+	double		weight;
+};
+
+#define NUM_TOOLS	6
+#define NUM_PATIENTS	5
+#define NUM_HEALTH_BUCKETS	3
+
+extern tool	tools[NUM_TOOLS];
+extern struct patient patients[NUM_PATIENTS];
+extern struct species_gain species_gain[NUM_PATIENTS];
+extern double	tool_weight[2][NUM_TOOLS];
+extern double	patient_weight[NUM_PATIENTS];
+extern struct health_bucket health_buckets[NUM_HEALTH_BUCKETS];
+
+void		engine_health_pmf(double pmf[MAX_HEALTH + 1]);
+void		engine_deal_init(void);
+int		choose_random_tool(const int *isdaggerset);
+int		choose_random_patient(void);
+void		randomize_fangs(patient_type * pat);
+void		patient_init(game_state_type * state, patient_type * pat);
+void		engine_init_state(game_state_type * state);
+int		health_gain_for(const tool * t, const struct species_gain * sg, int fluoride_on_tool, int tool_effort);
+int		fang_health_gain_formula(const game_state_type * state, int fluoride_on_tool, int tool_effort);
+int		fang_health_gain(const game_state_type * state, int fluoride_on_tool, int tool_effort);
+int		fluoride_used_for(const tool * t, int tool_dip);
+int		fluoride_used_formula(int tool_idx, int tool_dip);
+int		calculate_fluoride_used_from_dip(int tool_dip, game_state_type * state);
+void		calculate_fang_health(const game_state_type * state, patient_fangs_type * fang, int fluoride_on_tool, int tool_effort);
+int		all_fangs_healthy(const patient_type * pat);
+int		engine_fang_turn(game_state_type * state, patient_type * pat, int fang_idx, int tool_dip, int tool_effort, char *reaction, size_t reaction_len);
+int		engine_end_round(game_state_type * state, const struct dent_bits * teeth);
+enum engine_choice engine_continue_choice(const char *answer);
+uint16_t	engine_checksum(const game_state_type * state, const patient_type * pat);
+
+#endif				/* ENGINE_H */
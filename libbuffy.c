@@ -0,0 +1,360 @@
+/*
+ * BSD Zero Clause License
+ *
+ * Copyright (c) 2025 David M Crumpton david.m.crumpton [at] gmail [dot] com
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * libbuffy.c: the turn loop of the interactive game as a state machine.
+ * Each step applies at most one change to the game, a stroke, the end of a
+ * round or the answer to the continue prompt, then moves on to the next
+ * point that needs the host, so the events it returns always describe the
+ * context as the host finds it. Only the deal draws random numbers, from
+ * a stream of its own; play is a function of the input alone.
+ *
+ */
+#include <string.h>
+
+#include "buffy.h"
+#include "engine.h"
+#include "libbuffy.h"
+#include "patient.h"
+#include "rng.h"
+#include "tables.h"
+
+
+/*
+ * Build the turn tables. Call once before the first game; the tables are
+ * only read afterwards.
+ */
+void
+buffy_lib_init(void)
+{
+	engine_tables_init();
+}
+
+/* Deal game stream of seed, as the simulators deal their game numbers */
+void
+buffy_new_game(struct buffy_ctx * ctx, uint64_t seed, uint64_t stream, int daggerset)
+{
+	struct rng	r, *was;
+
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->state.daggerset = daggerset;
+	rng_seed(&r, seed, stream);
+	was = rng_set_stream(&r);
+	engine_init_state(&ctx->state);
+	patient_init(&ctx->state, &ctx->pat);
+	rng_set_stream(was);
+	dent_init(&ctx->teeth, &ctx->pat);
+	ctx->need = BUFFY_NEED_STEP;
+}
+
+/* Pick up a saved game at the start of a round */
+void
+buffy_resume(struct buffy_ctx * ctx, const game_state_type * state, const patient_type * pat)
+{
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->state = *state;
+	ctx->pat = *pat;
+	/* Pointers saved with the game are stale; a host may name the patient */
+	ctx->pat.name = ctx->pat.species = NULL;
+	dent_init(&ctx->teeth, pat);
+	ctx->need = BUFFY_NEED_STEP;
+}
+
+static struct buffy_event *
+event(struct buffy_ctx * ctx, struct buffy_event * ev, int *n, enum buffy_event_type type)
+{
+	struct buffy_event *e = &ev[(*n)++];
+
+	memset(e, 0, sizeof(*e));
+	e->type = type;
+	e->fang = ctx->fang;
+	e->fluoride = ctx->state.fluoride;
+	e->score = ctx->state.score;
+	e->turns = ctx->state.turns;
+	if (ctx->fang < NUM_FANGS)
+		e->health = ctx->pat.fangs[ctx->fang].health;
+	return e;
+}
+
+static void
+game_over(struct buffy_ctx * ctx, struct buffy_event * ev, int *n, enum buffy_outcome outcome)
+{
+	if (outcome == BUFFY_WIN)
+		ctx->state.score += engine_live->bonus.all_health;
+	ctx->outcome = outcome;
+	ctx->need = BUFFY_NEED_NONE;
+	event(ctx, ev, n, BUFFY_EV_OVER)->outcome = outcome;
+}
+
+/* Pass over healthy fangs to the next one that wants a stroke, if any */
+static void
+next_fang(struct buffy_ctx * ctx, struct buffy_event * ev, int *n)
+{
+	int		next = dent_next(&ctx->teeth.bits, ctx->fang);
+
+	for (; ctx->fang < next; ctx->fang++)
+		event(ctx, ev, n, BUFFY_EV_SKIP);
+	if (next < NUM_FANGS) {
+		event(ctx, ev, n, BUFFY_EV_ASK_STROKE);
+		ctx->need = BUFFY_NEED_STROKE;
+		return;
+	}
+	ctx->need = BUFFY_NEED_STEP;
+}
+
+/*
+ * Advance the game by one change. in is read only when ctx->need asks for
+ * a stroke or an answer. Fills ev, which has room for BUFFY_MAX_EVENTS,
+ * and returns how many events there are, or -1 when input was needed and
+ * in is NULL.
+ */
+int
+buffy_step(struct buffy_ctx * ctx, const struct buffy_input * in, struct buffy_event * ev)
+{
+	struct buffy_event *e;
+	int		n = 0, used;
+
+	switch (ctx->need) {
+	case BUFFY_NEED_STROKE:
+		if (in == NULL)
+			return -1;
+		used = engine_fang_turn(&ctx->state, &ctx->pat, ctx->fang, in->dip, in->effort, NULL, 0);
+		dent_update(&ctx->teeth, ctx->fang, ctx->pat.fangs[ctx->fang].health);
+		e = event(ctx, ev, &n, BUFFY_EV_STROKE);
+		e->dip = in->dip;
+		e->effort = in->effort;
+		e->used = used;
+		e->reaction = ctx->pat.mood * 3 + ctx->pat.patience_level;
+		e->checksum = engine_checksum(&ctx->state, &ctx->pat);
+		if (used == -1) {
+			game_over(ctx, ev, &n, BUFFY_NO_FLUORIDE);
+			break;
+		}
+		ctx->fang++;
+		next_fang(ctx, ev, &n);
+		break;
+	case BUFFY_NEED_STEP:
+		/* A new game or round starts at the first fang */
+		if (ctx->fang < NUM_FANGS) {
+			next_fang(ctx, ev, &n);
+			if (ctx->need == BUFFY_NEED_STROKE)
+				break;
+		}
+		if (engine_end_round(&ctx->state, &ctx->teeth.bits) == 0) {
+			event(ctx, ev, &n, BUFFY_EV_ROUND);
+			game_over(ctx, ev, &n, BUFFY_WIN);
+			break;
+		}
+		event(ctx, ev, &n, BUFFY_EV_ROUND);
+		event(ctx, ev, &n, BUFFY_EV_ASK_ANSWER);
+		ctx->need = BUFFY_NEED_ANSWER;
+		break;
+	case BUFFY_NEED_ANSWER:
+		if (in == NULL)
+			return -1;
+		switch (in->answer) {
+		case ENGINE_CONTINUE:
+			ctx->fang = 0;
+			next_fang(ctx, ev, &n);
+			break;
+		case ENGINE_QUIT:
+			game_over(ctx, ev, &n, BUFFY_QUIT);
+			break;
+		case ENGINE_SAVE:
+			game_over(ctx, ev, &n, BUFFY_SAVE);
+			break;
+		default:
+			game_over(ctx, ev, &n, BUFFY_WIN);
+		}
+		break;
+	case BUFFY_NEED_NONE:
+		break;
+	}
+	return n;
+}
+
+void
+buffy_history_init(struct buffy_history * h)
+{
+	memset(h, 0, sizeof(*h));
+}
+
+#define HIST(h, i)	(&(h)->entry[(i) & (BUFFY_HISTORY - 1)])
+
+/*
+ * buffy_step() that remembers each stroke in h. A stroke drops whatever
+ * was left to redo; when the ring is full the oldest stroke hands its dip,
+ * effort and fluoride drawn to base and is forgotten.
+ */
+int
+buffy_play(struct buffy_ctx * ctx, struct buffy_history * h, const struct buffy_input * in, struct buffy_event * ev)
+{
+	struct buffy_delta *d;
+	int		f = ctx->fang;
+
+	if (ctx->need != BUFFY_NEED_STROKE || in == NULL)
+		return buffy_step(ctx, in, ev);
+
+	if (h->cur == h->first) {
+		h->base_dip = ctx->state.tool_dip;
+		h->base_effort = ctx->state.tool_effort;
+		h->base_used = ctx->state.fluoride_used;
+	} else if (h->cur - h->first == BUFFY_HISTORY) {
+		d = HIST(h, h->first);
+		h->base_dip = d->dip;
+		h->base_effort = d->effort;
+		h->base_used = d->fluoride - HIST(h, h->first + 1)->fluoride;
+		h->first++;
+	}
+	d = HIST(h, h->cur);
+	d->fluoride = ctx->state.fluoride;
+	d->score = ctx->state.score;
+	d->turns = ctx->state.turns;
+	d->dip = in->dip;
+	d->effort = in->effort;
+	d->last_dip = ctx->state.last_tool_dip[f];
+	d->last_effort = ctx->state.last_tool_effort[f];
+	d->patience = (int16_t)ctx->pat.patience;
+	d->fang = (uint8_t)f;
+	d->health = (uint8_t)ctx->pat.fangs[f].health;
+	d->mood = (uint8_t)ctx->pat.mood;
+	d->patience_level = (uint8_t)ctx->pat.patience_level;
+	h->last = ++h->cur;
+
+	return buffy_step(ctx, in, ev);
+}
+
+/*
+ * Take back the last stroke and everything after it, the end of a round
+ * and the answer included, and ask for that stroke again. Returns the
+ * events, or -1 when there is nothing to undo.
+ */
+int
+buffy_undo(struct buffy_ctx * ctx, struct buffy_history * h, struct buffy_event * ev)
+{
+	const struct buffy_delta *d;
+	int		f, n = 0;
+
+	if (h->cur == h->first)
+		return -1;
+	d = HIST(h, --h->cur);
+	f = d->fang;
+	if (h->cur == h->first) {
+		ctx->state.tool_dip = h->base_dip;
+		ctx->state.tool_effort = h->base_effort;
+		ctx->state.fluoride_used = h->base_used;
+	} else {
+		const struct buffy_delta *prev = HIST(h, h->cur - 1);
+
+		ctx->state.tool_dip = prev->dip;
+		ctx->state.tool_effort = prev->effort;
+		ctx->state.fluoride_used = prev->fluoride - d->fluoride;
+	}
+	ctx->state.fluoride = d->fluoride;
+	ctx->state.score = d->score;
+	ctx->state.turns = d->turns;
+	ctx->state.last_tool_dip[f] = d->last_dip;
+	ctx->state.last_tool_effort[f] = d->last_effort;
+	ctx->pat.patience = d->patience;
+	ctx->pat.fangs[f].health = d->health;
+	dent_update(&ctx->teeth, f, d->health);
+	ctx->pat.mood = d->mood;
+	ctx->pat.patience_level = d->patience_level;
+	ctx->fang = f;
+	ctx->outcome = BUFFY_WIN;	/* as a game in play has it */
+	ctx->need = BUFFY_NEED_STROKE;
+	event(ctx, ev, &n, BUFFY_EV_ASK_STROKE);
+	return n;
+}
+
+/*
+ * Whether buffy_redo() has a stroke to play: one was taken back and the
+ * game is waiting for that same stroke again, so play came back the same
+ * way.
+ */
+int
+buffy_can_redo(const struct buffy_ctx * ctx, const struct buffy_history * h)
+{
+	const struct buffy_delta *d = HIST(h, h->cur);
+
+	return h->cur != h->last && ctx->need == BUFFY_NEED_STROKE && ctx->fang == d->fang &&
+	    ctx->state.fluoride == d->fluoride && ctx->state.turns == d->turns;
+}
+
+/* Play the stroke buffy_undo() took back. Returns its events, or -1. */
+int
+buffy_redo(struct buffy_ctx * ctx, struct buffy_history * h, struct buffy_event * ev)
+{
+	const struct buffy_delta *d = HIST(h, h->cur);
+	struct buffy_input in = {0, 0, ENGINE_CONTINUE};
+
+	if (!buffy_can_redo(ctx, h))
+		return -1;
+	in.dip = d->dip;
+	in.effort = d->effort;
+	h->cur++;
+	return buffy_step(ctx, &in, ev);
+}
+
+/*
+ * Try n candidate strokes on the fang waiting for one, each on a copy of
+ * the game on the stack, without changing ctx. Nothing is allocated or
+ * printed, so a prompt can call it on every keystroke. Returns n, or -1
+ * when the game is not waiting for a stroke.
+ */
+int
+buffy_preview(const struct buffy_ctx * ctx, const struct buffy_input * in, int n, struct buffy_preview * out)
+{
+	if (ctx->need != BUFFY_NEED_STROKE)
+		return -1;
+	for (int i = 0; i < n; i++) {
+		game_state_type	state = ctx->state;
+		patient_type	pat = ctx->pat;
+
+		out[i].dip = in[i].dip;
+		out[i].effort = in[i].effort;
+		out[i].used = engine_fang_turn(&state, &pat, ctx->fang, in[i].dip, in[i].effort, NULL, 0);
+		out[i].health = pat.fangs[ctx->fang].health;
+		out[i].fluoride = state.fluoride;
+		out[i].score = state.score;
+		out[i].mood = pat.mood;
+		out[i].patience_level = pat.patience_level;
+	}
+	return n;
+}
+
+/*
+ * Real time play: the patient has waited another while for the next
+ * stroke and loses a point of patience. The deal and the strokes alone no
+ * longer decide the game, so such games are not recorded.
+ */
+void
+buffy_fidget(struct buffy_ctx * ctx)
+{
+	if (ctx->need == BUFFY_NEED_NONE || ctx->pat.patience <= 0)
+		return;
+	ctx->pat.patience--;
+	ctx->pat.patience_level = TBL_PATIENCE_LEVEL(ctx->pat.patience);
+}
+
+/* The patient's comment on a stroke */
+void
+buffy_reaction_text(const struct buffy_ctx * ctx, const struct buffy_event * ev, char *buf, size_t len)
+{
+	patient_comment(buf, len, ev->reaction, (uint32_t)ev->checksum << 8 | (uint32_t)ev->fang,
+	    ctx->pat.name != NULL ? ctx->pat.name : patients[ctx->state.patient_idx].name);
+}
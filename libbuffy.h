@@ -0,0 +1,167 @@
+/*
+ * BSD Zero Clause License
+ *
+ * Copyright (c) 2025 David M Crumpton david.m.crumpton [at] gmail [dot] com
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * libbuffy.h: the game as a reentrant state machine. A host owns one
+ * buffy_ctx per game and feeds it input with buffy_step(); nothing blocks,
+ * prints or touches a global, so any number of games can be stepped from
+ * one thread or from many.
+ *
+ */
+
+#ifndef LIBBUFFY_H
+#define LIBBUFFY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "buffy.h"
+#include "dentition.h"
+#include "engine.h"
+
+#define BUFFY_MAX_EVENTS	(NUM_FANGS + 4)	/* no step produces more */
+
+/* What the next buffy_step() needs */
+enum buffy_need {
+	BUFFY_NEED_STEP,	/* nothing, the game moves on by itself */
+	BUFFY_NEED_STROKE,	/* dip and effort for ctx->fang */
+	BUFFY_NEED_ANSWER,	/* the answer to "Continue?" */
+	BUFFY_NEED_NONE		/* the game is over */
+};
+
+/* In the order of enum replay_outcome */
+enum buffy_outcome {
+	BUFFY_WIN,
+	BUFFY_NO_FLUORIDE,
+	BUFFY_QUIT,
+	BUFFY_SAVE
+};
+
+enum buffy_event_type {
+	BUFFY_EV_SKIP,		/* fang is already healthy */
+	BUFFY_EV_ASK_STROKE,	/* fang needs a dip and effort */
+	BUFFY_EV_STROKE,	/* a stroke was applied to fang */
+	BUFFY_EV_ROUND,		/* every fang has had its turn */
+	BUFFY_EV_ASK_ANSWER,	/* keep going? */
+	BUFFY_EV_OVER		/* outcome */
+};
+
+/* The state fields are as they stand once the event has happened */
+struct buffy_event {
+	enum buffy_event_type type;
+	int		fang;
+	int		dip;
+	int		effort;
+	int		used;	/* fluoride drawn, -1 when too little was left */
+	int		health;	/* of the fang */
+	int		reaction;	/* mood * 3 + patience level */
+	int		fluoride;
+	int		score;
+	int		turns;
+	uint16_t	checksum;	/* engine_checksum() after a stroke */
+	enum buffy_outcome outcome;
+};
+
+struct buffy_input {
+	int		dip;
+	int		effort;
+	enum engine_choice answer;
+};
+
+/* What a stroke would leave behind, from buffy_preview() */
+struct buffy_preview {
+	int		dip;
+	int		effort;
+	int		used;	/* fluoride drawn, -1 when too little is left */
+	int		health;	/* of the fang */
+	int		fluoride;
+	int		score;
+	int		mood;
+	int		patience_level;
+};
+
+/*
+ * Everything about one game. The host may read state and pat between
+ * steps but changes them only through buffy_step().
+ */
+struct buffy_ctx {
+	game_state_type	state;
+	patient_type	pat;
+	struct dentition teeth;	/* the fangs of pat still to clean */
+	enum buffy_need	need;
+	int		fang;	/* the fang a stroke goes to */
+	enum buffy_outcome outcome;
+};
+
+#define BUFFY_HISTORY	256	/* strokes that can be taken back, a power of 2 */
+
+/*
+ * What a stroke changed, as it was before: the fang's fields and the
+ * counters. The rest of the game is shared with the context. The dip and
+ * effort the state held before are the previous entry's stroke, so they
+ * live only there, or in base for the oldest entry.
+ */
+struct buffy_delta {
+	int32_t		fluoride;
+	int32_t		score;
+	int32_t		turns;
+	int32_t		dip;	/* the stroke, replayed by buffy_redo() */
+	int32_t		effort;
+	int32_t		last_dip;	/* of the fang */
+	int32_t		last_effort;
+	int16_t		patience;
+	uint8_t		fang;
+	uint8_t		health;
+	uint8_t		mood;
+	uint8_t		patience_level;
+};
+
+/*
+ * A ring of the last BUFFY_HISTORY strokes. Entries first..cur can be
+ * undone and cur..last redone; the counters only grow and are masked
+ * into the ring, so the oldest stroke is forgotten in place.
+ */
+struct buffy_history {
+	struct buffy_delta entry[BUFFY_HISTORY];
+	uint32_t	first;
+	uint32_t	cur;
+	uint32_t	last;
+	int		base_dip;	/* state before entry first */
+	int		base_effort;
+	int		base_used;
+};
+
+static inline int
+buffy_undos(const struct buffy_history * h)
+{
+	return (int)(h->cur - h->first);
+}
+
+void		buffy_lib_init(void);
+void		buffy_new_game(struct buffy_ctx * ctx, uint64_t seed, uint64_t stream, int daggerset);
+void		buffy_resume(struct buffy_ctx * ctx, const game_state_type * state, const patient_type * pat);
+int		buffy_step(struct buffy_ctx * ctx, const struct buffy_input * in, struct buffy_event * ev);
+void		buffy_history_init(struct buffy_history * h);
+int		buffy_play(struct buffy_ctx * ctx, struct buffy_history * h, const struct buffy_input * in, struct buffy_event * ev);
+int		buffy_undo(struct buffy_ctx * ctx, struct buffy_history * h, struct buffy_event * ev);
+int		buffy_can_redo(const struct buffy_ctx * ctx, const struct buffy_history * h);
+int		buffy_redo(struct buffy_ctx * ctx, struct buffy_history * h, struct buffy_event * ev);
+int		buffy_preview(const struct buffy_ctx * ctx, const struct buffy_input * in, int n, struct buffy_preview * out);
+void		buffy_fidget(struct buffy_ctx * ctx);
+void		buffy_reaction_text(const struct buffy_ctx * ctx, const struct buffy_event * ev, char *buf, size_t len);
+
+#endif				/* LIBBUFFY_H */
@@ -0,0 +1,388 @@
+/*
+ * BSD Zero Clause License
+ *
+ * Copyright (c) 2025 David M Crumpton david.m.crumpton [at] gmail [dot] com
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * mcts.c: a Monte Carlo tree search player. After the deal the game has no
+ * chance left in it, so the search walks the exact game: a node is a packed
+ * game position, found again by its Zobrist hash however it was reached,
+ * and a playout finishes the game with a greedy hygienist.
+ *
+ * Only strokes that are not dominated are searched: for every tool and
+ * species, a stroke whose gain another stroke matches for less fluoride is
+ * dropped, and of strokes alike in both the gentlest effort is kept.
+ *
+ */
+#include <err.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "buffy.h"
+#include "engine.h"
+#include "mcts.h"
+#include "packed.h"
+#include "policy.h"
+#include "rng.h"
+#include "simulate.h"
+#include "tables.h"
+
+#define MCTS_PROBES	4	/* slots tried before a position goes unstored */
+#define MCTS_EXPLORE	0.5
+#define MCTS_TT_SIZE	(1U << MCTS_TT_BITS)
+
+#define MCTS_PLAYING	0
+#define MCTS_WON	1
+#define MCTS_STALLED	2
+
+/* A game position and its Zobrist hash, which keys the table */
+struct mcts_state {
+	struct packed_state ps;
+	uint64_t	hash;
+	int		rounds;
+	int		done;
+};
+
+struct mcts_action {
+	int		dip;
+	int		effort;
+	int		gain;
+	int		used;
+};
+
+struct mcts_node {
+	uint64_t	key;
+	uint32_t	gen;	/* stale unless it matches the player's */
+	uint32_t	visits;
+	uint32_t	n[MCTS_MAX_ACTIONS];
+	float		w[MCTS_MAX_ACTIONS];
+};
+
+struct mcts_policy {
+	struct policy	base;
+	long		budget_us;
+	long		nodes;
+	int		tool_idx;	/* cell the actions were built for */
+	int		species;
+	int		nactions;
+	struct mcts_action actions[MCTS_MAX_ACTIONS];
+	uint32_t	gen;
+	uint32_t	stored;	/* nodes of this generation */
+	struct mcts_node *tt;
+};
+
+struct mcts_step {
+	struct mcts_node *node;
+	int		action;
+};
+
+
+static void
+build_actions(struct mcts_policy * m, int tool_idx, int species)
+{
+	const tool     *t = &engine_live->tools[tool_idx];
+
+	m->tool_idx = tool_idx;
+	m->species = species;
+	m->nactions = 0;
+	for (int dip = 0; dip <= t->dip_amount; dip++) {
+		for (int effort = 0; effort <= t->effort; effort++) {
+			int		used = TBL_FLUORIDE_USED(tool_idx, dip);
+			int		gain = TBL_GAIN(tool_idx, species, used, effort);
+			int		dominated = 0;
+
+			for (int d = 0; d <= t->dip_amount && !dominated; d++)
+				for (int e = 0; e <= t->effort && !dominated; e++) {
+					int		u = TBL_FLUORIDE_USED(tool_idx, d);
+					int		g = TBL_GAIN(tool_idx, species, u, e);
+
+					if (g >= gain && u <= used && (g > gain || u < used))
+						dominated = 1;
+				}
+			for (int a = 0; a < m->nactions && !dominated; a++)
+				dominated = m->actions[a].gain == gain && m->actions[a].used == used;
+			if (dominated)
+				continue;
+			if (m->nactions == MCTS_MAX_ACTIONS)
+				errx(1, "%s makes more than %d distinct strokes", t->name, MCTS_MAX_ACTIONS);
+			m->actions[m->nactions++] = (struct mcts_action) {dip, effort, gain, used};
+		}
+	}
+}
+
+static uint32_t
+slot_of(uint64_t key)
+{
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdULL;
+	key ^= key >> 33;
+	return (uint32_t)key & (MCTS_TT_SIZE - 1);
+}
+
+/* Find a position, storing it if there is room. NULL when there is not. */
+static struct mcts_node *
+tt_find(struct mcts_policy * m, uint64_t key)
+{
+	uint32_t	slot = slot_of(key);
+
+	for (int i = 0; i < MCTS_PROBES; i++) {
+		struct mcts_node *node = &m->tt[(slot + i) & (MCTS_TT_SIZE - 1)];
+
+		if (node->gen == m->gen && node->key == key)
+			return node;
+		if (node->gen != m->gen) {
+			memset(node, 0, sizeof(*node));
+			node->key = key;
+			node->gen = m->gen;
+			m->stored++;
+			return node;
+		}
+	}
+	return NULL;
+}
+
+static void
+next_generation(struct mcts_policy * m)
+{
+	if (++m->gen == 0) {
+		memset(m->tt, 0, sizeof(*m->tt) * MCTS_TT_SIZE);
+		m->gen = 1;
+	}
+	m->stored = 0;
+}
+
+/* One stroke then on to the next dirty fang, closing the round as needed */
+static void
+apply(const struct mcts_action * a, struct mcts_state * s)
+{
+	packed_fang_turn(&s->ps, &s->hash, a->dip, a->effort);
+	if (!packed_next_fang(&s->ps, &s->hash))
+		return;
+	s->rounds++;
+	if (s->ps.fang == NUM_FANGS)
+		s->done = MCTS_WON;
+	else if (s->rounds > SIM_MAX_TURNS)
+		s->done = MCTS_STALLED;
+}
+
+/* A win is worth more than any loss, and more so with fluoride to spare */
+static double
+reward(const struct mcts_state * s)
+{
+	int		health = 0;
+
+	if (s->done == MCTS_WON)
+		return 0.6 + 0.4 * (s->ps.fluoride > DEFAULT_FLUORIDE ? 1.0 : (double)s->ps.fluoride / DEFAULT_FLUORIDE);
+	for (int f = 0; f < NUM_FANGS; f++)
+		health += s->ps.health[f];
+	return 0.5 * health / (NUM_FANGS * MAX_HEALTH);
+}
+
+/*
+ * Mostly the cheapest stroke that finishes the fang, otherwise any
+ * affordable stroke that helps.
+ */
+static int
+playout_action(const struct mcts_policy * m, const struct mcts_state * s)
+{
+	int		need = MAX_HEALTH - s->ps.health[s->ps.fang];
+	int		finish = -1, helps[MCTS_MAX_ACTIONS], nhelps = 0;
+
+	for (int a = 0; a < m->nactions; a++) {
+		const struct mcts_action *act = &m->actions[a];
+
+		if (act->used > s->ps.fluoride)
+			continue;
+		if (act->gain >= need && (finish == -1 || act->used < m->actions[finish].used))
+			finish = a;
+		if (act->gain > 0)
+			helps[nhelps++] = a;
+	}
+	if (finish != -1 && (nhelps == 0 || rng_uniform(4) != 0))
+		return finish;
+	if (nhelps > 0)
+		return helps[rng_uniform(nhelps)];
+	return 0;
+}
+
+static double
+playout(const struct mcts_policy * m, struct mcts_state s)
+{
+	int		stop = s.rounds + MCTS_ROLLOUT_ROUNDS;
+
+	while (!s.done && s.rounds < stop)
+		apply(&m->actions[playout_action(m, &s)], &s);
+	return reward(&s);
+}
+
+/* UCB1 over the affordable strokes, trying each once first */
+static int
+select_action(const struct mcts_policy * m, const struct mcts_node * node, const struct mcts_state * s)
+{
+	double		best = -1.0, log_visits = log((double)node->visits + 1.0);
+	int		choice = 0;
+
+	for (int a = 0; a < m->nactions; a++) {
+		if (m->actions[a].used > s->ps.fluoride)
+			continue;
+		if (node->n[a] == 0)
+			return a;
+
+		double		score = node->w[a] / node->n[a] +
+		MCTS_EXPLORE * sqrt(log_visits / node->n[a]);
+
+		if (score > best) {
+			best = score;
+			choice = a;
+		}
+	}
+	return choice;
+}
+
+static void
+iterate(struct mcts_policy * m, const struct mcts_state * root)
+{
+	struct mcts_step path[MCTS_MAX_DEPTH];
+	struct mcts_state s = *root;
+	int		depth = 0;
+	double		value;
+
+	while (!s.done && depth < MCTS_MAX_DEPTH) {
+		struct mcts_node *node = tt_find(m, s.hash);
+		int		fresh;
+
+		if (node == NULL)
+			break;
+		fresh = node->visits == 0;
+		path[depth].node = node;
+		path[depth].action = select_action(m, node, &s);
+		apply(&m->actions[path[depth].action], &s);
+		depth++;
+		if (fresh)
+			break;
+	}
+	value = s.done ? reward(&s) : playout(m, s);
+
+	while (depth-- > 0) {
+		path[depth].node->visits++;
+		path[depth].node->n[path[depth].action]++;
+		path[depth].node->w[path[depth].action] += (float)value;
+	}
+}
+
+static double
+elapsed_us(const struct timespec * start)
+{
+	struct timespec	now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) * 1e6 + (now.tv_nsec - start->tv_nsec) / 1e3;
+}
+
+static void
+mcts_choose(struct policy * p, const game_state_type * state, const patient_type * pat, int fang_idx, int *tool_dip, int *tool_effort)
+{
+	struct mcts_policy *m = (struct mcts_policy *)p;
+	struct mcts_state root;
+	struct mcts_node *node;
+	struct timespec	start;
+	long		it = 0;
+	int		best = -1, affordable = 0, helps = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if (m->tool_idx != state->tool_in_use || m->species != state->patient_idx) {
+		build_actions(m, state->tool_in_use, state->patient_idx);
+		next_generation(m);
+	}
+	/* Keep the tree of earlier moves while the table has room */
+	if (m->stored > MCTS_TT_SIZE / 2)
+		next_generation(m);
+
+	memset(&root, 0, sizeof(root));
+	packed_pack(state, pat, fang_idx, &root.ps);
+	root.hash = packed_hash(&root.ps);
+	root.rounds = state->turns;
+
+	/* Fluoride never comes back, so neither does a helpful stroke */
+	for (int a = 0; a < m->nactions; a++)
+		if (m->actions[a].used <= root.ps.fluoride) {
+			affordable++;
+			helps += m->actions[a].gain > 0;
+		}
+	p->hopeless = helps == 0;
+	if (affordable > 1) {
+		while ((m->nodes == 0 || it < m->nodes) &&
+		       (m->budget_us == 0 || (it & 31) != 0 || elapsed_us(&start) < m->budget_us)) {
+			iterate(m, &root);
+			it++;
+		}
+	}
+
+	/* The most visited stroke; the playout's choice if nothing was stored */
+	if ((node = tt_find(m, root.hash)) != NULL)
+		for (int a = 0; a < m->nactions; a++)
+			if (node->n[a] > 0 && (best == -1 || node->n[a] > node->n[best]))
+				best = a;
+	if (best == -1)
+		best = playout_action(m, &root);
+	*tool_dip = m->actions[best].dip;
+	*tool_effort = m->actions[best].effort;
+
+	double		us = elapsed_us(&start);
+
+	p->stats.moves++;
+	p->stats.iterations += it;
+	p->stats.total_us += us;
+	if (us > p->stats.max_us)
+		p->stats.max_us = us;
+}
+
+static void
+mcts_new_game(struct policy * p)
+{
+	next_generation((struct mcts_policy *)p);
+}
+
+static void
+mcts_free(struct policy * p)
+{
+	free(((struct mcts_policy *)p)->tt);
+	free(p);
+}
+
+struct policy  *
+mcts_policy_new(const struct policy_config * cfg)
+{
+	struct mcts_policy *m;
+
+	if ((m = calloc(1, sizeof(*m))) == NULL ||
+	    (m->tt = malloc(sizeof(*m->tt) * MCTS_TT_SIZE)) == NULL)
+		err(1, "mcts");
+	/* Fault the table in now rather than during the first moves */
+	memset(m->tt, 0, sizeof(*m->tt) * MCTS_TT_SIZE);
+	m->base.name = "mcts";
+	m->base.choose = mcts_choose;
+	m->base.new_game = mcts_new_game;
+	m->base.free = mcts_free;
+	m->budget_us = cfg->budget_us;
+	m->nodes = cfg->nodes;
+	if (m->budget_us == 0 && m->nodes == 0)
+		m->nodes = MCTS_DEFAULT_NODES;
+	m->tool_idx = m->species = -1;
+	m->gen = 1;
+	return &m->base;
+}
@@ -0,0 +1,37 @@
+/*
+ * BSD Zero Clause License
+ *
+ * Copyright (c) 2025 David M Crumpton david.m.crumpton [at] gmail [dot] com
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * mcts.h: Monte Carlo tree search player with a transposition table
+ *
+ */
+
+#ifndef MCTS_H
+#define MCTS_H
+
+#include "policy.h"
+
+#define MCTS_MAX_ACTIONS	16	/* distinct strokes a tool can make */
+#define MCTS_TT_BITS		15	/* 2^15 table slots per player */
+#define MCTS_MAX_DEPTH		256	/* strokes below the root */
+#define MCTS_ROLLOUT_ROUNDS	64	/* rounds a rollout plays at most */
+#define MCTS_DEFAULT_BUDGET_US	5000
+#define MCTS_DEFAULT_NODES	4096
+
+struct policy  *mcts_policy_new(const struct policy_config * cfg);
+
+#endif				/* MCTS_H */
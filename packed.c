@@ -0,0 +1,138 @@
+/*
+ * BSD Zero Clause License
+ *
+ * Copyright (c) 2025 David M Crumpton david.m.crumpton [at] gmail [dot] com
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * packed.c: packing game positions and hashing them. A stroke applied to a
+ * packed state gives the same fluoride, patience and fang health as
+ * engine_fang_turn() and moves the hash along with the bytes it changes.
+ *
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include "buffy.h"
+#include "engine.h"
+#include "packed.h"
+#include "rng.h"
+#include "tables.h"
+
+#define PACKED_ZOBRIST_SEED	0x7a6f6272697374ULL
+
+
+uint64_t	packed_zobrist[PACKED_BYTES][256];
+
+/* Fixed keys, so hashes are the same on every run and machine */
+void
+packed_zobrist_init(void)
+{
+	struct rng	r;
+
+	rng_seed(&r, PACKED_ZOBRIST_SEED, 0);
+	for (int i = 0; i < PACKED_BYTES; i++)
+		for (int b = 0; b < 256; b++) {
+			uint64_t	lo = rng_next(&r);
+
+			packed_zobrist[i][b] = lo | (uint64_t)rng_next(&r) << 32;
+		}
+}
+
+void
+packed_pack(const game_state_type * state, const patient_type * pat, int fang_idx, struct packed_state * ps)
+{
+	memset(ps, 0, sizeof(*ps));
+	for (int f = 0; f < NUM_FANGS; f++) {
+		ps->health[f] = (uint8_t)tbl_clamp(pat->fangs[f].health, MAX_HEALTH);
+		ps->shape[f] = (uint8_t)((pat->fangs[f].length & 0x0f) << 4 | (pat->fangs[f].sharpness & 0x0f));
+	}
+	ps->fluoride = (uint16_t)tbl_clamp(state->fluoride, UINT16_MAX);
+	ps->patience = (uint8_t)tbl_clamp(pat->patience, UINT8_MAX);
+	ps->tool_species = (uint8_t)(state->tool_in_use << 4 | state->patient_idx);
+	ps->fang = (uint8_t)fang_idx;
+}
+
+/* Fills in the numbers; names and other pointers are left alone */
+void
+packed_unpack(const struct packed_state * ps, game_state_type * state, patient_type * pat)
+{
+	for (int f = 0; f < NUM_FANGS; f++) {
+		pat->fangs[f].health = ps->health[f];
+		pat->fangs[f].length = ps->shape[f] >> 4;
+		pat->fangs[f].sharpness = ps->shape[f] & 0x0f;
+	}
+	pat->patience = ps->patience;
+	pat->pain_tolerance = 0;
+	state->fluoride = ps->fluoride;
+	state->tool_in_use = PACKED_TOOL(ps);
+	state->patient_idx = PACKED_SPECIES(ps);
+}
+
+uint64_t
+packed_hash(const struct packed_state * ps)
+{
+	const uint8_t  *b = (const uint8_t *)ps;
+	uint64_t	h = 0;
+
+	for (size_t i = 0; i < PACKED_BYTES; i++)
+		h ^= packed_zobrist[i][b[i]];
+	return h;
+}
+
+/*
+ * Clean the current fang as engine_fang_turn() would. Returns the
+ * fluoride used, or -1 when the dip needs more than is left.
+ */
+int
+packed_fang_turn(struct packed_state * ps, uint64_t * hash, int tool_dip, int tool_effort)
+{
+	int		tool_idx = PACKED_TOOL(ps), fang = ps->fang;
+	int		used = TBL_FLUORIDE_USED(tool_idx, tool_dip);
+
+	if (ps->health[fang] > 0 && ps->patience > 0)
+		packed_set_byte(ps, hash, offsetof(struct packed_state, patience), ps->patience - 1);
+	if (used > ps->fluoride)
+		return -1;
+	packed_set_fluoride(ps, hash, ps->fluoride - used);
+
+	int		h = ps->health[fang] + TBL_GAIN(tool_idx, PACKED_SPECIES(ps), used, tool_effort);
+
+	packed_set_byte(ps, hash, offsetof(struct packed_state, health) + fang, (uint8_t)tbl_clamp(h, MAX_HEALTH));
+	return used;
+}
+
+/*
+ * Move on to the next fang still dirty. Returns 1 when that closes the
+ * round, with the cursor on the first dirty fang or on NUM_FANGS when
+ * every fang is clean.
+ */
+int
+packed_next_fang(struct packed_state * ps, uint64_t * hash)
+{
+	size_t		off = offsetof(struct packed_state, fang);
+
+	for (int f = ps->fang + 1; f < NUM_FANGS; f++)
+		if (ps->health[f] < MAX_HEALTH) {
+			packed_set_byte(ps, hash, off, f);
+			return 0;
+		}
+	for (int f = 0; f < NUM_FANGS; f++)
+		if (ps->health[f] < MAX_HEALTH) {
+			packed_set_byte(ps, hash, off, f);
+			return 1;
+		}
+	packed_set_byte(ps, hash, off, NUM_FANGS);
+	return 1;
+}
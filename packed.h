@@ -0,0 +1,93 @@
+/*
+ * BSD Zero Clause License
+ *
+ * Copyright (c) 2025 David M Crumpton david.m.crumpton [at] gmail [dot] com
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * packed.h: the game position in sixteen pointer free bytes, with Zobrist
+ * hashing that follows each stroke
+ *
+ */
+
+#ifndef PACKED_H
+#define PACKED_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "buffy.h"
+#include "engine.h"
+
+/*
+ * Everything a stroke reads or changes. Names, colours and the score are
+ * left out; so is pain tolerance, which no deal sets. Unused bytes stay
+ * zero so states compare with memcmp().
+ */
+struct packed_state {
+	uint8_t		health[NUM_FANGS];
+	uint8_t		shape[NUM_FANGS];	/* length << 4 | sharpness */
+	uint16_t	fluoride;
+	uint8_t		patience;
+	uint8_t		tool_species;	/* tool << 4 | species */
+	uint8_t		fang;	/* fang the next stroke cleans */
+	uint8_t		pad[3];
+};
+
+/* 16 bytes for the four canines */
+_Static_assert(sizeof(struct packed_state) == 2 * NUM_FANGS + 8, "packed_state has holes");
+
+#define PACKED_BYTES	sizeof(struct packed_state)
+#define PACKED_TOOL(ps)		((ps)->tool_species >> 4)
+#define PACKED_SPECIES(ps)	((ps)->tool_species & 0x0f)
+
+/* One random key per byte position and value */
+extern uint64_t	packed_zobrist[PACKED_BYTES][256];
+
+void		packed_zobrist_init(void);
+void		packed_pack(const game_state_type * state, const patient_type * pat, int fang_idx, struct packed_state * ps);
+void		packed_unpack(const struct packed_state * ps, game_state_type * state, patient_type * pat);
+uint64_t	packed_hash(const struct packed_state * ps);
+int		packed_fang_turn(struct packed_state * ps, uint64_t * hash, int tool_dip, int tool_effort);
+int		packed_next_fang(struct packed_state * ps, uint64_t * hash);
+
+static inline int
+packed_equal(const struct packed_state * a, const struct packed_state * b)
+{
+	return memcmp(a, b, sizeof(*a)) == 0;
+}
+
+/* Change one byte, keeping the hash in step */
+static inline void
+packed_set_byte(struct packed_state * ps, uint64_t * hash, size_t off, uint8_t v)
+{
+	uint8_t        *b = (uint8_t *)ps + off;
+
+	*hash ^= packed_zobrist[off][*b] ^ packed_zobrist[off][v];
+	*b = v;
+}
+
+static inline void
+packed_set_fluoride(struct packed_state * ps, uint64_t * hash, int fluoride)
+{
+	uint16_t	v = (uint16_t)fluoride;
+	uint8_t		b[2];
+
+	memcpy(b, &v, sizeof(b));
+	packed_set_byte(ps, hash, offsetof(struct packed_state, fluoride), b[0]);
+	packed_set_byte(ps, hash, offsetof(struct packed_state, fluoride) + 1, b[1]);
+}
+
+#endif				/* PACKED_H */
@@ -21,8 +21,14 @@
  *
  */
 #include "stdio.h"
+
+#include <err.h>
+
+#include "alias.h"
 #include "buffy.h"
 #include "patient.h"
+#include "engine.h"
+#include "tables.h"
 
 /*
  * Patient Reaction System: For dental cleanings, low effort on a tooth is
@@ -35,30 +41,95 @@
 
 
 
+/*
+ * Any number of comments may share a mood and patience level; one of them
+ * is picked in proportion to its weight.
+ */
 struct patient_reaction {
-	int		effort_level;	/* 0 = low, 1 = medium, 2 = high */
+	int		mood;		/* 0 = happy, 1 = unhappy, 2 = angry */
 	int		patience_level;	/* 0 = low, 1 = medium, 2 = high */
+	double		weight;
 	char	       *comment;
 };
 struct patient_reaction reactions[] = {
-	{0, 0, "%s bares fangs, eyes narrowed in ancient impatience."},
-	{0, 1, "A low growl escapes-immortality has not made %s more patient."},
-	{0, 2, "%s sighs theatrically, fangs glinting, clearly unimpressed."},
-	{1, 0, "A sharp hiss-centuries of tolerance wearing thin for %s."},
-	{1, 1, "%s arches a brow, lips curled in a wry, undead smirk."},
-	{1, 2, "A nod of approval from %s, as regal as a creature of the night can muster."},
-	{2, 0, "A guttural snarl-'Careful, mortal. %s does bite back.'"},
-	{2, 1, "%s winces, but the sarcasm is sharper than the canines."},
-	{2, 2, "A rare, genuine smile-'Efficient. You may live another night,' %s intones."}
+	{0, 0, 3, "%s bares fangs, eyes narrowed in ancient impatience."},
+	{0, 0, 1, "%s drums long claws on the armrest, counting the centuries."},
+	{0, 1, 3, "A low growl escapes-immortality has not made %s more patient."},
+	{0, 1, 1, "%s glances at the moon through the window, then back at you."},
+	{0, 2, 3, "%s sighs theatrically, fangs glinting, clearly unimpressed."},
+	{0, 2, 1, "%s hums an old funeral dirge, perfectly at ease."},
+	{1, 0, 3, "A sharp hiss-centuries of tolerance wearing thin for %s."},
+	{1, 0, 2, "%s's eyes flare red-'Finish it, or be finished.'"},
+	{1, 1, 3, "%s arches a brow, lips curled in a wry, undead smirk."},
+	{1, 1, 1, "%s flinches, then pretends it was a yawn."},
+	{1, 2, 3, "A nod of approval from %s, as regal as a creature of the night can muster."},
+	{1, 2, 1, "%s grits the canines and murmurs, 'Thorough. Painfully thorough.'"},
+	{2, 0, 3, "A guttural snarl-'Careful, mortal. %s does bite back.'"},
+	{2, 0, 2, "%s lunges half out of the chair before remembering the bargain."},
+	{2, 1, 3, "%s winces, but the sarcasm is sharper than the canines."},
+	{2, 1, 1, "A clawed hand grips the chair; %s is plainly counting to a thousand."},
+	{2, 2, 3, "A rare, genuine smile-'Efficient. You may live another night,' %s intones."},
+	{2, 2, 1, "%s bears the pain with a serene, terrible calm."}
 };
 
-int		patient_mood;
-int		patience_level;
+#define NUM_REACTIONS	(int)(sizeof(reactions) / sizeof(reactions[0]))
+#define NUM_CELLS	9	/* mood * 3 + patience level */
+
+static struct alias reaction_alias[NUM_CELLS];
+
+/* Build each mood and patience level's sampler over reactions[] */
+void
+patient_reactions_init(void)
+{
+	double		weight[NUM_REACTIONS];
+
+	for (int cell = 0; cell < NUM_CELLS; cell++) {
+		for (int i = 0; i < NUM_REACTIONS; i++)
+			weight[i] = reactions[i].mood * 3 + reactions[i].patience_level == cell ?
+			    reactions[i].weight : 0;
+		if (alias_init(&reaction_alias[cell], weight, NUM_REACTIONS) == -1)
+			errx(1, "no reaction for mood %d and patience level %d", cell / 3, cell % 3);
+	}
+}
+
+/*
+ * Determine mood based on inflicted pain (more pain = angrier mood). This
+ * and patience_to_level() are the references for the turn tables.
+ */
+int
+pain_to_mood(int pain_inflicted)
+{
+	if (pain_inflicted < 0)
+		pain_inflicted = 0;
+
+	if (pain_inflicted > 8) {
+		return MOOD_ANGRY;
+	} else if (pain_inflicted > 4) {
+		return MOOD_UNHAPPY;
+	} else {
+		return MOOD_HAPPY;
+	}
+}
+
+/* Normalize patience to match reaction structure */
+int
+patience_to_level(int patience)
+{
+	if (patience > 7) {
+		return PATIENCE_BLISS;	/* High patience */
+	} else if (patience > 3) {
+		return PATIENCE_CALM;	/* Medium patience */
+	} else {
+		return PATIENCE_IMPATIENT;	/* Low patience */
+	}
+}
 
 void
 patient_reaction(char *reaction, size_t reaction_len,  int *effort, patient_type *patient, const int *tool_pain_factor, const char *patient_name, const int fang_idx) {
 
 	int		pain_inflicted;
+	int		patient_mood;
+	int		patience_level;
 
 	/* Decrease patience over time if fangs aren't fully cleaned */
 	if (patient->fangs[fang_idx].health > 0) {
@@ -67,37 +138,14 @@ patient_reaction(char *reaction, size_t reaction_len,  int *effort, patient_type
 
 	/*
 	 * Calculate pain inflicted, with modifiers for pain tolerance and
-	 * fang health
+	 * fang health. Unhealthy fangs (lower health) cause more pain.
 	 */
-    // 	patient_reaction(reaction, sizeof(reaction), &tool_effort, &patient.patience, &patient.pain_tolerance, &patient.fangs[i].health, &tools[game_state.tool_in_use].pain_factor,
-				//	 PATIENT_NAME(game_state.patient_idx), &patient.mood, &patient.patience_level);
-
 	pain_inflicted = (*effort * *tool_pain_factor) - patient->pain_tolerance;
-	pain_inflicted += (100 - patient->fangs[fang_idx].health) / 10;
-	//Unhealthy fangs(lower health) cause more pain.
-		if (pain_inflicted < 0) {
-		pain_inflicted = 0;
-	}
-
-	/* Determine mood based on inflicted pain (more pain = angrier mood) */
-	if (pain_inflicted > 8) {
-		patient_mood = MOOD_ANGRY;
-	} else if (pain_inflicted > 4) {
-		patient_mood = MOOD_UNHAPPY;
-	} else {
-		patient_mood = MOOD_HAPPY;
-	}
+	pain_inflicted += TBL_HEALTH_PAIN(patient->fangs[fang_idx].health);
 
-
-	/* Normalize patience to match reaction structure */
-
-	if (patient->patience > 7) {
-		patience_level = PATIENCE_BLISS;	/* High patience */
-	} else if (patient->patience > 3) {
-		patience_level = PATIENCE_CALM;	/* Medium patience */
-	} else {
-		patience_level = PATIENCE_IMPATIENT;	/* Low patience */
-	}
+	/* Mood follows the pain, patience level the remaining patience */
+	patient_mood = TBL_MOOD(pain_inflicted);
+	patience_level = TBL_PATIENCE_LEVEL(patient->patience);
 
 	int		index = (patient_mood * 3) + patience_level;	/* Changed from effort
 									 * to patient_mood */
@@ -105,8 +153,27 @@ patient_reaction(char *reaction, size_t reaction_len,  int *effort, patient_type
 	patient->patience_level = patience_level;
 	patient->mood = patient_mood;
 
-	if (index >= 0 && index < (int)(sizeof(reactions) / sizeof(reactions[0]))) {
-		snprintf(reaction, reaction_len, reactions[index].comment, patient_name ? patient_name : "the patient");
+	/* The simulator has no use for the comment text */
+	if (reaction == NULL)
+		return;
+
+	patient_comment(reaction, reaction_len, index,
+	    (uint32_t)patient->patience << 16 | (uint32_t)patient->fangs[fang_idx].health << 8 | (uint32_t)fang_idx,
+	    patient_name);
+}
+
+/*
+ * A comment for a reaction, numbered mood * 3 + patience level. The key
+ * picks among the reaction's comments, the same one every time, so the
+ * game's random stream is left to the deal.
+ */
+void
+patient_comment(char *reaction, size_t reaction_len, int index, uint32_t key, const char *patient_name)
+{
+	if (index >= 0 && index < NUM_CELLS) {
+		int		i = alias_pick(&reaction_alias[index], alias_mix(key));
+
+		snprintf(reaction, reaction_len, reactions[i].comment, patient_name ? patient_name : "the patient");
 		return;
 	}
 
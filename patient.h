@@ -25,12 +25,14 @@
 #define PATIENT_H
 
 #include "sys/types.h"
+#include <stdint.h>
 #include "playerio.h"
 
+int		pain_to_mood(int pain_inflicted);
+int		patience_to_level(int patience);
 void patient_reaction(char *reaction, size_t reaction_len, int *effort, patient_type *patient, const int *tool_pain_factor, const char *patient_name, const int fang_idx);
-
-static int	last_mood = -1;
-static int	last_turn = -1;
+void		patient_reactions_init(void);
+void		patient_comment(char *reaction, size_t reaction_len, int index, uint32_t key, const char *patient_name);
 
 #define MOOD_HAPPY      0
 #define MOOD_UNHAPPY    1
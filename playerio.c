@@ -20,6 +20,7 @@
  *
  */
 
+#include <poll.h>
 #include <stdio.h>
 #include <ncurses.h>
 #include <unistd.h>
@@ -163,6 +164,96 @@ get_input(const char *prompt, char *buffer, size_t size)
 	}
 }
 
+/*
+ * Input that never blocks, for real time play. input_begin() shows the
+ * prompt and input_poll() takes whatever has been typed since, so the
+ * caller can keep its clock running in between.
+ */
+static size_t	input_len;
+
+void
+input_begin(const char *prompt)
+{
+	input_len = 0;
+	if (using_curses) {
+		wprintw(inp_win, "%s", prompt);
+		noecho();
+		keypad(inp_win, TRUE);
+		wtimeout(inp_win, 0);
+		curs_set(1);
+		wrefresh(inp_win);
+	} else {
+		printf("%s", prompt);
+		fflush(stdout);
+	}
+}
+
+/*
+ * Returns 1 once a whole line is in buffer, as get_input() would leave it,
+ * 0 while there is not, and -1 with an empty line at the end of input.
+ */
+int
+input_poll(char *buffer, size_t size)
+{
+	struct pollfd	pfd = {STDIN_FILENO, POLLIN, 0};
+	int		ch;
+	char		c;
+
+	if (using_curses) {
+		while ((ch = wgetch(inp_win)) != ERR) {
+			if (ch == '\n' || ch == KEY_ENTER) {
+				buffer[input_len] = '\0';
+				return 1;
+			}
+			if ((ch == KEY_BACKSPACE || ch == 127 || ch == '\b') && input_len > 0) {
+				input_len--;
+				waddstr(inp_win, "\b \b");
+			} else if (ch >= ' ' && ch < 127 && input_len + 1 < size) {
+				buffer[input_len++] = (char)ch;
+				waddch(inp_win, ch);
+			}
+		}
+		wrefresh(inp_win);
+		return 0;
+	}
+
+	/* A byte at a time, so nothing past the line is taken from stdin */
+	while (poll(&pfd, 1, 0) == 1) {
+		if (read(STDIN_FILENO, &c, 1) != 1) {
+			buffer[0] = '\0';
+			return -1;
+		}
+		if (c == '\n' || input_len + 2 < size)
+			buffer[input_len++] = c;
+		if (c == '\n') {
+			buffer[input_len] = '\0';
+			return 1;
+		}
+	}
+	return 0;
+}
+
+void
+input_end(void)
+{
+	if (!using_curses)
+		return;
+	curs_set(0);
+	echo();
+	wtimeout(inp_win, -1);
+	werase(inp_win);
+	wrefresh(inp_win);
+}
+
+/* Seconds left to answer, at the end of the status line */
+void
+print_clock(int seconds)
+{
+	if (!using_curses)
+		return;
+	mvwprintw(stats_win, 0, COLS - 5, "%3ds", seconds);
+	wrefresh(stats_win);
+}
 
 
 void
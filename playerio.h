@@ -25,6 +25,10 @@ void		my_clear();
 void        print_stats_info(const game_state_type *state, const patient_type *patient);
 void		my_refresh();
 void		get_input(const char *prompt, char *buffer, size_t size);
+void		input_begin(const char *prompt);
+int		input_poll(char *buffer, size_t size);
+void		input_end(void);
+void		print_clock(int seconds);
 void		my_printf(const char *format,...);
 void		mv_printw(int row, int col, const char *format,...);
 void		my_putchar(char c);
@@ -0,0 +1,240 @@
+/*
+ * BSD Zero Clause License
+ *
+ * Copyright (c) 2025 David M Crumpton david.m.crumpton [at] gmail [dot] com
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * policy.c: the built in policies and the table that names them
+ *
+ */
+#include <err.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "buffy.h"
+#include "engine.h"
+#include "mcts.h"
+#include "policy.h"
+#include "simulate.h"
+#include "solver.h"
+#include "tables.h"
+
+struct optimal_policy {
+	struct policy	base;
+	const struct solver_table *table;
+};
+
+
+static void
+scripted_choose(struct policy * p, const game_state_type * state, const patient_type * pat, int fang_idx, int *tool_dip, int *tool_effort)
+{
+	(void)p;
+	sim_scripted_input(state, pat, fang_idx, tool_dip, tool_effort);
+}
+
+static void
+optimal_choose(struct policy * p, const game_state_type * state, const patient_type * pat, int fang_idx, int *tool_dip, int *tool_effort)
+{
+	solver_input(((struct optimal_policy *)p)->table, state, pat, fang_idx, tool_dip, tool_effort);
+}
+
+/*
+ * The hand written policies below all work at the tool's full effort and
+ * give up on a fang that not even the deepest dip can raise.
+ */
+static int
+stroke_gain(const game_state_type * state, int dip)
+{
+	return fang_health_gain(state, TBL_FLUORIDE_USED(state->tool_in_use, dip),
+				engine_live->tools[state->tool_in_use].effort);
+}
+
+/* The deepest dip every time */
+static void
+maxdip_choose(struct policy * p, const game_state_type * state, const patient_type * pat, int fang_idx, int *tool_dip, int *tool_effort)
+{
+	const tool     *t = &engine_live->tools[state->tool_in_use];
+
+	(void)pat;
+	(void)fang_idx;
+	*tool_dip = t->dip_amount;
+	*tool_effort = t->effort;
+	p->hopeless = stroke_gain(state, t->dip_amount) <= 0;
+}
+
+/*
+ * The dip that buys the most of the health the fang still needs per drop
+ * of fluoride, so a stroke that costs nothing comes first
+ */
+static void
+greedy_choose(struct policy * p, const game_state_type * state, const patient_type * pat, int fang_idx, int *tool_dip, int *tool_effort)
+{
+	const tool     *t = &engine_live->tools[state->tool_in_use];
+	int		need = MAX_HEALTH - pat->fangs[fang_idx].health;
+	double		best = 0;
+
+	*tool_dip = t->dip_amount;
+	*tool_effort = t->effort;
+	for (int dip = t->dip_amount; dip >= 0; dip--) {
+		int		gain = stroke_gain(state, dip);
+		int		used = TBL_FLUORIDE_USED(state->tool_in_use, dip);
+		double		worth;
+
+		if (gain <= 0)
+			continue;
+		worth = (gain < need ? gain : need) / (used > 0 ? (double)used : 0.5);
+		if (worth > best) {
+			best = worth;
+			*tool_dip = dip;
+		}
+	}
+	p->hopeless = best == 0;
+}
+
+/* The shallowest dip that does half of what the fang still needs */
+static void
+conservative_choose(struct policy * p, const game_state_type * state, const patient_type * pat, int fang_idx, int *tool_dip, int *tool_effort)
+{
+	const tool     *t = &engine_live->tools[state->tool_in_use];
+	int		half = (MAX_HEALTH - pat->fangs[fang_idx].health + 1) / 2;
+
+	*tool_effort = t->effort;
+	*tool_dip = t->dip_amount;
+	for (int dip = 0; dip <= t->dip_amount; dip++)
+		if (stroke_gain(state, dip) >= half) {
+			*tool_dip = dip;
+			break;
+		}
+	p->hopeless = stroke_gain(state, t->dip_amount) <= 0;
+}
+
+static void
+plain_free(struct policy * p)
+{
+	free(p);
+}
+
+static struct policy *
+plain_new(const char *name, void (*choose) (struct policy *, const game_state_type *, const patient_type *, int, int *, int *))
+{
+	struct policy  *p;
+
+	if ((p = calloc(1, sizeof(*p))) == NULL)
+		err(1, "policy");
+	p->name = name;
+	p->choose = choose;
+	p->free = plain_free;
+	return p;
+}
+
+static struct policy *
+scripted_new(const struct policy_config * cfg)
+{
+	(void)cfg;
+	return plain_new("scripted", scripted_choose);
+}
+
+static struct policy *
+greedy_new(const struct policy_config * cfg)
+{
+	(void)cfg;
+	return plain_new("greedy", greedy_choose);
+}
+
+static struct policy *
+conservative_new(const struct policy_config * cfg)
+{
+	(void)cfg;
+	return plain_new("conservative", conservative_choose);
+}
+
+static struct policy *
+maxdip_new(const struct policy_config * cfg)
+{
+	(void)cfg;
+	return plain_new("maxdip", maxdip_choose);
+}
+
+static struct policy *
+optimal_new(const struct policy_config * cfg)
+{
+	struct optimal_policy *p;
+
+	if (cfg->table == NULL)
+		errx(1, "the optimal policy needs a table from --optimal");
+	if ((p = calloc(1, sizeof(*p))) == NULL)
+		err(1, "policy");
+	p->base.name = "optimal";
+	p->base.choose = optimal_choose;
+	p->base.free = plain_free;
+	p->table = cfg->table;
+	return &p->base;
+}
+
+static const struct {
+	const char     *name;
+	struct policy  *(*new) (const struct policy_config * cfg);
+}		policies[] = {
+	{"scripted", scripted_new},
+	{"optimal", optimal_new},
+	{"mcts", mcts_policy_new},
+	{"greedy", greedy_new},
+	{"conservative", conservative_new},
+	{"maxdip", maxdip_new},
+};
+
+int
+policy_known(const char *name)
+{
+	for (size_t i = 0; i < sizeof(policies) / sizeof(policies[0]); i++)
+		if (strcmp(name, policies[i].name) == 0)
+			return 1;
+	return 0;
+}
+
+struct policy  *
+policy_new(const struct policy_config * cfg)
+{
+	for (size_t i = 0; i < sizeof(policies) / sizeof(policies[0]); i++)
+		if (strcmp(cfg->name, policies[i].name) == 0)
+			return policies[i].new(cfg);
+	errx(1, "unknown policy %s", cfg->name);
+}
+
+void
+policy_free(struct policy * p)
+{
+	if (p != NULL)
+		p->free(p);
+}
+
+void
+policy_merge_stats(struct policy_stats * into, const struct policy_stats * from)
+{
+	into->moves += from->moves;
+	into->iterations += from->iterations;
+	into->total_us += from->total_us;
+	if (from->max_us > into->max_us)
+		into->max_us = from->max_us;
+}
+
+void
+policy_print_stats(const struct policy_stats * s, FILE * out)
+{
+	if (s->moves == 0)
+		return;
+	fprintf(out, "  Moves searched: %ld, %.0f iterations and %.1f us each on average, slowest %.1f us\n",
+		s->moves, (double)s->iterations / s->moves, s->total_us / s->moves, s->max_us);
+}
@@ -0,0 +1,83 @@
+/*
+ * BSD Zero Clause License
+ *
+ * Copyright (c) 2025 David M Crumpton david.m.crumpton [at] gmail [dot] com
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * policy.h: who decides the dip and effort for a fang. The interactive game
+ * asks the player unless a policy is chosen; the simulators always play
+ * one.
+ *
+ */
+
+#ifndef POLICY_H
+#define POLICY_H
+
+#include <stdio.h>
+
+#include "buffy.h"
+
+struct solver_table;
+
+/* Kept by policies that search, so their latency can be reported */
+struct policy_stats {
+	long		moves;
+	long		iterations;
+	double		total_us;
+	double		max_us;	/* slowest single move */
+};
+
+/*
+ * A policy instance is used by one thread at a time. new_game is called
+ * before the first move of every game and may be NULL.
+ */
+struct policy {
+	const char     *name;
+	void		(*choose) (struct policy * p, const game_state_type * state, const patient_type * pat, int fang_idx, int *tool_dip, int *tool_effort);
+	void		(*new_game) (struct policy * p);
+	void		(*free) (struct policy * p);
+	int		hopeless;	/* set once no stroke can raise a fang */
+	struct policy_stats stats;
+};
+
+/* Enough to build a fresh instance per simulator worker */
+struct policy_config {
+	const char     *name;	/* scripted, optimal, mcts, greedy, ... */
+	const struct solver_table *table;	/* optimal */
+	long		budget_us;	/* mcts: wall clock per move */
+	long		nodes;	/* mcts: search iterations per move */
+};
+
+int		policy_known(const char *name);
+struct policy  *policy_new(const struct policy_config * cfg);
+void		policy_free(struct policy * p);
+void		policy_merge_stats(struct policy_stats * into, const struct policy_stats * from);
+void		policy_print_stats(const struct policy_stats * s, FILE * out);
+
+static inline void
+policy_choose(struct policy * p, const game_state_type * state, const patient_type * pat, int fang_idx, int *tool_dip, int *tool_effort)
+{
+	p->choose(p, state, pat, fang_idx, tool_dip, tool_effort);
+}
+
+static inline void
+policy_new_game(struct policy * p)
+{
+	p->hopeless = 0;
+	if (p->new_game != NULL)
+		p->new_game(p);
+}
+
+#endif				/* POLICY_H */
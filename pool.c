@@ -0,0 +1,173 @@
+/*
+ * BSD Zero Clause License
+ *
+ * Copyright (c) 2025 David M Crumpton david.m.crumpton [at] gmail [dot] com
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * pool.c: work stealing over chunk ranges. Every worker owns a range of
+ * chunk numbers packed into one 64 bit word (first chunk in the high half,
+ * end in the low half). The owner takes chunks off the front; an idle
+ * worker steals the back half of somebody else's range with a single
+ * compare and swap, so no locks are taken while games are running.
+ *
+ */
+#include <err.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "pool.h"
+
+#define MAX_CHUNKS	0xffffffffULL
+
+struct pool_range {
+	_Alignas(CACHE_LINE) _Atomic uint64_t span;
+};
+
+struct pool {
+	struct pool_range *ranges;
+	int		nworkers;
+	uint64_t	nitems;
+	uint64_t	chunk;
+	pool_task_fn	fn;
+	void	       *arg;
+};
+
+struct pool_worker {
+	struct pool    *pool;
+	int		id;
+	pthread_t	thread;
+};
+
+#define SPAN(lo, hi)	(((uint64_t)(lo) << 32) | (uint64_t)(hi))
+#define SPAN_LO(s)	((uint32_t)((s) >> 32))
+#define SPAN_HI(s)	((uint32_t)(s))
+
+int
+pool_default_threads(void)
+{
+	long		n = sysconf(_SC_NPROCESSORS_ONLN);
+
+	return n > 0 ? (int)n : 1;
+}
+
+static int
+take_own(struct pool_range * r, uint32_t * chunk)
+{
+	uint64_t	s = atomic_load_explicit(&r->span, memory_order_relaxed);
+
+	while (SPAN_LO(s) < SPAN_HI(s)) {
+		if (atomic_compare_exchange_weak(&r->span, &s, SPAN(SPAN_LO(s) + 1, SPAN_HI(s)))) {
+			*chunk = SPAN_LO(s);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Only called once the thief's own range is empty. Nobody else writes an
+ * empty range, so the stolen half can simply be stored there.
+ */
+static int
+steal(struct pool * p, int thief)
+{
+	for (int k = 1; k < p->nworkers; k++) {
+		struct pool_range *victim = &p->ranges[(thief + k) % p->nworkers];
+		uint64_t	s = atomic_load_explicit(&victim->span, memory_order_relaxed);
+
+		while (SPAN_LO(s) < SPAN_HI(s)) {
+			uint32_t	half = (SPAN_HI(s) - SPAN_LO(s) + 1) / 2;
+			uint32_t	mid = SPAN_HI(s) - half;
+
+			if (atomic_compare_exchange_weak(&victim->span, &s, SPAN(SPAN_LO(s), mid))) {
+				atomic_store(&p->ranges[thief].span, SPAN(mid, SPAN_HI(s)));
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
+
+static void    *
+worker_main(void *arg)
+{
+	struct pool_worker *w = arg;
+	struct pool    *p = w->pool;
+	uint32_t	c;
+
+	do {
+		while (take_own(&p->ranges[w->id], &c)) {
+			uint64_t	lo = (uint64_t)c * p->chunk;
+			uint64_t	hi = lo + p->chunk;
+
+			if (hi > p->nitems)
+				hi = p->nitems;
+			p->fn(p->arg, w->id, lo, hi);
+		}
+	} while (steal(p, w->id));
+
+	return NULL;
+}
+
+/*
+ * Run fn over items 0..nitems-1 on nthreads workers, the calling thread
+ * being worker 0. Returns once every item has been handed out and
+ * finished.
+ */
+int
+pool_run(int nthreads, uint64_t nitems, uint64_t chunk, pool_task_fn fn, void *arg)
+{
+	struct pool	p;
+	struct pool_worker *workers;
+	uint64_t	nchunks;
+
+	if (nthreads < 1)
+		nthreads = 1;
+	if (chunk < 1)
+		chunk = 1;
+	while ((nchunks = (nitems + chunk - 1) / chunk) > MAX_CHUNKS)
+		chunk *= 2;
+	if ((uint64_t)nthreads > nchunks)
+		nthreads = nchunks > 0 ? (int)nchunks : 1;
+
+	p.nworkers = nthreads;
+	p.nitems = nitems;
+	p.chunk = chunk;
+	p.fn = fn;
+	p.arg = arg;
+	if ((p.ranges = aligned_alloc(CACHE_LINE, sizeof(*p.ranges) * nthreads)) == NULL)
+		err(1, "pool ranges");
+	if ((workers = calloc(nthreads, sizeof(*workers))) == NULL)
+		err(1, "pool workers");
+
+	for (int i = 0; i < nthreads; i++)
+		atomic_init(&p.ranges[i].span, SPAN(nchunks * i / nthreads, nchunks * (i + 1) / nthreads));
+
+	for (int i = 0; i < nthreads; i++) {
+		workers[i].pool = &p;
+		workers[i].id = i;
+		if (i > 0 && pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]) != 0)
+			errx(1, "unable to start worker thread %d", i);
+	}
+	worker_main(&workers[0]);
+	for (int i = 1; i < nthreads; i++)
+		pthread_join(workers[i].thread, NULL);
+
+	free(workers);
+	free(p.ranges);
+	return 0;
+}
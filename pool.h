@@ -0,0 +1,41 @@
+/*
+ * BSD Zero Clause License
+ *
+ * Copyright (c) 2025 David M Crumpton david.m.crumpton [at] gmail [dot] com
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * pool.h: a pool of worker threads that split a range of independent items
+ * between them and steal from each other when their own share runs dry
+ *
+ */
+
+#ifndef POOL_H
+#define POOL_H
+
+#include <stdint.h>
+
+#define CACHE_LINE	64
+
+/*
+ * Called with a contiguous run of items [lo, hi). worker is 0..nthreads-1
+ * and stays the same for every call made on one thread, so per worker
+ * state can be indexed by it without locking.
+ */
+typedef void	(*pool_task_fn) (void *arg, int worker, uint64_t lo, uint64_t hi);
+
+int		pool_default_threads(void);
+int		pool_run(int nthreads, uint64_t nitems, uint64_t chunk, pool_task_fn fn, void *arg);
+
+#endif				/* POOL_H */
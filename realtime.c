@@ -0,0 +1,152 @@
+/*
+ * BSD Zero Clause License
+ *
+ * Copyright (c) 2025 David M Crumpton david.m.crumpton [at] gmail [dot] com
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * realtime.c: real time play. Every timer, the patient's patience, the
+ * prompt's time limit and the clock on screen, hangs off one timing wheel
+ * whose ticks are run from the prompt's poll loop, so nothing sleeps and
+ * input is read as it arrives.
+ *
+ */
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <err.h>
+
+#include "buffy.h"
+#include "libbuffy.h"
+#include "playerio.h"
+#include "realtime.h"
+#include "sketch.h"
+#include "wheel.h"
+
+#define MS	1000000ULL
+
+
+static void
+on_patience(void *arg)
+{
+	struct realtime *rt = arg;
+
+	if (rt->ctx->pat.patience == 0)
+		return;
+	buffy_fidget(rt->ctx);
+	rt->fidgets++;
+	if (rt->ctx->state.using_curses)
+		print_stats_info(&rt->ctx->state, &rt->ctx->pat);
+}
+
+static void
+on_prompt(void *arg)
+{
+	struct realtime *rt = arg;
+
+	rt->timed_out = 1;
+}
+
+static void
+on_frame(void *arg)
+{
+	struct realtime *rt = arg;
+	uint64_t	now = wheel_clock();
+
+	print_clock(rt->deadline > now ? (int)((rt->deadline - now + 999 * MS) / (1000 * MS)) : 0);
+}
+
+void
+rt_start(struct realtime * rt, int tick_ms, struct buffy_ctx * ctx)
+{
+	wheel_init(&rt->wheel, (uint64_t)tick_ms * MS);
+	rt->ctx = ctx;
+	rt->deadline = 0;
+	rt->timed_out = 0;
+	rt->prompts = rt->timeouts = rt->fidgets = 0;
+	rt->prompt.next = rt->frame.next = NULL;
+	wheel_add(&rt->wheel, &rt->patience, RT_PATIENCE_MS * MS, RT_PATIENCE_MS * MS, on_patience, rt);
+}
+
+/*
+ * get_input() on the clock. Runs the wheel until a line comes in or the
+ * prompt's time is up, which leaves an empty line for the default.
+ * Returns 1 when the prompt timed out.
+ */
+int
+rt_get_input(struct realtime * rt, const char *prompt, char *buffer, size_t size)
+{
+	struct pollfd	pfd = {STDIN_FILENO, POLLIN, 0};
+	int		got = 0;
+
+	wheel_run(&rt->wheel, wheel_clock());
+	rt->timed_out = 0;
+	rt->deadline = wheel_clock() + RT_PROMPT_MS * MS;
+	rt->prompts++;
+	wheel_add(&rt->wheel, &rt->prompt, RT_PROMPT_MS * MS, 0, on_prompt, rt);
+	if (rt->ctx->state.using_curses)
+		wheel_add(&rt->wheel, &rt->frame, 0, RT_FRAME_MS * MS, on_frame, rt);
+	input_begin(prompt);
+
+	while (got == 0 && !rt->timed_out) {
+		uint64_t	now = wheel_clock(), next = wheel_next(&rt->wheel);
+		int		ms = next > now ? (int)((next - now + MS - 1) / MS) : 0;
+
+		if (poll(&pfd, 1, ms) == -1 && errno != EINTR)
+			err(1, "poll");
+		if ((got = input_poll(buffer, size)) != 0)
+			break;
+		wheel_run(&rt->wheel, wheel_clock());
+	}
+
+	wheel_cancel(&rt->wheel, &rt->prompt);
+	wheel_cancel(&rt->wheel, &rt->frame);
+	input_end();
+	if (got == 1)
+		return 0;
+	/* What get_input() leaves for a bare return */
+	strlcpy(buffer, rt->ctx->state.using_curses ? "" : "\n", size);
+	if (rt->timed_out) {
+		rt->timeouts++;
+		my_print_err("%sTime is up; the hygienist goes with the default.\n",
+			     rt->ctx->state.using_curses ? "" : "\n");
+	}
+	return rt->timed_out;
+}
+
+void
+rt_stop(struct realtime * rt)
+{
+	wheel_cancel(&rt->wheel, &rt->patience);
+	wheel_cancel(&rt->wheel, &rt->prompt);
+	wheel_cancel(&rt->wheel, &rt->frame);
+}
+
+void
+rt_report(const struct realtime * rt)
+{
+	const struct wheel *w = &rt->wheel;
+
+	my_printf("Real time: %llu ticks of %.3g ms, %llu timers fired, %ld of %ld prompts timed out, "
+		  "%ld point%s of patience lost waiting\n",
+		  (unsigned long long)w->tick, w->tick_ns / 1e6, (unsigned long long)w->fired,
+		  rt->timeouts, rt->prompts, rt->fidgets, rt->fidgets == 1 ? "" : "s");
+	if (w->tick == 0)
+		return;
+	my_printf("Tick latency: p50 %.1f us, p99 %.1f us, max %.1f us; wheel work %.2f us per tick\n",
+		  sketch_quantile(&w->late, 0.5) / 1e3, sketch_quantile(&w->late, 0.99) / 1e3,
+		  sketch_quantile(&w->late, 1.0) / 1e3, (double)w->work_ns / w->tick / 1e3);
+}
@@ -0,0 +1,56 @@
+/*
+ * BSD Zero Clause License
+ *
+ * Copyright (c) 2025 David M Crumpton david.m.crumpton [at] gmail [dot] com
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * realtime.h: real time play, where the patient's patience runs down on
+ * the clock and a prompt left too long takes its default
+ *
+ */
+
+#ifndef REALTIME_H
+#define REALTIME_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "libbuffy.h"
+#include "wheel.h"
+
+#define RT_TICK_MS	10	/* --tick default */
+#define RT_PATIENCE_MS	4000	/* a point of patience lost per */
+#define RT_PROMPT_MS	15000	/* to answer a prompt */
+#define RT_FRAME_MS	100	/* between redraws of the clock */
+
+struct realtime {
+	struct wheel	wheel;
+	struct wheel_timer patience;
+	struct wheel_timer prompt;
+	struct wheel_timer frame;
+	struct buffy_ctx *ctx;
+	uint64_t	deadline;	/* of the prompt, on wheel_clock() */
+	int		timed_out;
+	long		prompts;
+	long		timeouts;
+	long		fidgets;
+};
+
+void		rt_start(struct realtime * rt, int tick_ms, struct buffy_ctx * ctx);
+int		rt_get_input(struct realtime * rt, const char *prompt, char *buffer, size_t size);
+void		rt_stop(struct realtime * rt);
+void		rt_report(const struct realtime * rt);
+
+#endif				/* REALTIME_H */
@@ -0,0 +1,308 @@
+/*
+ * BSD Zero Clause License
+ *
+ * Copyright (c) 2025 David M Crumpton david.m.crumpton [at] gmail [dot] com
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * replay.c: records the seed and every answer of an interactive game, and
+ * plays recordings back through the engine without curses, prompts or
+ * sleeps, checking the state after every stroke against the recording.
+ *
+ */
+#include <sys/stat.h>
+
+#include <err.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "buffy.h"
+#include "engine.h"
+#include "libbuffy.h"
+#include "replay.h"
+#include "solver.h"
+
+struct cursor {
+	const uint8_t  *p;
+	const uint8_t  *end;
+};
+
+
+static void
+put_le(FILE * fp, uint64_t v, int bytes)
+{
+	for (int i = 0; i < bytes; i++)
+		putc((int)(v >> (8 * i)) & 0xff, fp);
+}
+
+/* Seven bits a byte, low first; dips and efforts take one byte */
+static void
+put_varint(FILE * fp, uint32_t v)
+{
+	while (v >= 0x80) {
+		putc((int)(v & 0x7f) | 0x80, fp);
+		v >>= 7;
+	}
+	putc((int)v, fp);
+}
+
+static int
+get_le(struct cursor * c, uint64_t * v, int bytes)
+{
+	if (c->end - c->p < bytes)
+		return -1;
+	*v = 0;
+	for (int i = 0; i < bytes; i++)
+		*v |= (uint64_t)c->p[i] << (8 * i);
+	c->p += bytes;
+	return 0;
+}
+
+static int
+get_varint(struct cursor * c, uint32_t * v)
+{
+	*v = 0;
+	for (int shift = 0; shift < 35; shift += 7) {
+		if (c->p == c->end)
+			return -1;
+		*v |= (uint32_t)(*c->p & 0x7f) << shift;
+		if ((*c->p++ & 0x80) == 0)
+			return 0;
+	}
+	return -1;
+}
+
+struct replay_writer *
+replay_writer_open(const char *path, uint64_t seed, int daggerset)
+{
+	struct replay_writer *w;
+
+	if ((w = calloc(1, sizeof(*w))) == NULL)
+		err(1, "replay");
+	if ((w->fp = fopen(path, "wb")) == NULL) {
+		warn("%s", path);
+		free(w);
+		return NULL;
+	}
+	put_le(w->fp, REPLAY_MAGIC, 4);
+	put_le(w->fp, REPLAY_VERSION, 1);
+	put_le(w->fp, daggerset ? REPLAY_DAGGERSET : 0, 1);
+	put_le(w->fp, 0, 2);
+	put_le(w->fp, solver_balance_fingerprint(), 4);
+	put_le(w->fp, seed, 8);
+	return w;
+}
+
+/* All of these accept a NULL writer so the game can call them unguarded */
+void
+replay_record_stroke(struct replay_writer * w, int tool_dip, int tool_effort, uint16_t checksum)
+{
+	if (w == NULL)
+		return;
+	put_varint(w->fp, (uint32_t)tool_dip);
+	put_varint(w->fp, (uint32_t)tool_effort);
+	put_le(w->fp, checksum, 2);
+}
+
+void
+replay_record_answer(struct replay_writer * w, enum engine_choice choice)
+{
+	if (w == NULL)
+		return;
+	put_le(w->fp, choice, 1);
+}
+
+void
+replay_record_end(struct replay_writer * w, enum replay_outcome outcome, const game_state_type * state)
+{
+	if (w == NULL)
+		return;
+	put_le(w->fp, outcome, 1);
+	put_le(w->fp, (uint32_t)state->score, 4);
+	fflush(w->fp);
+}
+
+void
+replay_writer_close(struct replay_writer * w)
+{
+	if (w == NULL)
+		return;
+	if (fclose(w->fp) == EOF)
+		warn("replay");
+	free(w);
+}
+
+static int
+replay_fail(struct replay_result * res, const char *why)
+{
+	snprintf(res->error, sizeof(res->error), "%s after %ld stroke%s", why,
+		 res->strokes, res->strokes == 1 ? "" : "s");
+	return -1;
+}
+
+/*
+ * Play a recording held in memory through the same engine steps as
+ * apply_fluoride_to_fangs().
+ * Returns 0 when every checksum and the trailer match, including for a
+ * recording cut short (res->incomplete), and -1 with res->error set
+ * otherwise.
+ */
+int
+replay_verify(const uint8_t * buf, size_t len, struct replay_result * res)
+{
+	struct cursor	c = {buf, buf + len};
+	struct buffy_ctx ctx;
+	struct buffy_event ev[BUFFY_MAX_EVENTS];
+	struct buffy_input in = {0, 0, ENGINE_CONTINUE};
+	uint64_t	magic, version, flags, reserved, balance, seed, v, want = 0;
+	uint32_t	dip, effort;
+	int		outcome;
+
+	memset(res, 0, sizeof(*res));
+	if (get_le(&c, &magic, 4) == -1 || magic != REPLAY_MAGIC ||
+	    get_le(&c, &version, 1) == -1 || version != REPLAY_VERSION ||
+	    get_le(&c, &flags, 1) == -1 || get_le(&c, &reserved, 2) == -1 ||
+	    get_le(&c, &balance, 4) == -1 || get_le(&c, &seed, 8) == -1)
+		return replay_fail(res, "not a replay");
+	if (balance != solver_balance_fingerprint())
+		return replay_fail(res, "recorded with a different balance");
+
+	/* Deal exactly as main_program() does for a fresh game */
+	buffy_new_game(&ctx, seed, 0, (flags & REPLAY_DAGGERSET) != 0);
+
+	while (ctx.need != BUFFY_NEED_NONE) {
+		int		n = buffy_step(&ctx, &in, ev);
+
+		for (int k = 0; k < n; k++)
+			switch (ev[k].type) {
+			case BUFFY_EV_ASK_STROKE:
+				if (get_varint(&c, &dip) == -1 || get_varint(&c, &effort) == -1 ||
+				    get_le(&c, &want, 2) == -1) {
+					res->incomplete = 1;
+					return 0;
+				}
+				in.dip = (int)dip;
+				in.effort = (int)effort;
+				break;
+			case BUFFY_EV_STROKE:
+				if (ev[k].checksum != want)
+					return replay_fail(res, "state checksum differs");
+				res->strokes++;
+				break;
+			case BUFFY_EV_ROUND:
+				res->rounds++;
+				break;
+			case BUFFY_EV_ASK_ANSWER:
+				if (get_le(&c, &v, 1) == -1) {
+					res->incomplete = 1;
+					return 0;
+				}
+				if (v > ENGINE_STOP)
+					return replay_fail(res, "bad continue answer");
+				in.answer = (enum engine_choice)v;
+				break;
+			default:
+				break;
+			}
+	}
+	outcome = ctx.outcome;
+	res->outcome = outcome;
+	res->score = ctx.state.score;
+
+	if (get_le(&c, &v, 1) == -1) {
+		res->incomplete = 1;
+		return 0;
+	}
+	if ((int)v != outcome)
+		return replay_fail(res, "outcome differs");
+	if (get_le(&c, &v, 4) == -1 || (int)v != ctx.state.score)
+		return replay_fail(res, "final score differs");
+	if (c.p != c.end)
+		return replay_fail(res, "trailing bytes");
+	return 0;
+}
+
+int
+replay_file(const char *path, struct replay_result * res)
+{
+	FILE	       *fp;
+	struct stat	st;
+	uint8_t	       *buf;
+	size_t		len;
+	int		rv;
+
+	memset(res, 0, sizeof(*res));
+	if ((fp = fopen(path, "rb")) == NULL) {
+		snprintf(res->error, sizeof(res->error), "%s", strerror(errno));
+		return -1;
+	}
+	if (fstat(fileno(fp), &st) == -1) {
+		snprintf(res->error, sizeof(res->error), "%s", strerror(errno));
+		fclose(fp);
+		return -1;
+	}
+	/* A long game recorded by a policy may run to many kilobytes */
+	if ((buf = malloc(st.st_size > 0 ? (size_t)st.st_size : 1)) == NULL)
+		err(1, "replay");
+	len = fread(buf, 1, (size_t)st.st_size, fp);
+	if (ferror(fp) || len != (size_t)st.st_size) {
+		snprintf(res->error, sizeof(res->error), "unreadable");
+		rv = -1;
+	} else
+		rv = replay_verify(buf, len, res);
+	free(buf);
+	fclose(fp);
+	return rv;
+}
+
+static const char *outcome_names[] = {"win", "out of fluoride", "quit", "saved"};
+
+/*
+ * Check every recording and print a line for each that fails or stops
+ * early, then a summary. Returns the number that failed.
+ */
+int
+replay_files(char *const paths[], int npaths)
+{
+	struct replay_result res;
+	struct timespec	start, end;
+	long		strokes = 0;
+	int		failed = 0, incomplete = 0;
+	double		elapsed;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int i = 0; i < npaths; i++) {
+		if (replay_file(paths[i], &res) == -1) {
+			printf("%s: FAILED: %s\n", paths[i], res.error);
+			failed++;
+		} else if (res.incomplete) {
+			printf("%s: incomplete, %ld strokes match\n", paths[i], res.strokes);
+			incomplete++;
+		} else if (npaths == 1) {
+			printf("%s: ok, %s with %d points after %ld strokes in %ld rounds\n",
+			       paths[i], outcome_names[res.outcome], res.score, res.strokes, res.rounds);
+		}
+		strokes += res.strokes;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+	printf("Replayed %d game%s (%ld strokes) in %.3f s (%.0f games/s): %d failed, %d incomplete\n",
+	       npaths, npaths == 1 ? "" : "s", strokes, elapsed,
+	       elapsed > 0 ? npaths / elapsed : 0.0, failed, incomplete);
+	return failed;
+}
@@ -0,0 +1,76 @@
+/*
+ * BSD Zero Clause License
+ *
+ * Copyright (c) 2025 David M Crumpton david.m.crumpton [at] gmail [dot] com
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * replay.h: compact binary recordings of interactive games and a headless
+ * replayer that checks them against the engine
+ *
+ */
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "buffy.h"
+#include "engine.h"
+
+#define REPLAY_MAGIC	0x50524642	/* "BFRP" */
+#define REPLAY_VERSION	2
+#define REPLAY_HEADER	20	/* bytes before the first stroke */
+
+#define REPLAY_DAGGERSET 0x01	/* header flag */
+
+/* How a recorded game ended */
+enum replay_outcome {
+	REPLAY_WIN,
+	REPLAY_NO_FLUORIDE,
+	REPLAY_QUIT,
+	REPLAY_SAVE
+};
+
+/*
+ * After the header every stroke is the dip and effort as varints and a 16
+ * bit checksum of the state it left behind; every round that does not end
+ * the game is followed by the continue answer as one byte. The trailer is
+ * the outcome byte and the final score.
+ */
+struct replay_writer {
+	FILE	       *fp;
+};
+
+struct replay_result {
+	long		strokes;
+	long		rounds;
+	int		outcome;
+	int		score;
+	int		incomplete;	/* the recording stops before the game */
+	char		error[128];	/* why verification failed */
+};
+
+struct replay_writer *replay_writer_open(const char *path, uint64_t seed, int daggerset);
+void		replay_record_stroke(struct replay_writer * w, int tool_dip, int tool_effort, uint16_t checksum);
+void		replay_record_answer(struct replay_writer * w, enum engine_choice choice);
+void		replay_record_end(struct replay_writer * w, enum replay_outcome outcome, const game_state_type * state);
+void		replay_writer_close(struct replay_writer * w);
+int		replay_verify(const uint8_t * buf, size_t len, struct replay_result * res);
+int		replay_file(const char *path, struct replay_result * res);
+int		replay_files(char *const paths[], int npaths);
+
+#endif				/* REPLAY_H */
@@ -0,0 +1,219 @@
+/*
+ * BSD Zero Clause License
+ *
+ * Copyright (c) 2025 David M Crumpton david.m.crumpton [at] gmail [dot] com
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * rng.c: Philox4x32-10 streams. Every random draw in the game goes through
+ * rng_uniform() or rng_word(), which read the stream the calling thread
+ * installed or, when there is none, the process stream for the run's seed.
+ * The seed is either given with --seed or taken once from arc4random, so
+ * the same seed deals the same games.
+ *
+ */
+#include <ctype.h>
+#include <errno.h>
+#include <stdlib.h>
+
+#include "rng.h"
+
+#define PHILOX_M0	0xD2511F53U
+#define PHILOX_M1	0xCD9E8D57U
+#define PHILOX_W0	0x9E3779B9U
+#define PHILOX_W1	0xBB67AE85U
+#define PHILOX_ROUNDS	10
+
+
+static _Thread_local struct rng *current_stream = NULL;
+static struct rng process_stream;
+static uint64_t	process_seed;
+static int	seeded = 0;
+
+/* One block: ten rounds of two 32x32->64 multiplies and a key bump */
+void
+rng_philox(const uint32_t ctr[4], const uint32_t key[2], uint32_t out[4])
+{
+	uint32_t	c0 = ctr[0], c1 = ctr[1], c2 = ctr[2], c3 = ctr[3];
+	uint32_t	k0 = key[0], k1 = key[1];
+
+	for (int i = 0; i < PHILOX_ROUNDS; i++) {
+		uint64_t	p0 = (uint64_t)PHILOX_M0 * c0;
+		uint64_t	p1 = (uint64_t)PHILOX_M1 * c2;
+
+		c0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+		c1 = (uint32_t)p1;
+		c2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+		c3 = (uint32_t)p0;
+		k0 += PHILOX_W0;
+		k1 += PHILOX_W1;
+	}
+	out[0] = c0;
+	out[1] = c1;
+	out[2] = c2;
+	out[3] = c3;
+}
+
+static inline void
+rng_advance(struct rng * r, uint64_t blocks)
+{
+	uint64_t	block = ((uint64_t)r->ctr[1] << 32 | r->ctr[0]) + blocks;
+
+	r->ctr[0] = (uint32_t)block;
+	r->ctr[1] = (uint32_t)(block >> 32);
+}
+
+void
+rng_seed(struct rng * r, uint64_t seed, uint64_t stream)
+{
+	r->key[0] = (uint32_t)seed;
+	r->key[1] = (uint32_t)(seed >> 32);
+	r->ctr[0] = r->ctr[1] = 0;
+	r->ctr[2] = (uint32_t)stream;
+	r->ctr[3] = (uint32_t)(stream >> 32);
+	r->pos = 4;
+}
+
+/* Skip the next blocks * 4 draws without generating them */
+void
+rng_jump(struct rng * r, uint64_t blocks)
+{
+	rng_advance(r, blocks);
+	r->pos = 4;
+}
+
+uint32_t
+rng_next(struct rng * r)
+{
+	if (r->pos == 4) {
+		rng_philox(r->ctr, r->key, r->out);
+		rng_advance(r, 1);
+		r->pos = 0;
+	}
+	return r->out[r->pos++];
+}
+
+/* The same words n calls to rng_next() would return, a block at a time */
+void
+rng_fill(struct rng * r, uint32_t * buf, size_t n)
+{
+	while (n > 0 && r->pos < 4) {
+		*buf++ = r->out[r->pos++];
+		n--;
+	}
+	for (; n >= 4; n -= 4, buf += 4) {
+		rng_philox(r->ctr, r->key, buf);
+		rng_advance(r, 1);
+	}
+	while (n-- > 0)
+		*buf++ = rng_next(r);
+}
+
+/* Lemire's multiply and shift, rejecting the biased low products */
+uint32_t
+rng_uniform_r(struct rng * r, uint32_t upper_bound)
+{
+	uint64_t	m = (uint64_t)rng_next(r) * upper_bound;
+	uint32_t	low = (uint32_t)m;
+
+	if (low < upper_bound) {
+		uint32_t	threshold = -upper_bound % upper_bound;
+
+		while (low < threshold) {
+			m = (uint64_t)rng_next(r) * upper_bound;
+			low = (uint32_t)m;
+		}
+	}
+	return (uint32_t)(m >> 32);
+}
+
+/* Seed the run. The interactive game draws from stream 0 of this seed. */
+void
+rng_set_seed(uint64_t seed)
+{
+	process_seed = seed;
+	rng_seed(&process_stream, seed, 0);
+	seeded = 1;
+}
+
+uint64_t
+rng_get_seed(void)
+{
+	if (!seeded)
+		rng_set_seed(((uint64_t)arc4random() << 32) | arc4random());
+	return process_seed;
+}
+
+/*
+ * Accepts decimal, leading zeros and all, or hex with a 0x prefix.
+ * Returns -1 on junk.
+ */
+int
+rng_parse_seed(const char *s, uint64_t * seed)
+{
+	const char     *digits = s;
+	char	       *end;
+	int		base = 10;
+
+	if (s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) {
+		digits = s + 2;
+		base = 16;
+	}
+	/* strtoull() would also take a sign or leading spaces */
+	if (!isxdigit((unsigned char)*digits))
+		return -1;
+	errno = 0;
+	*seed = strtoull(digits, &end, base);
+	if (end == digits || *end != '\0' || errno != 0)
+		return -1;
+	return 0;
+}
+
+/*
+ * Draw rng_uniform() from r on this thread, or from the process stream
+ * when r is NULL. Returns the stream it replaces so a caller can put it
+ * back.
+ */
+struct rng     *
+rng_set_stream(struct rng * r)
+{
+	struct rng     *was = current_stream;
+
+	current_stream = r;
+	return was;
+}
+
+static inline struct rng *
+stream(void)
+{
+	if (current_stream == NULL) {
+		if (!seeded)
+			rng_get_seed();
+		return &process_stream;
+	}
+	return current_stream;
+}
+
+uint32_t
+rng_uniform(uint32_t upper_bound)
+{
+	return rng_uniform_r(stream(), upper_bound);
+}
+
+/* A raw word from the same stream, for draws that never reject */
+uint32_t
+rng_word(void)
+{
+	return rng_next(stream());
+}
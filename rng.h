@@ -0,0 +1,55 @@
+/*
+ * BSD Zero Clause License
+ *
+ * Copyright (c) 2025 David M Crumpton david.m.crumpton [at] gmail [dot] com
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * rng.h: seedable counter based random streams shared by the game and the
+ * simulators
+ *
+ */
+
+#ifndef RNG_H
+#define RNG_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * A Philox4x32-10 stream. The key is the seed and the high half of the
+ * counter is the stream number, so every (seed, stream) pair is its own
+ * sequence and any point in it can be reached by moving the block counter.
+ */
+struct rng {
+	uint32_t	key[2];
+	uint32_t	ctr[4];	/* block counter low, stream high */
+	uint32_t	out[4];	/* the current block */
+	unsigned	pos;	/* next unused word of out */
+};
+
+void		rng_philox(const uint32_t ctr[4], const uint32_t key[2], uint32_t out[4]);
+void		rng_seed(struct rng * r, uint64_t seed, uint64_t stream);
+void		rng_jump(struct rng * r, uint64_t blocks);
+uint32_t	rng_next(struct rng * r);
+void		rng_fill(struct rng * r, uint32_t * buf, size_t n);
+uint32_t	rng_uniform_r(struct rng * r, uint32_t upper_bound);
+void		rng_set_seed(uint64_t seed);
+uint64_t	rng_get_seed(void);
+int		rng_parse_seed(const char *s, uint64_t * seed);
+struct rng     *rng_set_stream(struct rng * r);
+uint32_t	rng_uniform(uint32_t upper_bound);
+uint32_t	rng_word(void);
+
+#endif				/* RNG_H */
@@ -0,0 +1,466 @@
+/*
+ * BSD Zero Clause License
+ *
+ * Copyright (c) 2025 David M Crumpton david.m.crumpton [at] gmail [dot] com
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * roster.c: loading a roster. The file is read once into an anonymous
+ * mapping with room for as many entries as it could hold, cut into fields
+ * where it lies, and the entries and indexes are built after it in the
+ * same mapping before it is made read only. Every index is a counting sort
+ * or a single pass, so a roster of a hundred thousand lines loads in a few
+ * milliseconds.
+ *
+ * A line is tab separated, one of
+ *
+ *	patient	name	species	age	patience	pain tolerance	difficulty
+ *	tool	name	length	dip	effort	effectiveness	durability	pain	dagger	description
+ *
+ * and blank lines and lines starting with # are skipped.
+ */
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <err.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "buffy.h"
+#include "engine.h"
+#include "rng.h"
+#include "roster.h"
+#include "tables.h"
+
+#define ALIGN8(n)	(((n) + 7) & ~(size_t)7)
+#define FIELDS_MAX	10
+#define HASH_RUNS	4096	/* of home slots, for building the name index */
+#define ROSTER_LINE_MIN	20	/* the shortest tool or patient, newline and all */
+
+
+static void
+bad(const char *path, long line, const char *fmt,...)
+{
+	char		msg[256];
+	va_list		ap;
+
+	va_start(ap, fmt);
+	vsnprintf(msg, sizeof(msg), fmt, ap);
+	va_end(ap);
+	warnx("%s:%ld: %s", path, line, msg);
+}
+
+static uint32_t
+name_hash(const char *s)
+{
+	uint32_t	h = 2166136261U;
+
+	while (*s != '\0') {
+		h ^= (uint8_t)*s++;
+		h *= 16777619U;
+	}
+	return h;
+}
+
+/* A whole number from lo to hi, or -1 */
+static int
+number(const char *s, int lo, int hi, int *v)
+{
+	long		n = 0;
+
+	if (*s == '\0')
+		return -1;
+	for (; *s != '\0'; s++) {
+		if (*s < '0' || *s > '9' || (n = n * 10 + (*s - '0')) > hi)
+			return -1;
+	}
+	if (n < lo)
+		return -1;
+	*v = (int)n;
+	return 0;
+}
+
+static int
+parse_patient(struct roster_patient * p, char *const *f, const char *text)
+{
+	int		species = -1, age, patience, tolerance, difficulty;
+
+	for (int s = 0; s < NUM_PATIENTS; s++)
+		if (strcmp(f[2], patients[s].species) == 0)
+			species = s;
+	if (species == -1 || number(f[3], 0, INT16_MAX, &age) == -1 ||
+	    number(f[4], 0, INT16_MAX, &patience) == -1 ||
+	    number(f[5], 0, INT16_MAX, &tolerance) == -1 ||
+	    number(f[6], 0, ROSTER_DIFFICULTY_MAX, &difficulty) == -1)
+		return -1;
+	p->name = (uint32_t)(f[1] - text);
+	p->species = (uint8_t)species;
+	p->age = (int16_t)age;
+	p->patience = (int16_t)patience;
+	p->pain_tolerance = (int16_t)tolerance;
+	p->difficulty = (int16_t)difficulty;
+	return 0;
+}
+
+static int
+parse_tool(struct roster_tool * t, char *const *f, const char *text)
+{
+	int		v[7];
+
+	/* The turn tables and the solver stop at a dip and effort of 15 */
+	if (number(f[2], 1, UINT8_MAX, &v[0]) == -1 || number(f[3], 1, TBL_DIP - 1, &v[1]) == -1 ||
+	    number(f[4], 1, TBL_EFFORT - 1, &v[2]) == -1 || number(f[5], 0, UINT8_MAX, &v[3]) == -1 ||
+	    number(f[6], 0, UINT8_MAX, &v[4]) == -1 || number(f[7], 0, UINT8_MAX, &v[5]) == -1 ||
+	    number(f[8], 0, 1, &v[6]) == -1)
+		return -1;
+	t->name = (uint32_t)(f[1] - text);
+	t->description = (uint32_t)(f[9] - text);
+	t->length = (uint8_t)v[0];
+	t->dip_amount = (uint8_t)v[1];
+	t->effort = (uint8_t)v[2];
+	t->effectiveness = (uint8_t)v[3];
+	t->durability = (uint8_t)v[4];
+	t->pain_factor = (uint8_t)v[5];
+	t->dagger = (uint8_t)v[6];
+	return 0;
+}
+
+static const char *
+entry_name(const struct roster * r, uint32_t e)
+{
+	e--;
+	return roster_str(r, e & ROSTER_TOOL ? r->tool[e & ~ROSTER_TOOL].name : r->patient[e].name);
+}
+
+/*
+ * Index every name, refusing one seen before. The names go in by their
+ * home slot, counting sorted on its top bits first, so the table fills
+ * front to back instead of missing the cache on every name.
+ */
+static int
+build_hash(struct roster * r, struct roster_slot * hash, const char *path)
+{
+	uint32_t	n = r->npatients + r->ntools, slots = 2, shift = 0;
+	uint32_t	start[HASH_RUNS + 1];
+	struct roster_slot *name, *sorted;
+
+	while (slots < 2 * n)
+		slots *= 2;
+	while ((slots >> shift) > HASH_RUNS)
+		shift++;
+	r->hash_mask = slots - 1;
+	if ((name = malloc(2 * n * sizeof(*name) + 1)) == NULL)
+		err(1, "roster index");
+	sorted = name + n;
+
+	memset(start, 0, sizeof(start));
+	for (uint32_t i = 0; i < n; i++) {
+		name[i].entry = i < r->npatients ? i + 1 : (i - r->npatients + 1) | ROSTER_TOOL;
+		name[i].hash = name_hash(entry_name(r, name[i].entry));
+		start[((name[i].hash & r->hash_mask) >> shift) + 1]++;
+	}
+	for (int k = 0; k < HASH_RUNS; k++)
+		start[k + 1] += start[k];
+	for (uint32_t i = 0; i < n; i++)
+		sorted[start[(name[i].hash & r->hash_mask) >> shift]++] = name[i];
+
+	for (uint32_t i = 0; i < n; i++) {
+		const char     *s = entry_name(r, sorted[i].entry);
+		uint32_t	h = sorted[i].hash & r->hash_mask;
+
+		for (; hash[h].entry != 0; h = (h + 1) & r->hash_mask)
+			if (hash[h].hash == sorted[i].hash && strcmp(entry_name(r, hash[h].entry), s) == 0) {
+				warnx("%s: %s is in the roster twice", path, s);
+				free(name);
+				return -1;
+			}
+		hash[h] = sorted[i];
+	}
+	free(name);
+	return 0;
+}
+
+/*
+ * Read the file into a fresh mapping with room after it for as many
+ * entries as its size allows, a line being at least ROSTER_LINE_MIN bytes
+ */
+static int
+map_text(const char *path, struct roster * r, size_t * size, uint32_t * room)
+{
+	struct stat	st;
+	size_t		n, slots;
+	ssize_t		got;
+	int		fd;
+
+	if ((fd = open(path, O_RDONLY)) == -1) {
+		warn("%s", path);
+		return -1;
+	}
+	if (fstat(fd, &st) == -1 || st.st_size >= UINT32_MAX ||
+	    (n = (size_t)st.st_size / ROSTER_LINE_MIN + 1) > ROSTER_MAX) {
+		warnx("%s is too large for a roster", path);
+		close(fd);
+		return -1;
+	}
+	*size = (size_t)st.st_size;
+	*room = (uint32_t)n;
+	for (slots = 2; slots < 2 * n; slots *= 2)
+		;
+	r->map_size = ALIGN8(*size + 1) + n * (sizeof(struct roster_patient) + sizeof(struct roster_tool) +
+			       3 * sizeof(uint32_t)) + slots * sizeof(struct roster_slot);
+	r->map = mmap(NULL, r->map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+	if (r->map == MAP_FAILED)
+		err(1, "roster of %zu bytes", r->map_size);
+	for (size_t off = 0; off < *size; off += (size_t)got)
+		if ((got = read(fd, (char *)r->map + off, *size - off)) <= 0) {
+			if (got == 0)
+				warnx("%s: shorter than it was", path);
+			else
+				warn("%s", path);
+			close(fd);
+			munmap(r->map, r->map_size);
+			r->map = NULL;
+			return -1;
+		}
+	close(fd);
+	return 0;
+}
+
+/* Load path into r. Returns -1, having said why, on a bad roster. */
+int
+roster_load(const char *path, struct roster * r)
+{
+	char	       *text, *line, *nl, *end, *f[FIELDS_MAX];
+	struct roster_patient *patient;
+	struct roster_tool *tool;
+	struct roster_slot *hash;
+	uint32_t	count[ROSTER_DIFFICULTY_MAX + 2], *by_difficulty, *by_species, *by_class;
+	uint32_t	np = 0, nt = 0, room;
+	size_t		size;
+	char	       *cursor;
+
+	memset(r, 0, sizeof(*r));
+	if (map_text(path, r, &size, &room) == -1)
+		return -1;
+	line = text = r->map;
+	cursor = (char *)r->map + ALIGN8(size + 1);
+	patient = (struct roster_patient *)cursor;
+	cursor += room * sizeof(*patient);
+	tool = (struct roster_tool *)cursor;
+	cursor += room * sizeof(*tool);
+	by_difficulty = (uint32_t *)cursor;
+	by_species = by_difficulty + room;
+	by_class = by_species + room;
+	hash = (struct roster_slot *)(by_class + room);
+	r->text = text;
+	r->patient = patient;
+	r->tool = tool;
+
+	end = text + size;
+	for (long ln = 1; line < end; ln++, line = nl + 1) {
+		int		nf = 0;
+
+		if ((nl = memchr(line, '\n', end - line)) == NULL)
+			nl = end;
+		*nl = '\0';
+		if (nl > line && nl[-1] == '\r')
+			nl[-1] = '\0';
+		if (line[0] == '\0' || line[0] == '#')
+			continue;
+
+		/* A tool's description is the rest of the line */
+		f[nf++] = line;
+		for (char *p = line; nf < FIELDS_MAX && (p = memchr(p, '\t', nl - p)) != NULL;) {
+			*p++ = '\0';
+			f[nf++] = p;
+		}
+		if (strcmp(f[0], "patient") == 0) {
+			if (nf != 7 || f[1][0] == '\0') {
+				bad(path, ln, "a patient has a name, species, age, patience, pain tolerance and difficulty");
+				goto fail;
+			}
+			if (parse_patient(&patient[np], f, text) == -1) {
+				bad(path, ln, "%s: no such species, or a number out of range", f[1]);
+				goto fail;
+			}
+			np++;
+		} else if (strcmp(f[0], "tool") == 0) {
+			if (nf != 10 || f[1][0] == '\0') {
+				bad(path, ln, "a tool has a name, length, dip, effort, effectiveness, durability, pain, dagger and description");
+				goto fail;
+			}
+			if (parse_tool(&tool[nt], f, text) == -1) {
+				bad(path, ln, "%s: a number out of range", f[1]);
+				goto fail;
+			}
+			nt++;
+		} else {
+			bad(path, ln, "%s is neither a patient nor a tool", f[0]);
+			goto fail;
+		}
+	}
+	r->npatients = np;
+	r->ntools = nt;
+
+	/* Counting sorts keep the file's order within a difficulty, species or class */
+	memset(count, 0, sizeof(count));
+	for (uint32_t i = 0; i < np; i++)
+		count[patient[i].difficulty + 1]++;
+	for (int d = 0; d <= ROSTER_DIFFICULTY_MAX; d++)
+		count[d + 1] += count[d];
+	for (uint32_t i = 0; i < np; i++)
+		by_difficulty[count[patient[i].difficulty]++] = i;
+
+	for (uint32_t i = 0; i < np; i++)
+		r->species_start[patient[i].species + 1]++;
+	for (int s = 0; s < NUM_PATIENTS; s++)
+		r->species_start[s + 1] += r->species_start[s];
+	memcpy(count, r->species_start, sizeof(r->species_start));
+	for (uint32_t i = 0; i < np; i++)
+		by_species[count[patient[i].species]++] = i;
+
+	for (uint32_t i = 0; i < nt; i++)
+		r->class_start[tool[i].dagger + 1]++;
+	r->class_start[2] += r->class_start[1];
+	memcpy(count, r->class_start, sizeof(r->class_start));
+	for (uint32_t i = 0; i < nt; i++)
+		by_class[count[tool[i].dagger]++] = i;
+
+	if (build_hash(r, hash, path) == -1)
+		goto fail;
+	r->by_difficulty = by_difficulty;
+	r->by_species = by_species;
+	r->by_class = by_class;
+	r->hash = hash;
+
+	if (mprotect(r->map, r->map_size, PROT_READ) == -1)
+		err(1, "mprotect");
+	return 0;
+
+fail:
+	roster_free(r);
+	return -1;
+}
+
+void
+roster_free(struct roster * r)
+{
+	if (r->map != NULL)
+		munmap(r->map, r->map_size);
+	memset(r, 0, sizeof(*r));
+}
+
+static uint32_t
+lookup(const struct roster * r, const char *name)
+{
+	uint32_t	key = name_hash(name);
+
+	if (r->hash == NULL)
+		return 0;
+	for (uint32_t h = key & r->hash_mask;; h = (h + 1) & r->hash_mask) {
+		const struct roster_slot *slot = &r->hash[h];
+
+		if (slot->entry == 0 ||
+		    (slot->hash == key && strcmp(entry_name(r, slot->entry), name) == 0))
+			return slot->entry;
+	}
+}
+
+/* The creature called name, or -1 */
+long
+roster_find_patient(const struct roster * r, const char *name)
+{
+	uint32_t	e = lookup(r, name);
+
+	return e == 0 || (e - 1) & ROSTER_TOOL ? -1 : (long)(e - 1);
+}
+
+/* The tool called name, or -1 */
+long
+roster_find_tool(const struct roster * r, const char *name)
+{
+	uint32_t	e = lookup(r, name);
+
+	return e == 0 || !((e - 1) & ROSTER_TOOL) ? -1 : (long)((e - 1) & ~ROSTER_TOOL);
+}
+
+/* The first creature in by_difficulty at least as hard as d */
+static uint32_t
+lower_bound(const struct roster * r, int d)
+{
+	uint32_t	lo = 0, hi = r->npatients;
+
+	while (lo < hi) {
+		uint32_t	mid = lo + (hi - lo) / 2;
+
+		if (r->patient[r->by_difficulty[mid]].difficulty < d)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/* The run of by_difficulty with difficulties lo to hi */
+void
+roster_band(const struct roster * r, int lo, int hi, uint32_t * first, uint32_t * n)
+{
+	uint32_t	end = lower_bound(r, hi + 1);
+
+	*first = lower_bound(r, lo);
+	*n = end > *first ? end - *first : 0;
+}
+
+/* A random creature of difficulty lo to hi, or -1 if there is none */
+long
+roster_pick_patient(const struct roster * r, int lo, int hi)
+{
+	uint32_t	first, n;
+
+	roster_band(r, lo, hi, &first, &n);
+	if (n == 0)
+		return -1;
+	return r->by_difficulty[first + rng_uniform(n)];
+}
+
+/* A random tool, or dagger, or -1 if there is none */
+long
+roster_pick_tool(const struct roster * r, int dagger)
+{
+	uint32_t	first = r->class_start[dagger != 0], n = r->class_start[(dagger != 0) + 1] - first;
+
+	if (n == 0)
+		return -1;
+	return r->by_class[first + rng_uniform(n)];
+}
+
+/* Tool i as a tools[] entry, its strings still in the roster */
+void
+roster_tool(const struct roster * r, uint32_t i, tool * out)
+{
+	const struct roster_tool *t = &r->tool[i];
+
+	out->name = (char *)roster_str(r, t->name);
+	out->description = (char *)roster_str(r, t->description);
+	out->length = t->length;
+	out->dip_amount = t->dip_amount;
+	out->effort = t->effort;
+	out->effectiveness = t->effectiveness;
+	out->durability = t->durability;
+	out->pain_factor = t->pain_factor;
+}
@@ -0,0 +1,107 @@
+/*
+ * BSD Zero Clause License
+ *
+ * Copyright (c) 2025 David M Crumpton david.m.crumpton [at] gmail [dot] com
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * roster.h: creatures and tools loaded from a tab separated file, with a
+ * name index and the creatures sorted by difficulty
+ *
+ */
+
+#ifndef ROSTER_H
+#define ROSTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "buffy.h"
+#include "engine.h"
+
+#define ROSTER_DIFFICULTY_MAX	1000
+#define ROSTER_MAX		(1 << 24)	/* entries of either kind */
+
+/* A creature plays as its species, with its own name and temper */
+struct roster_patient {
+	uint32_t	name;	/* offset in text */
+	int16_t		age;
+	int16_t		patience;
+	int16_t		pain_tolerance;
+	int16_t		difficulty;
+	uint8_t		species;	/* index in patients[] */
+};
+
+struct roster_tool {
+	uint32_t	name;
+	uint32_t	description;
+	uint8_t		length;
+	uint8_t		dip_amount;
+	uint8_t		effort;
+	uint8_t		effectiveness;
+	uint8_t		durability;
+	uint8_t		pain_factor;
+	uint8_t		dagger;
+};
+
+/*
+ * A slot of the name index: the name's hash, so a probe only compares
+ * names when the hashes agree, and index + 1 of a creature, or of a tool
+ * with ROSTER_TOOL set, or 0 when empty
+ */
+#define ROSTER_TOOL	0x80000000U
+
+struct roster_slot {
+	uint32_t	hash;
+	uint32_t	entry;
+};
+
+/*
+ * Everything lives in one mapping that is made read only once loaded: the
+ * file's text with its fields cut into strings, the entries and the
+ * indexes.
+ */
+struct roster {
+	void	       *map;
+	size_t		map_size;
+	const char     *text;
+	const struct roster_patient *patient;
+	uint32_t	npatients;
+	const struct roster_tool *tool;
+	uint32_t	ntools;
+	const uint32_t *by_difficulty;	/* creatures, easiest first */
+	const uint32_t *by_species;	/* creatures, by species in turn */
+	uint32_t	species_start[NUM_PATIENTS + 1];
+	const uint32_t *by_class;	/* tools, then daggers */
+	uint32_t	class_start[3];
+	const struct roster_slot *hash;
+	uint32_t	hash_mask;
+};
+
+int		roster_load(const char *path, struct roster * r);
+void		roster_free(struct roster * r);
+long		roster_find_patient(const struct roster * r, const char *name);
+long		roster_find_tool(const struct roster * r, const char *name);
+void		roster_band(const struct roster * r, int lo, int hi, uint32_t * first, uint32_t * n);
+long		roster_pick_patient(const struct roster * r, int lo, int hi);
+long		roster_pick_tool(const struct roster * r, int dagger);
+void		roster_tool(const struct roster * r, uint32_t i, tool * out);
+
+static inline const char *
+roster_str(const struct roster * r, uint32_t off)
+{
+	return r->text + off;
+}
+
+#endif				/* ROSTER_H */
@@ -0,0 +1,259 @@
+/*
+ * BSD Zero Clause License
+ *
+ * Copyright (c) 2025 David M Crumpton david.m.crumpton [at] gmail [dot] com
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * simulate.c: plays whole games without curses, prompts or sleeps using the
+ * same turn logic as the interactive game and a scripted hygienist
+ *
+ */
+#include <err.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "buffy.h"
+#include "engine.h"
+#include "policy.h"
+#include "pool.h"
+#include "rng.h"
+#include "simulate.h"
+#include "tables.h"
+
+
+static const struct policy_config *sim_policy = NULL;
+
+/*
+ * Play a policy instead of the scripted hygienist. Every worker builds its
+ * own instance from the configuration.
+ */
+void
+sim_use_policy(const struct policy_config * cfg)
+{
+	sim_policy = cfg;
+}
+
+/*
+ * The scripted hygienist always works at the tool's full effort and dips
+ * just deep enough to finish the fang in one stroke, or as deep as the tool
+ * allows when no dip will.
+ */
+void
+sim_scripted_input(const game_state_type * state, const patient_type * pat, int fang_idx, int *tool_dip, int *tool_effort)
+{
+	const tool     *t = &engine_live->tools[state->tool_in_use];
+	int		need = MAX_HEALTH - pat->fangs[fang_idx].health;
+
+	*tool_effort = t->effort;
+	for (int dip = 0; dip <= t->dip_amount; dip++) {
+		if (fang_health_gain(state, dip * t->length, t->effort) >= need) {
+			*tool_dip = dip;
+			return;
+		}
+	}
+	*tool_dip = t->dip_amount;
+}
+
+/*
+ * Play one game from a fresh deal to the end, with the scripted hygienist
+ * when policy is NULL. The caller sets daggerset in the state beforehand.
+ * Returns SIM_WIN, SIM_NO_FLUORIDE or SIM_STALLED.
+ */
+int
+sim_play_game(game_state_type * state, patient_type * pat, struct policy * policy)
+{
+	engine_init_state(state);
+	patient_init(state, pat);
+	return sim_play_dealt(state, pat, policy);
+}
+
+/* Play out a game that has already been dealt */
+int
+sim_play_dealt(game_state_type * state, patient_type * pat, struct policy * policy)
+{
+	struct dent_bits teeth;
+	int		tool_dip, tool_effort;
+
+	if (policy != NULL)
+		policy_new_game(policy);
+
+	dent_bits_init(&teeth, pat);
+	for (;;) {
+		for (int i = dent_next(&teeth, 0); i < NUM_FANGS; i = dent_next(&teeth, i + 1)) {
+			if (policy != NULL) {
+				policy_choose(policy, state, pat, i, &tool_dip, &tool_effort);
+				if (policy->hopeless)
+					return SIM_STALLED;
+			} else
+				sim_scripted_input(state, pat, i, &tool_dip, &tool_effort);
+			if (engine_fang_turn(state, pat, i, tool_dip, tool_effort, NULL, 0) == -1)
+				return SIM_NO_FLUORIDE;
+			dent_bits_update(&teeth, i, pat->fangs[i].health);
+		}
+
+		if (engine_end_round(state, &teeth) == 0) {
+			state->score += engine_live->bonus.all_health;
+			return SIM_WIN;
+		}
+		if (state->turns > SIM_MAX_TURNS)
+			return SIM_STALLED;
+	}
+}
+
+/* Each worker owns one shard so counters never share a cache line */
+struct sim_shard {
+	_Alignas(CACHE_LINE) struct sim_results res;
+	struct rng	rng;
+	struct policy  *policy;
+};
+
+struct sim_job {
+	struct sim_shard *shards;
+	uint64_t	seed;
+	uint64_t	first;	/* game number of item 0 */
+	int		daggerset;
+};
+
+static void
+sim_tally(struct sim_results * res, int outcome, const game_state_type * state)
+{
+	switch (outcome) {
+	case SIM_WIN:
+		res->wins++;
+		break;
+	case SIM_NO_FLUORIDE:
+		res->no_fluoride++;
+		break;
+	default:
+		res->stalled++;
+	}
+	res->games++;
+	res->score_sum += state->score;
+	res->turns_sum += state->turns;
+	res->fluoride_sum += state->fluoride;
+	sketch_add(&res->score, state->score);
+	sketch_add(&res->turns, state->turns);
+	sketch_add(&res->fluoride, state->fluoride);
+}
+
+static void
+sim_worker(void *arg, int worker, uint64_t lo, uint64_t hi)
+{
+	struct sim_job *job = arg;
+	struct sim_shard *shard = &job->shards[worker];
+	game_state_type	state;
+	patient_type	pat;
+
+	if (sim_policy != NULL && shard->policy == NULL)
+		shard->policy = policy_new(sim_policy);
+
+	rng_set_stream(&shard->rng);
+	for (uint64_t g = lo; g < hi; g++) {
+		rng_seed(&shard->rng, job->seed, job->first + g);
+		memset(&state, 0, sizeof(state));
+		memset(&pat, 0, sizeof(pat));
+		state.daggerset = job->daggerset;
+		sim_tally(&shard->res, sim_play_game(&state, &pat, shard->policy), &state);
+	}
+	rng_set_stream(NULL);
+}
+
+void
+sim_merge_results(struct sim_results * into, const struct sim_results * from)
+{
+	into->games += from->games;
+	into->wins += from->wins;
+	into->no_fluoride += from->no_fluoride;
+	into->stalled += from->stalled;
+	into->score_sum += from->score_sum;
+	into->turns_sum += from->turns_sum;
+	into->fluoride_sum += from->fluoride_sum;
+	sketch_merge(&into->score, &from->score);
+	sketch_merge(&into->turns, &from->turns);
+	sketch_merge(&into->fluoride, &from->fluoride);
+}
+
+/*
+ * Play ngames on nthreads workers. Game g is dealt from stream g of the
+ * run's seed whichever worker plays it, so a seed gives the same results
+ * on any number of threads. Every worker counts into its own shard; the
+ * shards are summed at the end.
+ */
+void
+simulate_games(long ngames, int daggerset, int nthreads, struct sim_results * res)
+{
+	simulate_range(0, ngames, daggerset, nthreads, res);
+}
+
+/* Play games first..first + ngames - 1 of the run's seed */
+void
+simulate_range(uint64_t first, long ngames, int daggerset, int nthreads, struct sim_results * res)
+{
+	struct sim_job	job;
+	struct timespec	start, end;
+
+	if (nthreads < 1)
+		nthreads = 1;
+	if ((job.shards = aligned_alloc(CACHE_LINE, sizeof(*job.shards) * nthreads)) == NULL)
+		err(1, "simulator shards");
+	memset(job.shards, 0, sizeof(*job.shards) * nthreads);
+	job.seed = rng_get_seed();
+	job.first = first;
+	job.daggerset = daggerset;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	pool_run(nthreads, ngames, SIM_CHUNK, sim_worker, &job);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	memset(res, 0, sizeof(*res));
+	for (int i = 0; i < nthreads; i++) {
+		sim_merge_results(res, &job.shards[i].res);
+		if (job.shards[i].policy != NULL) {
+			policy_merge_stats(&res->policy, &job.shards[i].policy->stats);
+			policy_free(job.shards[i].policy);
+		}
+	}
+	res->threads = nthreads;
+	res->seed = job.seed;
+	res->elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+	free(job.shards);
+}
+
+void
+print_sim_results(const struct sim_results * res)
+{
+	double		n = res->games > 0 ? (double)res->games : 1.0;
+
+	printf("Simulated %ld games in %.3f s on %d thread%s (%.0f games/s)\n",
+	       res->games, res->elapsed, res->threads, res->threads == 1 ? "" : "s",
+	       res->elapsed > 0 ? res->games / res->elapsed : 0.0);
+	printf("  Seed: %#llx\n", (unsigned long long)res->seed);
+	printf("  Wins: %ld (%.2f%%)\n", res->wins, 100.0 * res->wins / n);
+	printf("  Out of fluoride: %ld (%.2f%%)\n", res->no_fluoride, 100.0 * res->no_fluoride / n);
+	if (res->stalled)
+		printf("  Stalled (hopeless or past %d turns): %ld\n", SIM_MAX_TURNS, res->stalled);
+	printf("  Mean score: %.2f (p10 %ld, p50 %ld, p90 %ld)\n", res->score_sum / n,
+	       sketch_quantile(&res->score, 0.1), sketch_quantile(&res->score, 0.5),
+	       sketch_quantile(&res->score, 0.9));
+	printf("  Mean turns: %.2f (p10 %ld, p50 %ld, p90 %ld)\n", res->turns_sum / n,
+	       sketch_quantile(&res->turns, 0.1), sketch_quantile(&res->turns, 0.5),
+	       sketch_quantile(&res->turns, 0.9));
+	printf("  Mean fluoride left: %.2f (p10 %ld, p50 %ld, p90 %ld)\n", res->fluoride_sum / n,
+	       sketch_quantile(&res->fluoride, 0.1), sketch_quantile(&res->fluoride, 0.5),
+	       sketch_quantile(&res->fluoride, 0.9));
+	policy_print_stats(&res->policy, stdout);
+}
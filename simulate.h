@@ -0,0 +1,65 @@
+/*
+ * BSD Zero Clause License
+ *
+ * Copyright (c) 2025 David M Crumpton david.m.crumpton [at] gmail [dot] com
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * simulate.h: headless batch play for balance testing
+ *
+ */
+
+#ifndef SIMULATE_H
+#define SIMULATE_H
+
+#include <stdint.h>
+
+#include "buffy.h"
+#include "policy.h"
+#include "sketch.h"
+
+#define SIM_WIN		0
+#define SIM_NO_FLUORIDE	1
+#define SIM_STALLED	2
+
+#define SIM_MAX_TURNS	1000	/* give up on a game that stops progressing */
+#define SIM_CHUNK	1024	/* games handed to a worker at a time */
+
+struct sim_results {
+	long		games;
+	long		wins;
+	long		no_fluoride;
+	long		stalled;
+	long long	score_sum;
+	long long	turns_sum;
+	long long	fluoride_sum;	/* fluoride left at the end of each game */
+	struct sketch	score;	/* distributions of the same three */
+	struct sketch	turns;
+	struct sketch	fluoride;
+	double		elapsed;	/* seconds of wall clock */
+	int		threads;
+	uint64_t	seed;	/* game g is dealt from stream g */
+	struct policy_stats policy;
+};
+
+void		sim_use_policy(const struct policy_config * cfg);
+void		sim_scripted_input(const game_state_type * state, const patient_type * pat, int fang_idx, int *tool_dip, int *tool_effort);
+int		sim_play_game(game_state_type * state, patient_type * pat, struct policy * policy);
+int		sim_play_dealt(game_state_type * state, patient_type * pat, struct policy * policy);
+void		sim_merge_results(struct sim_results * into, const struct sim_results * from);
+void		simulate_games(long ngames, int daggerset, int nthreads, struct sim_results * res);
+void		simulate_range(uint64_t first, long ngames, int daggerset, int nthreads, struct sim_results * res);
+void		print_sim_results(const struct sim_results * res);
+
+#endif				/* SIMULATE_H */
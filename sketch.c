@@ -0,0 +1,65 @@
+/*
+ * BSD Zero Clause License
+ *
+ * Copyright (c) 2025 David M Crumpton david.m.crumpton [at] gmail [dot] com
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * sketch.c: merging and reading the quantile histograms
+ *
+ */
+#include "sketch.h"
+
+
+void
+sketch_merge(struct sketch * into, const struct sketch * from)
+{
+	into->count += from->count;
+	for (int i = 0; i < SKETCH_BUCKETS; i++)
+		into->bucket[i] += from->bucket[i];
+}
+
+/* The smallest value that falls in a bucket */
+long
+sketch_lower(int bucket)
+{
+	int		octave, sub;
+
+	if (bucket < SKETCH_EXACT)
+		return bucket;
+	octave = (bucket - SKETCH_EXACT) / (1 << SKETCH_SUB_BITS) + SKETCH_EXACT_BITS;
+	sub = (bucket - SKETCH_EXACT) % (1 << SKETCH_SUB_BITS);
+	return (1L << octave) + ((long)sub << (octave - SKETCH_SUB_BITS));
+}
+
+/*
+ * The value at quantile q, 0..1: exact below SKETCH_EXACT, otherwise the
+ * lower edge of the bucket it falls in. 0 for an empty sketch.
+ */
+long
+sketch_quantile(const struct sketch * s, double q)
+{
+	uint64_t	rank, seen = 0;
+
+	if (s->count == 0)
+		return 0;
+	q = q < 0 ? 0 : q > 1 ? 1 : q;
+	rank = (uint64_t)(q * (s->count - 1));
+	for (int i = 0; i < SKETCH_BUCKETS; i++) {
+		seen += s->bucket[i];
+		if (seen > rank)
+			return sketch_lower(i);
+	}
+	return sketch_lower(SKETCH_BUCKETS - 1);
+}
@@ -0,0 +1,68 @@
+/*
+ * BSD Zero Clause License
+ *
+ * Copyright (c) 2025 David M Crumpton david.m.crumpton [at] gmail [dot] com
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * sketch.h: a log-linear histogram for quantiles that merges exactly by
+ * adding counts, in the manner of HDR histograms
+ *
+ */
+
+#ifndef SKETCH_H
+#define SKETCH_H
+
+#include <stdint.h>
+
+/*
+ * Values below SKETCH_EXACT each have a bucket; above it every power of
+ * two is split into 1 << SKETCH_SUB_BITS buckets, so a quantile is off by
+ * at most 1/32 of its value. Turns and fluoride always land in the exact
+ * range and so do all but stalled games' scores.
+ */
+#define SKETCH_EXACT_BITS	10
+#define SKETCH_EXACT		(1 << SKETCH_EXACT_BITS)
+#define SKETCH_SUB_BITS		5
+#define SKETCH_BUCKETS		(SKETCH_EXACT + (32 - SKETCH_EXACT_BITS) * (1 << SKETCH_SUB_BITS))
+
+struct sketch {
+	uint64_t	count;
+	uint64_t	bucket[SKETCH_BUCKETS];
+};
+
+static inline int
+sketch_bucket(uint32_t v)
+{
+	int		octave;
+
+	if (v < SKETCH_EXACT)
+		return (int)v;
+	octave = 31 - __builtin_clz(v);
+	return SKETCH_EXACT + (octave - SKETCH_EXACT_BITS) * (1 << SKETCH_SUB_BITS) +
+		(int)((v >> (octave - SKETCH_SUB_BITS)) & ((1 << SKETCH_SUB_BITS) - 1));
+}
+
+static inline void
+sketch_add(struct sketch * s, long v)
+{
+	s->bucket[sketch_bucket(v < 0 ? 0 : v > (long)UINT32_MAX ? UINT32_MAX : (uint32_t)v)]++;
+	s->count++;
+}
+
+void		sketch_merge(struct sketch * into, const struct sketch * from);
+long		sketch_lower(int bucket);
+long		sketch_quantile(const struct sketch * s, double q);
+
+#endif				/* SKETCH_H */
@@ -0,0 +1,279 @@
+/*
+ * BSD Zero Clause License
+ *
+ * Copyright (c) 2025 David M Crumpton david.m.crumpton [at] gmail [dot] com
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * solver.c: backward induction for the cheapest way to clean a fang.
+ *
+ * Once the patient and tool are dealt the game has no more chance in it,
+ * and the only thing the four fangs share is the fluoride pot: effort costs
+ * nothing, patience and mood never feed back into health, and the order of
+ * strokes does not change what a dip costs. So the whole game is solved by
+ * solving one fang per (tool, species, health): the least fluoride that
+ * brings it to full health, with fewer strokes and then gentler effort
+ * breaking ties. A dealt game is winnable exactly when the four fang costs
+ * fit in the fluoride left, and the next stroke for any fang is one table
+ * load.
+ *
+ */
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <err.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "buffy.h"
+#include "engine.h"
+#include "solver.h"
+
+#define SOLVER_ROW	(MAX_HEALTH + 1)
+#define SOLVER_ENTRIES	(NUM_TOOLS * NUM_PATIENTS * SOLVER_ROW)
+
+
+static uint32_t
+fnv1a(uint32_t h, int v)
+{
+	for (size_t i = 0; i < sizeof(v); i++) {
+		h ^= (v >> (i * 8)) & 0xff;
+		h *= 16777619U;
+	}
+	return h;
+}
+
+/*
+ * Hash every input the solution depends on, by running the formulas
+ * themselves, so a table solved for older rules is refused.
+ */
+uint32_t
+solver_balance_fingerprint(void)
+{
+	game_state_type	state;
+	uint32_t	h = 2166136261U;
+
+	memset(&state, 0, sizeof(state));
+	h = fnv1a(h, MAX_HEALTH);
+	for (int t = 0; t < NUM_TOOLS; t++) {
+		h = fnv1a(h, tools[t].length);
+		h = fnv1a(h, tools[t].dip_amount);
+		h = fnv1a(h, tools[t].effort);
+		state.tool_in_use = t;
+		for (int s = 0; s < NUM_PATIENTS; s++) {
+			state.patient_idx = s;
+			for (int f = 0; f <= tools[t].dip_amount; f++)
+				for (int e = 0; e <= tools[t].effort; e++)
+					h = fnv1a(h, fang_health_gain(&state, f, e));
+		}
+	}
+	return h;
+}
+
+static void
+solve_cell(int tool_idx, int species, struct solver_entry * row)
+{
+	game_state_type	state;
+	const tool     *t = &tools[tool_idx];
+
+	if (t->dip_amount > 15 || t->effort > 15)
+		errx(1, "%s is out of the solver's dip/effort range", t->name);
+
+	memset(&state, 0, sizeof(state));
+	state.tool_in_use = tool_idx;
+	state.patient_idx = species;
+
+	row[MAX_HEALTH].cost = 0;
+	row[MAX_HEALTH].strokes = 0;
+	row[MAX_HEALTH].action = 0;
+
+	/* Strokes only ever help by raising health, so solve from the top */
+	for (int h = MAX_HEALTH - 1; h >= 0; h--) {
+		struct solver_entry best = {SOLVER_NO_WAY, 0, (t->dip_amount << 4) | t->effort};
+
+		for (int dip = 0; dip <= t->dip_amount; dip++) {
+			int		used = dip * t->length;
+
+			for (int effort = 0; effort <= t->effort; effort++) {
+				int		gain = fang_health_gain(&state, used, effort);
+				int		next = h + gain > MAX_HEALTH ? MAX_HEALTH : h + gain;
+
+				if (gain <= 0 || row[next].cost == SOLVER_NO_WAY)
+					continue;
+
+				int		cost = used + row[next].cost;
+				int		strokes = 1 + row[next].strokes;
+
+				if (cost >= SOLVER_NO_WAY)
+					continue;
+				if (cost < best.cost || (cost == best.cost && strokes < best.strokes)) {
+					best.cost = cost;
+					best.strokes = strokes;
+					best.action = (dip << 4) | effort;
+				}
+			}
+		}
+		row[h] = best;
+	}
+}
+
+int
+solver_write(const char *path)
+{
+	struct solver_header header;
+	struct solver_entry *entries;
+	char		tmp[FILENAME_MAX];
+	int		fd;
+
+	if ((entries = calloc(SOLVER_ENTRIES, sizeof(*entries))) == NULL)
+		err(1, "solver table");
+	for (int t = 0; t < NUM_TOOLS; t++)
+		for (int s = 0; s < NUM_PATIENTS; s++)
+			solve_cell(t, s, &entries[(t * NUM_PATIENTS + s) * SOLVER_ROW]);
+
+	memset(&header, 0, sizeof(header));
+	header.magic = SOLVER_MAGIC;
+	header.version = SOLVER_VERSION;
+	header.ntools = NUM_TOOLS;
+	header.nspecies = NUM_PATIENTS;
+	header.balance = solver_balance_fingerprint();
+	header.max_health = MAX_HEALTH;
+
+	/* Write beside the target and rename so readers never map a torn file */
+	snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+	if ((fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644)) == -1) {
+		warn("%s", tmp);
+		free(entries);
+		return -1;
+	}
+	if (write(fd, &header, sizeof(header)) != sizeof(header) ||
+	    write(fd, entries, sizeof(*entries) * SOLVER_ENTRIES) != (ssize_t) (sizeof(*entries) * SOLVER_ENTRIES)) {
+		warn("write %s", tmp);
+		close(fd);
+		unlink(tmp);
+		free(entries);
+		return -1;
+	}
+	close(fd);
+	free(entries);
+	if (rename(tmp, path) == -1) {
+		warn("rename %s", path);
+		unlink(tmp);
+		return -1;
+	}
+	return 0;
+}
+
+int
+solver_open(const char *path, struct solver_table * t)
+{
+	struct stat	st;
+	void	       *map;
+	int		fd;
+
+	memset(t, 0, sizeof(*t));
+	if ((fd = open(path, O_RDONLY)) == -1) {
+		warn("%s", path);
+		return -1;
+	}
+	if (fstat(fd, &st) == -1 || st.st_size < (off_t) sizeof(struct solver_header)) {
+		warnx("%s is not a policy table", path);
+		close(fd);
+		return -1;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		warn("mmap %s", path);
+		return -1;
+	}
+
+	const struct solver_header *h = map;
+	if (h->magic != SOLVER_MAGIC || h->version != SOLVER_VERSION ||
+	    h->ntools != NUM_TOOLS || h->nspecies != NUM_PATIENTS ||
+	    h->max_health != MAX_HEALTH ||
+	    (size_t)st.st_size != sizeof(*h) + sizeof(struct solver_entry) * SOLVER_ENTRIES) {
+		warnx("%s is not a policy table for this version", path);
+		munmap(map, st.st_size);
+		return -1;
+	}
+	if (h->balance != solver_balance_fingerprint()) {
+		warnx("%s was solved for different tools or species, run --solve again", path);
+		munmap(map, st.st_size);
+		return -1;
+	}
+
+	t->header = h;
+	t->entries = (const struct solver_entry *)(h + 1);
+	t->map_len = st.st_size;
+	return 0;
+}
+
+void
+solver_close(struct solver_table * t)
+{
+	if (t->header != NULL)
+		munmap((void *)t->header, t->map_len);
+	memset(t, 0, sizeof(*t));
+}
+
+/* Can the remaining fluoride pay for every fang's cheapest plan? */
+int
+solver_winnable(const struct solver_table * t, const game_state_type * state, const patient_type * pat)
+{
+	int		need = 0;
+
+	for (int i = 0; i < NUM_FANGS; i++) {
+		int		h = pat->fangs[i].health;
+
+		h = h < 0 ? 0 : (h > MAX_HEALTH ? MAX_HEALTH : h);
+		const struct solver_entry *e = solver_entry(t, state->tool_in_use, state->patient_idx, h);
+		if (e->cost == SOLVER_NO_WAY)
+			return 0;
+		need += e->cost;
+	}
+	return need <= state->fluoride;
+}
+
+void
+solver_input(const struct solver_table * t, const game_state_type * state, const patient_type * pat, int fang_idx, int *tool_dip, int *tool_effort)
+{
+	int		h = pat->fangs[fang_idx].health;
+
+	h = h < 0 ? 0 : (h > MAX_HEALTH ? MAX_HEALTH : h);
+	const struct solver_entry *e = solver_entry(t, state->tool_in_use, state->patient_idx, h);
+
+	*tool_dip = SOLVER_DIP(e);
+	*tool_effort = SOLVER_EFFORT(e);
+}
+
+void
+solver_print_summary(const struct solver_table * t)
+{
+	printf("%-20s %-10s %10s %10s\n", "Tool", "Species", "Fluoride", "Strokes");
+	for (int ti = 0; ti < t->header->ntools; ti++) {
+		for (int s = 0; s < t->header->nspecies; s++) {
+			/* The dirtiest fang a deal can hold */
+			const struct solver_entry *e = solver_entry(t, ti, s, FANG_HEALTH_LOW);
+
+			if (e->cost == SOLVER_NO_WAY)
+				printf("%-20s %-10s %10s %10s\n", tools[ti].name, patients[s].species, "never", "-");
+			else
+				printf("%-20s %-10s %10d %10d\n", tools[ti].name, patients[s].species, e->cost, e->strokes);
+		}
+	}
+}
@@ -0,0 +1,77 @@
+/*
+ * BSD Zero Clause License
+ *
+ * Copyright (c) 2025 David M Crumpton david.m.crumpton [at] gmail [dot] com
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * solver.h: exact optimal dip/effort policy, stored in a file that is
+ * memory mapped for lookups
+ *
+ */
+
+#ifndef SOLVER_H
+#define SOLVER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "buffy.h"
+
+#define SOLVER_MAGIC	0x50465442	/* "BTFP" */
+#define SOLVER_VERSION	1
+#define SOLVER_NO_WAY	0xffff	/* fang can never reach full health */
+
+struct solver_header {
+	uint32_t	magic;
+	uint16_t	version;
+	uint8_t		ntools;
+	uint8_t		nspecies;
+	uint32_t	balance;	/* fingerprint of the rules solved for */
+	uint16_t	max_health;
+	uint16_t	reserved;
+};
+
+/* One per (tool, species, fang health) */
+struct solver_entry {
+	uint16_t	cost;	/* least fluoride to reach full health */
+	uint8_t		strokes;	/* strokes that plan takes */
+	uint8_t		action;	/* dip << 4 | effort for the next stroke */
+};
+
+struct solver_table {
+	const struct solver_header *header;
+	const struct solver_entry *entries;
+	size_t		map_len;
+};
+
+#define SOLVER_DIP(e)		((e)->action >> 4)
+#define SOLVER_EFFORT(e)	((e)->action & 0x0f)
+
+static inline const struct solver_entry *
+solver_entry(const struct solver_table * t, int tool_idx, int species, int health)
+{
+	return &t->entries[(tool_idx * t->header->nspecies + species) *
+			   (t->header->max_health + 1) + health];
+}
+
+uint32_t	solver_balance_fingerprint(void);
+int		solver_write(const char *path);
+int		solver_open(const char *path, struct solver_table * t);
+void		solver_close(struct solver_table * t);
+int		solver_winnable(const struct solver_table * t, const game_state_type * state, const patient_type * pat);
+void		solver_print_summary(const struct solver_table * t);
+void		solver_input(const struct solver_table * t, const game_state_type * state, const patient_type * pat, int fang_idx, int *tool_dip, int *tool_effort);
+
+#endif				/* SOLVER_H */
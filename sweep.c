@@ -0,0 +1,312 @@
+/*
+ * BSD Zero Clause License
+ *
+ * Copyright (c) 2025 David M Crumpton david.m.crumpton [at] gmail [dot] com
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * sweep.c: a long simulation cut into shards of consecutive game numbers.
+ * Game g is dealt from stream g of the seed wherever it is played, so
+ * shards can be handed to different processes or machines and their
+ * results, counts and quantile sketches that merge by addition, sum to
+ * exactly what one run would give. Each finished shard is written to the
+ * sweep's directory under a key of everything the sweep depends on; a
+ * restarted sweep skips the shards already there.
+ *
+ */
+#include <sys/stat.h>
+
+#include <dirent.h>
+#include <err.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "cache.h"
+#include "policy.h"
+#include "rng.h"
+#include "simulate.h"
+#include "sweep.h"
+
+#define SWEEP_PREFIX	"shard-"
+#define SWEEP_SUFFIX	".bfs"
+
+
+/*
+ * The key covers the balance configuration, the policy, the seed and how
+ * the games are cut up, so shards of different sweeps never mix.
+ */
+int
+sweep_init(struct sweep * sw, const char *dir, long games, int nshards, int daggerset, int threads, const struct policy_config * cfg)
+{
+	struct stat	st;
+
+	if (nshards < 1 || nshards > SWEEP_MAX_SHARDS || nshards > games) {
+		warnx("a sweep of %ld games cannot have %d shards", games, nshards);
+		return -1;
+	}
+	if (mkdir(dir, 0755) == -1 && errno != EEXIST) {
+		warn("%s", dir);
+		return -1;
+	}
+	if (stat(dir, &st) == -1 || !S_ISDIR(st.st_mode)) {
+		warnx("%s is not a directory", dir);
+		return -1;
+	}
+	sw->dir = dir;
+	sw->games = games;
+	sw->nshards = nshards;
+	sw->daggerset = daggerset;
+	sw->threads = threads;
+	cache_key_init(&sw->key, "sweep");
+	cache_key_policy(&sw->key, cfg);
+	cache_key_int(&sw->key, games);
+	cache_key_int(&sw->key, nshards);
+	cache_key_int(&sw->key, daggerset);
+	cache_key_int(&sw->key, (long long)rng_get_seed());
+	return 0;
+}
+
+/* Shard i plays games games * i / n up to games * (i + 1) / n */
+void
+sweep_range(const struct sweep * sw, int shard, uint64_t * first, long *count)
+{
+	uint64_t	lo = (uint64_t)sw->games * shard / sw->nshards;
+	uint64_t	hi = (uint64_t)sw->games * (shard + 1) / sw->nshards;
+
+	*first = lo;
+	*count = (long)(hi - lo);
+}
+
+static void
+shard_path(const char *dir, int shard, int nshards, char *path, size_t len)
+{
+	snprintf(path, len, "%s/" SWEEP_PREFIX "%05d-of-%05d" SWEEP_SUFFIX, dir, shard, nshards);
+}
+
+/* Returns 0 with a whole shard, -1 when there is none or it is damaged */
+static int
+shard_read(const char *path, struct sweep_header * hdr, struct sim_results * res)
+{
+	FILE	       *fp;
+	int		rv = -1;
+
+	if ((fp = fopen(path, "rb")) == NULL)
+		return -1;
+	if (fread(hdr, sizeof(*hdr), 1, fp) == 1 && hdr->magic == SWEEP_MAGIC &&
+	    hdr->version == SWEEP_VERSION && hdr->size == sizeof(*res) &&
+	    fread(res, sizeof(*res), 1, fp) == 1 && (uint64_t)res->games == hdr->count)
+		rv = 0;
+	fclose(fp);
+	return rv;
+}
+
+static int
+shard_write(const char *path, const struct sweep_header * hdr, const struct sim_results * res)
+{
+	char		tmp[PATH_MAX + 16];
+	FILE	       *fp;
+
+	/* Renamed into place, so a killed sweep leaves no half shard */
+	snprintf(tmp, sizeof(tmp), "%s.%ld", path, (long)getpid());
+	if ((fp = fopen(tmp, "wb")) == NULL) {
+		warn("%s", tmp);
+		return -1;
+	}
+	if (fwrite(hdr, sizeof(*hdr), 1, fp) != 1 || fwrite(res, sizeof(*res), 1, fp) != 1) {
+		warn("write %s", tmp);
+		fclose(fp);
+		remove(tmp);
+		return -1;
+	}
+	if (fflush(fp) == EOF || fsync(fileno(fp)) == -1 || fclose(fp) == EOF ||
+	    rename(tmp, path) == -1) {
+		warn("%s", path);
+		remove(tmp);
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Play one shard unless its file is already there. Returns 1 when it was,
+ * 0 once it has been played and written, -1 on error, including a file
+ * left by a different sweep.
+ */
+int
+sweep_run_shard(const struct sweep * sw, int shard)
+{
+	struct sweep_header hdr;
+	struct sim_results *res;
+	char		path[PATH_MAX];
+	uint64_t	first;
+	long		count;
+	int		rv = -1;
+
+	if (shard < 0 || shard >= sw->nshards) {
+		warnx("shard %d is not one of 0 to %d", shard, sw->nshards - 1);
+		return -1;
+	}
+	if ((res = malloc(sizeof(*res))) == NULL)
+		err(1, "sweep");
+	shard_path(sw->dir, shard, sw->nshards, path, sizeof(path));
+	sweep_range(sw, shard, &first, &count);
+
+	if (shard_read(path, &hdr, res) == 0) {
+		if (hdr.key[0] == sw->key.h[0] && hdr.key[1] == sw->key.h[1] &&
+		    hdr.shard == (uint32_t)shard && hdr.first == first && hdr.count == (uint64_t)count) {
+			free(res);
+			return 1;
+		}
+		warnx("%s belongs to a different sweep", path);
+		free(res);
+		return -1;
+	}
+	if (access(path, F_OK) == 0)
+		warnx("%s is damaged, playing it again", path);
+
+	simulate_range(first, count, sw->daggerset, sw->threads, res);
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = SWEEP_MAGIC;
+	hdr.version = SWEEP_VERSION;
+	hdr.shard = shard;
+	hdr.nshards = sw->nshards;
+	hdr.games = sw->games;
+	hdr.first = first;
+	hdr.count = count;
+	hdr.key[0] = sw->key.h[0];
+	hdr.key[1] = sw->key.h[1];
+	hdr.size = sizeof(*res);
+	if (shard_write(path, &hdr, res) == 0)
+		rv = 0;
+	free(res);
+	return rv;
+}
+
+/* Play every shard still missing from the directory */
+int
+sweep_run(const struct sweep * sw, int *played, int *resumed)
+{
+	*played = *resumed = 0;
+	for (int i = 0; i < sw->nshards; i++) {
+		switch (sweep_run_shard(sw, i)) {
+		case 1:
+			(*resumed)++;
+			break;
+		case 0:
+			(*played)++;
+			break;
+		default:
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Sum every shard file in dir. All of them must be from one sweep and
+ * none may be missing. The elapsed time is the shards' added together and
+ * the thread count the most any shard used.
+ */
+int
+sweep_merge(const char *dir, struct sim_results * res, int *nshards)
+{
+	struct sweep_header hdr, first;
+	struct sim_results *part;
+	struct dirent  *de;
+	char		path[PATH_MAX];
+	char	       *seen = NULL;
+	int		n = 0, found = 0, rv = -1;
+	DIR	       *d;
+
+	if ((d = opendir(dir)) == NULL) {
+		warn("%s", dir);
+		return -1;
+	}
+	if ((part = malloc(sizeof(*part))) == NULL)
+		err(1, "sweep");
+	memset(res, 0, sizeof(*res));
+	memset(&first, 0, sizeof(first));
+
+	while ((de = readdir(d)) != NULL) {
+		size_t		len = strlen(de->d_name);
+
+		if (strncmp(de->d_name, SWEEP_PREFIX, sizeof(SWEEP_PREFIX) - 1) != 0 ||
+		    len < sizeof(SWEEP_SUFFIX) ||
+		    strcmp(de->d_name + len - (sizeof(SWEEP_SUFFIX) - 1), SWEEP_SUFFIX) != 0)
+			continue;
+		snprintf(path, sizeof(path), "%s/%s", dir, de->d_name);
+		if (shard_read(path, &hdr, part) == -1) {
+			warnx("%s is not a shard of this version", path);
+			goto out;
+		}
+		if (seen == NULL) {
+			first = hdr;
+			n = hdr.nshards;
+			if (n < 1 || n > SWEEP_MAX_SHARDS || (seen = calloc(n, 1)) == NULL) {
+				warnx("%s has a bad shard count", path);
+				goto out;
+			}
+		} else if (hdr.key[0] != first.key[0] || hdr.key[1] != first.key[1] ||
+			   hdr.nshards != first.nshards) {
+			warnx("%s belongs to a different sweep", path);
+			goto out;
+		}
+		if (hdr.shard >= (uint32_t)n || seen[hdr.shard]) {
+			warnx("%s repeats or misnumbers shard %u", path, hdr.shard);
+			goto out;
+		}
+		seen[hdr.shard] = 1;
+		found++;
+
+		sim_merge_results(res, part);
+		policy_merge_stats(&res->policy, &part->policy);
+		res->elapsed += part->elapsed;
+		if (part->threads > res->threads)
+			res->threads = part->threads;
+		res->seed = part->seed;
+	}
+
+	if (seen == NULL) {
+		warnx("%s holds no shards", dir);
+		goto out;
+	}
+	if (found < n) {
+		char		list[128] = "";
+		size_t		used = 0;
+
+		for (int i = 0; i < n && used < sizeof(list) - 16; i++)
+			if (!seen[i])
+				used += snprintf(list + used, sizeof(list) - used, " %d", i);
+		warnx("%s is missing %d of %d shards:%s%s", dir, n - found, n, list,
+		      used >= sizeof(list) - 16 ? " ..." : "");
+		goto out;
+	}
+	if ((uint64_t)res->games != first.games) {
+		warnx("%s: the shards hold %ld of %llu games", dir, res->games,
+		      (unsigned long long)first.games);
+		goto out;
+	}
+	*nshards = n;
+	rv = 0;
+out:
+	closedir(d);
+	free(seen);
+	free(part);
+	return rv;
+}
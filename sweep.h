@@ -0,0 +1,67 @@
+/*
+ * BSD Zero Clause License
+ *
+ * Copyright (c) 2025 David M Crumpton david.m.crumpton [at] gmail [dot] com
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * sweep.h: a simulation split into shards that separate processes or
+ * machines can play, checkpointed to a directory and merged exactly
+ *
+ */
+
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <stdint.h>
+
+#include "cache.h"
+#include "policy.h"
+#include "simulate.h"
+
+#define SWEEP_MAGIC	0x57534642	/* "BFSW" */
+#define SWEEP_VERSION	1
+#define SWEEP_SHARDS	64
+#define SWEEP_MAX_SHARDS	100000
+
+/* A shard file is this header and the shard's sim_results */
+struct sweep_header {
+	uint32_t	magic;
+	uint16_t	version;
+	uint16_t	reserved;
+	uint32_t	shard;
+	uint32_t	nshards;
+	uint64_t	games;	/* in the whole sweep */
+	uint64_t	first;	/* game number of the shard's first game */
+	uint64_t	count;
+	uint64_t	key[2];	/* of the sweep, shared by all its shards */
+	uint64_t	size;	/* of the result that follows */
+};
+
+struct sweep {
+	const char     *dir;
+	long		games;
+	int		nshards;
+	int		daggerset;
+	int		threads;
+	struct cache_key key;
+};
+
+int		sweep_init(struct sweep * sw, const char *dir, long games, int nshards, int daggerset, int threads, const struct policy_config * cfg);
+void		sweep_range(const struct sweep * sw, int shard, uint64_t * first, long *count);
+int		sweep_run_shard(const struct sweep * sw, int shard);
+int		sweep_run(const struct sweep * sw, int *played, int *resumed);
+int		sweep_merge(const char *dir, struct sim_results * res, int *nshards);
+
+#endif				/* SWEEP_H */
@@ -0,0 +1,134 @@
+/*
+ * BSD Zero Clause License
+ *
+ * Copyright (c) 2025 David M Crumpton david.m.crumpton [at] gmail [dot] com
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * tables.c: builds the per turn lookup tables from the reference formulas
+ * in engine.c and patient.c, and checks them against those formulas
+ *
+ */
+#include <err.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "buffy.h"
+#include "engine.h"
+#include "packed.h"
+#include "patient.h"
+#include "tables.h"
+
+
+struct engine_rules engine_rules;
+const struct engine_rules *engine_live = &engine_rules;
+
+/*
+ * Build r's turn tables from its tools and species gains. Returns -1 when
+ * a tool's dip or effort does not fit the tables.
+ */
+int
+engine_rules_build(struct engine_rules * r)
+{
+	struct engine_tables *tb = &r->tables;
+
+	for (int t = 0; t < NUM_TOOLS; t++) {
+		const tool     *tl = &r->tools[t];
+
+		if (tl->dip_amount >= TBL_DIP || tl->dip_amount >= TBL_FLUORIDE || tl->effort >= TBL_EFFORT)
+			return -1;
+		for (int s = 0; s < NUM_PATIENTS; s++)
+			for (int e = 0; e < TBL_EFFORT; e++)
+				for (int f = 0; f < TBL_FLUORIDE; f++)
+					tb->gain[t][s][e][f] = health_gain_for(tl, &r->species[s], f, e);
+		for (int d = 0; d < TBL_DIP; d++)
+			tb->fluoride_used[t][d] = fluoride_used_for(tl, d);
+	}
+	for (int h = 0; h <= MAX_HEALTH; h++)
+		tb->health_pain[h] = (MAX_HEALTH - h) / 10;
+	for (int p = 0; p < TBL_PAIN; p++)
+		tb->mood[p] = pain_to_mood(p);
+	for (int p = 0; p < TBL_PATIENCE; p++)
+		tb->patience_level[p] = patience_to_level(p);
+	return 0;
+}
+
+/* The built-in rules, from tools[], species_gain[] and BONUS_* */
+void
+engine_tables_init(void)
+{
+	memcpy(engine_rules.tools, tools, sizeof(engine_rules.tools));
+	memcpy(engine_rules.species, species_gain, sizeof(engine_rules.species));
+	engine_rules.bonus.fang_cleaned = BONUS_FANG_CLEANED;
+	engine_rules.bonus.fang_health = BONUS_FANG_HEALTH;
+	engine_rules.bonus.turn_complete = BONUS_TURN_COMPLETE;
+	engine_rules.bonus.all_health = BONUS_ALL_HEALTH;
+	for (int t = 0; t < NUM_TOOLS; t++)
+		if (tools[t].dip_amount >= TBL_DIP || tools[t].dip_amount >= TBL_FLUORIDE ||
+		    tools[t].effort >= TBL_EFFORT)
+			errx(1, "%s does not fit the turn tables", tools[t].name);
+	engine_rules_build(&engine_rules);
+	engine_live = &engine_rules;
+
+	/* Not turn tables, but wanted by the same callers at startup */
+	packed_zobrist_init();
+	engine_deal_init();
+	patient_reactions_init();
+}
+
+#define CHECK(what, got, want, ...) do {				\
+	if ((got) != (want)) {						\
+		if (out != NULL && bad < 10)				\
+			fprintf(out, what ": table %d, formula %d\n",	\
+			    __VA_ARGS__, (int)(got), (int)(want));	\
+		bad++;							\
+	}								\
+	checked++;							\
+} while (0)
+
+/*
+ * Compare every table against its formula, well past the ends of the
+ * tables so the clamping is checked too. Returns the number of mismatches.
+ */
+long
+engine_tables_validate(FILE * out)
+{
+	game_state_type	state;
+	long		bad = 0, checked = 0;
+
+	memset(&state, 0, sizeof(state));
+	for (int t = 0; t < NUM_TOOLS; t++) {
+		state.tool_in_use = t;
+		for (int s = 0; s < NUM_PATIENTS; s++) {
+			state.patient_idx = s;
+			for (int e = 0; e <= 4 * TBL_EFFORT; e++)
+				for (int f = 0; f <= 4 * TBL_FLUORIDE; f++)
+					CHECK("gain tool %d species %d fluoride %d effort %d",
+					      TBL_GAIN(t, s, f, e), fang_health_gain_formula(&state, f, e), t, s, f, e);
+		}
+		for (int d = 0; d <= 1000; d++)
+			CHECK("fluoride used tool %d dip %d", TBL_FLUORIDE_USED(t, d), fluoride_used_formula(t, d), t, d);
+	}
+	for (int h = 0; h <= MAX_HEALTH; h++)
+		CHECK("pain for health %d", TBL_HEALTH_PAIN(h), (100 - h) / 10, h);
+	for (int p = -100; p <= 1000; p++)
+		CHECK("mood for pain %d", TBL_MOOD(p), pain_to_mood(p < 0 ? 0 : p), p);
+	for (int p = -100; p <= 1000; p++)
+		CHECK("patience level for patience %d", TBL_PATIENCE_LEVEL(p), patience_to_level(p < 0 ? 0 : p), p);
+
+	if (out != NULL)
+		fprintf(out, "Checked %ld table entries against the formulas: %ld mismatch%s\n",
+			checked, bad, bad == 1 ? "" : "es");
+	return bad;
+}
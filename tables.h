@@ -0,0 +1,100 @@
+/*
+ * BSD Zero Clause License
+ *
+ * Copyright (c) 2025 David M Crumpton david.m.crumpton [at] gmail [dot] com
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * tables.h: every per turn formula precomputed into dense tables, so a turn
+ * is a handful of clamped loads instead of divisions and species branches
+ *
+ */
+
+#ifndef TABLES_H
+#define TABLES_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "buffy.h"
+#include "engine.h"
+
+/*
+ * Every input is clamped into its table. Tools cap dip and effort well
+ * below these sizes, so the last slot already holds the capped result;
+ * pain at or above TBL_PAIN - 1 is always angry and patience at or above
+ * TBL_PATIENCE - 1 is always bliss.
+ */
+#define TBL_FLUORIDE	16	/* fluoride carried on the tool */
+#define TBL_EFFORT	16
+#define TBL_DIP		16
+#define TBL_PAIN	16
+#define TBL_PATIENCE	16
+
+struct engine_tables {
+	int16_t		gain[NUM_TOOLS][NUM_PATIENTS][TBL_EFFORT][TBL_FLUORIDE];
+	uint16_t	fluoride_used[NUM_TOOLS][TBL_DIP];
+	uint8_t		health_pain[MAX_HEALTH + 1];
+	uint8_t		mood[TBL_PAIN];
+	uint8_t		patience_level[TBL_PATIENCE];
+};
+
+/* What each event scores, BONUS_* unless a balance file says otherwise */
+struct engine_bonus {
+	int		fang_cleaned;
+	int		fang_health;
+	int		turn_complete;
+	int		all_health;
+};
+
+/*
+ * Everything a turn reads: the turn tables and the tools, species gains
+ * and bonuses they were built from. Play reads the rules through
+ * engine_live, which points at engine_rules until a balance file is
+ * watched (watch.c); only the thread playing the game moves it, between
+ * strokes.
+ */
+struct engine_rules {
+	struct engine_tables tables;
+	tool		tools[NUM_TOOLS];
+	struct species_gain species[NUM_PATIENTS];
+	struct engine_bonus bonus;
+};
+
+extern struct engine_rules engine_rules;
+extern const struct engine_rules *engine_live;
+
+static inline int
+tbl_clamp(int v, int hi)
+{
+	v = v < 0 ? 0 : v;
+	return v > hi ? hi : v;
+}
+
+#define TBL_GAIN(tool, species, fluoride, effort) \
+	(engine_live->tables.gain[(tool)][(species)][tbl_clamp((effort), TBL_EFFORT - 1)][tbl_clamp((fluoride), TBL_FLUORIDE - 1)])
+#define TBL_FLUORIDE_USED(tool, dip) \
+	(engine_live->tables.fluoride_used[(tool)][tbl_clamp((dip), TBL_DIP - 1)])
+#define TBL_HEALTH_PAIN(health) \
+	(engine_live->tables.health_pain[tbl_clamp((health), MAX_HEALTH)])
+#define TBL_MOOD(pain) \
+	(engine_live->tables.mood[tbl_clamp((pain), TBL_PAIN - 1)])
+#define TBL_PATIENCE_LEVEL(patience) \
+	(engine_live->tables.patience_level[tbl_clamp((patience), TBL_PATIENCE - 1)])
+
+void		engine_tables_init(void);
+int		engine_rules_build(struct engine_rules * r);
+long		engine_tables_validate(FILE * out);
+
+#endif				/* TABLES_H */
@@ -0,0 +1,323 @@
+/*
+ * BSD Zero Clause License
+ *
+ * Copyright (c) 2025 David M Crumpton david.m.crumpton [at] gmail [dot] com
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * tournament.c: a round robin between policies on common random numbers.
+ * Every policy plays every deal, game g dealt from stream g of the seed,
+ * and each pair is compared deal by deal: winning the game beats losing
+ * it, and between two wins or two losses the higher score is ahead. Since
+ * a policy's play on a deal does not depend on its opponent, one game per
+ * policy and deal serves all of its pairings. Because both sides of a
+ * pairing face the same fangs, tool and species, the luck of the deal
+ * cancels and a difference shows up in far fewer games than independent
+ * samples would need. Ratings are fitted with Bradley-Terry and given on
+ * the Elo scale; their intervals come from refitting on separate sections
+ * of the games.
+ *
+ */
+#include <err.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "buffy.h"
+#include "policy.h"
+#include "pool.h"
+#include "rng.h"
+#include "simulate.h"
+#include "tournament.h"
+
+#define TOURNAMENT_CHUNK	64
+#define T_975_19	2.093	/* Student's t for a 95% interval from 20 sections */
+
+struct tournament_shard {
+	_Alignas(CACHE_LINE) long wins[TOURNAMENT_MAX];
+	long long	score_sum[TOURNAMENT_MAX];
+	long		beat[TOURNAMENT_MAX][TOURNAMENT_MAX];
+	long		section_beat[TOURNAMENT_SECTIONS][TOURNAMENT_MAX][TOURNAMENT_MAX];
+	long		discord[TOURNAMENT_MAX][TOURNAMENT_MAX];
+	struct rng	rng;
+	struct policy  *policy[TOURNAMENT_MAX];
+};
+
+struct tournament_job {
+	struct tournament *t;
+	struct tournament_shard *shards;
+};
+
+
+/*
+ * Parse a comma separated list of policy names. Each one is configured
+ * like base, which carries the --optimal table and the MCTS budgets.
+ */
+int
+tournament_init(struct tournament * t, const char *list, const struct policy_config * base)
+{
+	char	       *name, *last;
+
+	memset(t, 0, sizeof(*t));
+	t->games = TOURNAMENT_GAMES;
+	t->threads = 1;
+	if (strlcpy(t->names, list, sizeof(t->names)) >= sizeof(t->names)) {
+		warnx("tournament list too long");
+		return -1;
+	}
+	for (name = strtok_r(t->names, ",", &last); name != NULL; name = strtok_r(NULL, ",", &last)) {
+		if (!policy_known(name)) {
+			warnx("%s is not a policy", name);
+			return -1;
+		}
+		if (strcmp(name, "optimal") == 0 && (base == NULL || base->table == NULL)) {
+			warnx("the optimal policy needs a table from --optimal");
+			return -1;
+		}
+		for (int i = 0; i < t->npolicies; i++)
+			if (strcmp(t->cfg[i].name, name) == 0) {
+				warnx("%s is listed twice", name);
+				return -1;
+			}
+		if (t->npolicies == TOURNAMENT_MAX) {
+			warnx("a tournament takes at most %d policies", TOURNAMENT_MAX);
+			return -1;
+		}
+		if (base != NULL)
+			t->cfg[t->npolicies] = *base;
+		t->cfg[t->npolicies++].name = name;
+	}
+	if (t->npolicies < 2) {
+		warnx("a tournament needs at least two policies");
+		return -1;
+	}
+	return 0;
+}
+
+static void
+tournament_worker(void *arg, int worker, uint64_t lo, uint64_t hi)
+{
+	struct tournament_job *job = arg;
+	struct tournament *t = job->t;
+	struct tournament_shard *shard = &job->shards[worker];
+	game_state_type	state;
+	patient_type	pat;
+	int		n = t->npolicies;
+	int		won[TOURNAMENT_MAX], score[TOURNAMENT_MAX];
+
+	for (int i = 0; i < n; i++)
+		if (shard->policy[i] == NULL)
+			shard->policy[i] = policy_new(&t->cfg[i]);
+
+	rng_set_stream(&shard->rng);
+	for (uint64_t g = lo; g < hi; g++) {
+		int		s = (int)(g * TOURNAMENT_SECTIONS / t->games);
+
+		for (int i = 0; i < n; i++) {
+			rng_seed(&shard->rng, t->seed, g);
+			memset(&state, 0, sizeof(state));
+			memset(&pat, 0, sizeof(pat));
+			state.daggerset = t->daggerset;
+			won[i] = sim_play_game(&state, &pat, shard->policy[i]) == SIM_WIN;
+			score[i] = state.score;
+			shard->wins[i] += won[i];
+			shard->score_sum[i] += state.score;
+		}
+		for (int i = 0; i < n; i++)
+			for (int j = 0; j < n; j++) {
+				if (won[i] > won[j] || (won[i] == won[j] && score[i] > score[j])) {
+					shard->beat[i][j]++;
+					shard->section_beat[s][i][j]++;
+				}
+				shard->discord[i][j] += won[i] != won[j];
+			}
+	}
+	rng_set_stream(NULL);
+}
+
+/*
+ * Points of i against j from deals won outright, a level deal being half
+ * a point to each
+ */
+static void
+points(const long beat[TOURNAMENT_MAX][TOURNAMENT_MAX], int n, long games, long w[TOURNAMENT_MAX][TOURNAMENT_MAX])
+{
+	for (int i = 0; i < n; i++)
+		for (int j = 0; j < n; j++)
+			w[i][j] = i == j ? 0 : 2 * beat[i][j] + (games - beat[i][j] - beat[j][i]);
+}
+
+/*
+ * Fit Bradley-Terry strengths to half points by minorization-maximization
+ * and return them as Elo ratings averaging 0. One virtual level deal per
+ * pair keeps a policy that never got ahead finite.
+ */
+void
+tournament_ratings(const long w[TOURNAMENT_MAX][TOURNAMENT_MAX], int n, double *elo)
+{
+	double		p[TOURNAMENT_MAX], next[TOURNAMENT_MAX];
+
+	for (int i = 0; i < n; i++)
+		p[i] = 1;
+	for (int it = 0; it < 10000; it++) {
+		double		logsum = 0, change = 0;
+
+		for (int i = 0; i < n; i++) {
+			double		won = 0, den = 0;
+
+			for (int j = 0; j < n; j++) {
+				if (j == i)
+					continue;
+				won += w[i][j] / 2.0 + 0.5;
+				den += ((w[i][j] + w[j][i]) / 2.0 + 1) / (p[i] + p[j]);
+			}
+			next[i] = won / den;
+			logsum += log(next[i]);
+		}
+		for (int i = 0; i < n; i++) {
+			double		q = next[i] * exp(-logsum / n);
+
+			if (fabs(log(q / p[i])) > change)
+				change = fabs(log(q / p[i]));
+			p[i] = q;
+		}
+		if (change < 1e-12)
+			break;
+	}
+	for (int i = 0; i < n; i++)
+		elo[i] = 400 * log10(p[i]);
+}
+
+/*
+ * Play every policy on games 0..games - 1 of the seed on threads workers,
+ * then rate them. The results do not depend on the thread count.
+ */
+void
+tournament_run(struct tournament * t)
+{
+	struct tournament_job job;
+	struct timespec	start, end;
+	long		w[TOURNAMENT_MAX][TOURNAMENT_MAX];
+	double		section[TOURNAMENT_SECTIONS][TOURNAMENT_MAX];
+	int		n = t->npolicies;
+
+	if (t->games < TOURNAMENT_SECTIONS)
+		errx(1, "a tournament needs at least %d games", TOURNAMENT_SECTIONS);
+	if (t->threads < 1)
+		t->threads = 1;
+	t->seed = rng_get_seed();
+	job.t = t;
+	if ((job.shards = aligned_alloc(CACHE_LINE, sizeof(*job.shards) * t->threads)) == NULL)
+		err(1, "tournament shards");
+	memset(job.shards, 0, sizeof(*job.shards) * t->threads);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	pool_run(t->threads, t->games, TOURNAMENT_CHUNK, tournament_worker, &job);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	t->elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+	for (int k = 0; k < t->threads; k++) {
+		struct tournament_shard *sh = &job.shards[k];
+
+		for (int i = 0; i < n; i++) {
+			t->wins[i] += sh->wins[i];
+			t->score_sum[i] += sh->score_sum[i];
+			for (int j = 0; j < n; j++) {
+				t->beat[i][j] += sh->beat[i][j];
+				t->discord[i][j] += sh->discord[i][j];
+				for (int s = 0; s < TOURNAMENT_SECTIONS; s++)
+					t->section_beat[s][i][j] += sh->section_beat[s][i][j];
+			}
+			policy_free(sh->policy[i]);
+		}
+	}
+	free(job.shards);
+
+	points(t->beat, n, t->games, w);
+	tournament_ratings(w, n, t->elo);
+
+	/* Section s holds the games g with g * SECTIONS / games == s */
+	for (int s = 0; s < TOURNAMENT_SECTIONS; s++) {
+		long		lo = (t->games * s + TOURNAMENT_SECTIONS - 1) / TOURNAMENT_SECTIONS;
+		long		hi = (t->games * (s + 1) + TOURNAMENT_SECTIONS - 1) / TOURNAMENT_SECTIONS;
+
+		points(t->section_beat[s], n, hi - lo, w);
+		tournament_ratings(w, n, section[s]);
+	}
+	for (int i = 0; i < n; i++) {
+		double		mean = 0, var = 0;
+
+		for (int s = 0; s < TOURNAMENT_SECTIONS; s++)
+			mean += section[s][i] / TOURNAMENT_SECTIONS;
+		for (int s = 0; s < TOURNAMENT_SECTIONS; s++)
+			var += (section[s][i] - mean) * (section[s][i] - mean) / (TOURNAMENT_SECTIONS - 1);
+		t->elo_ci[i] = T_975_19 * sqrt(var / TOURNAMENT_SECTIONS);
+	}
+}
+
+/*
+ * The ratings, then every pair: how often each side was ahead on the same
+ * deal, the difference in win rate with its paired 95% interval, and how
+ * many times more games independent samples would need for the same
+ * interval.
+ */
+void
+print_tournament(const struct tournament * t, FILE * out)
+{
+	int		order[TOURNAMENT_MAX];
+	int		n = t->npolicies;
+	double		g = (double)t->games;
+
+	/* Best rated first */
+	for (int i = 0; i < n; i++) {
+		int		k = i;
+
+		for (; k > 0 && t->elo[order[k - 1]] < t->elo[i]; k--)
+			order[k] = order[k - 1];
+		order[k] = i;
+	}
+
+	fprintf(out, "Tournament of %d policies on the same %ld deals in %.3f s on %d thread%s\n",
+		n, t->games, t->elapsed, t->threads, t->threads == 1 ? "" : "s");
+	fprintf(out, "  Seed: %#llx\n", (unsigned long long)t->seed);
+	fprintf(out, "  %-14s %6s %7s %8s %10s\n", "Policy", "Elo", "95% CI", "Wins", "Mean score");
+	for (int k = 0; k < n; k++) {
+		int		i = order[k];
+
+		fprintf(out, "  %-14s %+6.0f %4s%-3.0f %7.2f%% %10.2f\n", t->cfg[i].name, t->elo[i], "+/-",
+			t->elo_ci[i], 100.0 * t->wins[i] / g, t->score_sum[i] / g);
+	}
+
+	fprintf(out, "  %-14s %-14s %7s %7s %7s %9s %9s %10s\n", "A", "B", "A ahead", "B ahead",
+		"level", "win diff", "95% CI", "games x");
+	for (int x = 0; x < n; x++)
+		for (int y = x + 1; y < n; y++) {
+			int		i = order[x], j = order[y];
+			double		pi = t->wins[i] / g, pj = t->wins[j] / g;
+			double		diff = pi - pj;
+			double		paired = t->discord[i][j] / g - diff * diff;
+			double		independent = pi * (1 - pi) + pj * (1 - pj);
+
+			fprintf(out, "  %-14s %-14s %7ld %7ld %7ld %+8.2f%% %8.2f%% ", t->cfg[i].name,
+				t->cfg[j].name, t->beat[i][j], t->beat[j][i],
+				t->games - t->beat[i][j] - t->beat[j][i], 100 * diff,
+				100 * 1.96 * sqrt(paired / g));
+			if (paired > 0)
+				fprintf(out, "%10.1f\n", independent / paired);
+			else
+				fprintf(out, "%10s\n", "-");
+		}
+}
@@ -0,0 +1,62 @@
+/*
+ * BSD Zero Clause License
+ *
+ * Copyright (c) 2025 David M Crumpton david.m.crumpton [at] gmail [dot] com
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * tournament.h: policies played against each other on the same deals
+ *
+ */
+
+#ifndef TOURNAMENT_H
+#define TOURNAMENT_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "policy.h"
+
+#define TOURNAMENT_MAX		8	/* policies */
+#define TOURNAMENT_GAMES	10000
+#define TOURNAMENT_SECTIONS	20	/* batches of games the intervals come from */
+
+struct tournament {
+	int		npolicies;
+	struct policy_config cfg[TOURNAMENT_MAX];
+	char		names[256];	/* cfg[].name point in here */
+	long		games;
+	int		daggerset;
+	int		threads;
+	uint64_t	seed;
+	double		elapsed;
+
+	long		wins[TOURNAMENT_MAX];
+	long long	score_sum[TOURNAMENT_MAX];
+	/* deals where i did better than j, in all and in each section */
+	long		beat[TOURNAMENT_MAX][TOURNAMENT_MAX];
+	long		section_beat[TOURNAMENT_SECTIONS][TOURNAMENT_MAX][TOURNAMENT_MAX];
+	/* deals that exactly one of i and j won */
+	long		discord[TOURNAMENT_MAX][TOURNAMENT_MAX];
+
+	double		elo[TOURNAMENT_MAX];
+	double		elo_ci[TOURNAMENT_MAX];	/* half width of the 95% interval */
+};
+
+int		tournament_init(struct tournament * t, const char *list, const struct policy_config * base);
+void		tournament_run(struct tournament * t);
+void		tournament_ratings(const long w[TOURNAMENT_MAX][TOURNAMENT_MAX], int n, double *elo);
+void		print_tournament(const struct tournament * t, FILE * out);
+
+#endif				/* TOURNAMENT_H */
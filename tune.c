@@ -0,0 +1,489 @@
+/*
+ * BSD Zero Clause License
+ *
+ * Copyright (c) 2025 David M Crumpton david.m.crumpton [at] gmail [dot] com
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * tune.c: successive halving over the balance constants. Each bracket
+ * draws a field of candidates, half anywhere in the bounds and half near
+ * the best so far, and plays every one a few hundred batch games per tool
+ * and species. The worse half is dropped and the rest play twice as many
+ * games, until one is left to seed the next bracket with a tighter
+ * neighbourhood. Every candidate is dealt the same games, so they are
+ * compared on equal luck, and each candidate's tool and species pairs are
+ * spread over the thread pool.
+ *
+ */
+#include <err.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#include "batch.h"
+#include "buffy.h"
+#include "engine.h"
+#include "pool.h"
+#include "rng.h"
+#include "simulate.h"
+#include "tables.h"
+#include "tune.h"
+
+#define TUNE_TOOLS	3	/* the tools a game can be dealt */
+#define TUNE_CELLS	(TUNE_TOOLS * NUM_PATIENTS)
+#define TUNE_STREAM	0x74756e65	/* candidate draws, away from the game streams */
+
+static const char *tool_keys[NUM_TOOLS] = {"fingernail", "rock", "shark", "wooden", "bronze", "steel"};
+
+/* What may be tuned and how far, kept inside the turn tables */
+static const struct tune_field {
+	const char     *name;
+	size_t		offset;
+	int		min;
+	int		max;
+}		tool_fields[] = {
+	{"length", offsetof(tool, length), 1, 64},
+	{"dip", offsetof(tool, dip_amount), 1, TBL_DIP - 1},
+	{"effort", offsetof(tool, effort), 0, TBL_EFFORT - 1},
+	{"effectiveness", offsetof(tool, effectiveness), 0, 100},
+	{"durability", offsetof(tool, durability), 0, 1000},
+}, species_fields[] = {
+	{"percent", offsetof(struct species_gain, percent), 0, 400},
+	{"bonus", offsetof(struct species_gain, bonus), -50, 50},
+};
+
+struct tune_job {
+	const struct batch_cell *cells;	/* TUNE_CELLS per candidate */
+	const int      *fluoride;	/* per candidate */
+	long	       *wins;
+	struct batch  **batches;	/* per worker */
+	long		games;
+	uint64_t	seed;
+};
+
+struct ranked {
+	double		loss;
+	int		idx;
+};
+
+
+static int     *
+field(struct tune_config * cfg, size_t offset)
+{
+	return (int *)((char *)cfg + offset);
+}
+
+void
+tune_defaults(struct tune_config * cfg)
+{
+	cfg->fluoride = DEFAULT_FLUORIDE;
+	memcpy(cfg->tools, tools, sizeof(cfg->tools));
+	memcpy(cfg->species, species_gain, sizeof(cfg->species));
+}
+
+void
+tune_init(struct tune * t)
+{
+	memset(t, 0, sizeof(*t));
+	for (int i = 0; i <= NUM_PATIENTS; i++)
+		t->target[i] = -1;
+	t->candidates = TUNE_CANDIDATES;
+	t->threads = 1;
+}
+
+/* Find a parameter by name: fluoride, <species>.<field> or <tool>.<field> */
+int
+tune_lookup(const char *name, size_t * offset, int *min, int *max)
+{
+	const char     *dot = strchr(name, '.');
+	size_t		len = dot != NULL ? (size_t)(dot - name) : 0;
+
+	if (strcmp(name, "fluoride") == 0) {
+		*offset = offsetof(struct tune_config, fluoride);
+		*min = 1;
+		*max = 10000;
+		return 0;
+	}
+	if (dot == NULL)
+		return -1;
+	for (int s = 0; s < NUM_PATIENTS; s++) {
+		if (strlen(patients[s].species) != len || strncasecmp(name, patients[s].species, len) != 0)
+			continue;
+		for (size_t f = 0; f < sizeof(species_fields) / sizeof(species_fields[0]); f++)
+			if (strcmp(dot + 1, species_fields[f].name) == 0) {
+				*offset = offsetof(struct tune_config, species) +
+					s * sizeof(struct species_gain) + species_fields[f].offset;
+				*min = species_fields[f].min;
+				*max = species_fields[f].max;
+				return 0;
+			}
+	}
+	for (int i = 0; i < NUM_TOOLS; i++) {
+		if (strlen(tool_keys[i]) != len || strncmp(name, tool_keys[i], len) != 0)
+			continue;
+		for (size_t f = 0; f < sizeof(tool_fields) / sizeof(tool_fields[0]); f++)
+			if (strcmp(dot + 1, tool_fields[f].name) == 0) {
+				*offset = offsetof(struct tune_config, tools) +
+					i * sizeof(tool) + tool_fields[f].offset;
+				*min = tool_fields[f].min;
+				*max = tool_fields[f].max;
+				return 0;
+			}
+	}
+	return -1;
+}
+
+/* "name=lo:hi,..." */
+int
+tune_parse_params(struct tune * t, const char *spec)
+{
+	char	       *copy, *item, *last;
+	int		rv = 0;
+
+	if ((copy = strdup(spec)) == NULL)
+		err(1, "tune");
+	for (item = strtok_r(copy, ",", &last); item != NULL; item = strtok_r(NULL, ",", &last)) {
+		struct tune_param *p = &t->params[t->nparams];
+		char	       *eq = strchr(item, '=');
+		int		min, max;
+		char		end;
+
+		if (t->nparams == TUNE_MAX_PARAMS) {
+			warnx("at most %d parameters can be tuned", TUNE_MAX_PARAMS);
+			rv = -1;
+			break;
+		}
+		if (eq == NULL || sscanf(eq + 1, "%d:%d%c", &p->lo, &p->hi, &end) != 2) {
+			warnx("%s: want name=low:high", item);
+			rv = -1;
+			break;
+		}
+		*eq = '\0';
+		if (tune_lookup(item, &p->offset, &min, &max) == -1) {
+			warnx("%s: not a balance constant", item);
+			rv = -1;
+			break;
+		}
+		if (p->lo > p->hi || p->lo < min || p->hi > max) {
+			warnx("%s: bounds must fall within %d:%d, low first", item, min, max);
+			rv = -1;
+			break;
+		}
+		strlcpy(p->name, item, sizeof(p->name));
+		t->nparams++;
+	}
+	free(copy);
+	return rv;
+}
+
+/* "species=rate,...", where species may be "all" */
+int
+tune_parse_targets(struct tune * t, const char *spec)
+{
+	char	       *copy, *item, *last, *end;
+	int		rv = 0;
+
+	if ((copy = strdup(spec)) == NULL)
+		err(1, "tune");
+	for (item = strtok_r(copy, ",", &last); item != NULL; item = strtok_r(NULL, ",", &last)) {
+		char	       *eq = strchr(item, '=');
+		int		which = -1;
+		double		rate;
+
+		if (eq == NULL) {
+			warnx("%s: want species=win rate", item);
+			rv = -1;
+			break;
+		}
+		*eq = '\0';
+		rate = strtod(eq + 1, &end);
+		if (end == eq + 1 || *end != '\0' || rate < 0 || rate > 1) {
+			warnx("%s: the win rate must be from 0 to 1", item);
+			rv = -1;
+			break;
+		}
+		if (strcasecmp(item, "all") == 0)
+			which = TUNE_ALL;
+		for (int s = 0; s < NUM_PATIENTS; s++)
+			if (strcasecmp(item, patients[s].species) == 0)
+				which = s;
+		if (which == -1) {
+			warnx("%s: not a species", item);
+			rv = -1;
+			break;
+		}
+		t->target[which] = rate;
+	}
+	free(copy);
+	return rv;
+}
+
+/* The batch engine's view of a candidate's tool and species */
+static void
+candidate_cell(const struct tune_config * cfg, int tool_idx, int species, struct batch_cell * cell)
+{
+	const tool     *t = &cfg->tools[tool_idx];
+
+	batch_cell_init(cell, tool_idx, species);
+	cell->dip_amount = t->dip_amount;
+	for (int d = 0; d < TBL_DIP; d++) {
+		cell->used[d] = fluoride_used_for(t, d);
+		cell->gain[d] = health_gain_for(t, &cfg->species[species], cell->used[d], t->effort);
+	}
+}
+
+static void
+tune_worker(void *arg, int worker, uint64_t lo, uint64_t hi)
+{
+	struct tune_job *job = arg;
+	uint64_t	numbers[BATCH_LANES];
+
+	if (job->batches[worker] == NULL)
+		job->batches[worker] = batch_new(BATCH_LANES);
+	for (uint64_t item = lo; item < hi; item++) {
+		struct batch   *b = job->batches[worker];
+		long		wins = 0;
+
+		for (long k = 0; k < job->games; k += BATCH_LANES) {
+			int		n = job->games - k < BATCH_LANES ? (int)(job->games - k) : BATCH_LANES;
+
+			for (int i = 0; i < n; i++)
+				numbers[i] = (uint64_t)(k + i);
+			batch_deal(b, &job->cells[item], n, job->seed, numbers);
+			for (int i = 0; i < n; i++)
+				b->fluoride[i] = job->fluoride[item / TUNE_CELLS];
+			batch_play(b, BATCH_KERNEL_AUTO);
+			for (int i = 0; i < n; i++)
+				wins += b->status[i] == SIM_WIN;
+		}
+		job->wins[item] = wins;
+	}
+}
+
+/*
+ * Play games of every dealable tool and species for n candidates and
+ * score each against the targets: the sum of squared win rate misses.
+ */
+static void
+evaluate(struct tune * t, struct batch ** batches, const struct tune_config * cands, int n,
+	 long games, double (*win)[NUM_PATIENTS + 1], double *loss)
+{
+	struct tune_job job;
+	struct batch_cell *cells;
+	long	       *wins;
+	int	       *fluoride;
+	int		first = t->daggerset ? 3 : 0;
+
+	if ((cells = calloc((size_t)n * TUNE_CELLS, sizeof(*cells))) == NULL ||
+	    (wins = calloc((size_t)n * TUNE_CELLS, sizeof(*wins))) == NULL ||
+	    (fluoride = calloc(n, sizeof(*fluoride))) == NULL)
+		err(1, "tune");
+	for (int c = 0; c < n; c++) {
+		fluoride[c] = cands[c].fluoride;
+		for (int j = 0; j < TUNE_CELLS; j++)
+			candidate_cell(&cands[c], first + j / NUM_PATIENTS, j % NUM_PATIENTS,
+				       &cells[c * TUNE_CELLS + j]);
+	}
+	job.cells = cells;
+	job.fluoride = fluoride;
+	job.wins = wins;
+	job.batches = batches;
+	job.games = games;
+	job.seed = t->seed;
+	pool_run(t->threads, (uint64_t)n * TUNE_CELLS, 1, tune_worker, &job);
+
+	for (int c = 0; c < n; c++) {
+		long		all = 0;
+
+		loss[c] = 0;
+		for (int s = 0; s < NUM_PATIENTS; s++) {
+			long		w = 0;
+
+			for (int k = 0; k < TUNE_TOOLS; k++)
+				w += wins[c * TUNE_CELLS + k * NUM_PATIENTS + s];
+			all += w;
+			win[c][s] = (double)w / (TUNE_TOOLS * games);
+		}
+		win[c][TUNE_ALL] = (double)all / (TUNE_CELLS * games);
+		for (int s = 0; s <= TUNE_ALL; s++)
+			if (t->target[s] >= 0)
+				loss[c] += (win[c][s] - t->target[s]) * (win[c][s] - t->target[s]);
+	}
+	t->games += (long)n * TUNE_CELLS * games;
+	t->evaluations += n;
+	free(cells);
+	free(wins);
+	free(fluoride);
+}
+
+static int
+by_loss(const void *a, const void *b)
+{
+	const struct ranked *x = a, *y = b;
+
+	if (x->loss != y->loss)
+		return x->loss < y->loss ? -1 : 1;
+	return x->idx - y->idx;
+}
+
+static void
+clamp_params(const struct tune * t, struct tune_config * cfg)
+{
+	for (int i = 0; i < t->nparams; i++) {
+		const struct tune_param *p = &t->params[i];
+		int	       *v = field(cfg, p->offset);
+
+		*v = *v < p->lo ? p->lo : *v > p->hi ? p->hi : *v;
+	}
+}
+
+/*
+ * A fresh candidate: anywhere in the bounds when shift is negative,
+ * otherwise within a (hi - lo) >> shift step of around.
+ */
+static void
+sample(const struct tune * t, struct rng * r, const struct tune_config * around, int shift,
+       struct tune_config * out)
+{
+	*out = *around;
+	for (int i = 0; i < t->nparams; i++) {
+		const struct tune_param *p = &t->params[i];
+		int	       *v = field(out, p->offset);
+
+		if (shift < 0) {
+			*v = p->lo + (int)rng_uniform_r(r, (uint32_t)(p->hi - p->lo + 1));
+		} else {
+			int		step = (p->hi - p->lo) >> shift;
+
+			step = step < 1 ? 1 : step;
+			*v += (int)rng_uniform_r(r, (uint32_t)(2 * step + 1)) - step;
+		}
+	}
+	clamp_params(t, out);
+}
+
+void
+tune_run(struct tune * t)
+{
+	struct tune_config *cands, incumbent, pair[2];
+	struct ranked  *rank;
+	struct batch  **batches;
+	double		(*win)[NUM_PATIENTS + 1], *loss, pwin[2][NUM_PATIENTS + 1], ploss[2];
+	struct rng	r;
+	struct timespec	start, end;
+	int		n = t->candidates < 2 ? 2 : t->candidates;
+	long		games = TUNE_MIN_GAMES;
+
+	if ((cands = calloc(n, sizeof(*cands))) == NULL ||
+	    (rank = calloc(n, sizeof(*rank))) == NULL ||
+	    (win = calloc(n, sizeof(*win))) == NULL ||
+	    (loss = calloc(n, sizeof(*loss))) == NULL ||
+	    (batches = calloc(t->threads, sizeof(*batches))) == NULL)
+		err(1, "tune");
+	t->seed = rng_get_seed();
+	rng_seed(&r, t->seed, TUNE_STREAM);
+	tune_defaults(&t->baseline);
+
+	/* The current constants, pulled into the bounds, open the search */
+	incumbent = t->baseline;
+	clamp_params(t, &incumbent);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int bracket = 0; bracket < TUNE_BRACKETS; bracket++) {
+		int		alive = n;
+
+		cands[0] = incumbent;
+		for (int i = 1; i < n; i++)
+			sample(t, &r, &incumbent, i % 2 ? -1 : bracket + 1, &cands[i]);
+
+		for (games = TUNE_MIN_GAMES; alive > 1; games *= 2) {
+			struct tune_config *next;
+
+			evaluate(t, batches, cands, alive, games, win, loss);
+			for (int i = 0; i < alive; i++) {
+				rank[i].loss = loss[i];
+				rank[i].idx = i;
+			}
+			qsort(rank, alive, sizeof(*rank), by_loss);
+
+			/* Keep the better half, best first */
+			if ((next = calloc(alive, sizeof(*next))) == NULL)
+				err(1, "tune");
+			for (int i = 0; i < (alive + 1) / 2; i++)
+				next[i] = cands[rank[i].idx];
+			t->cut += alive - (alive + 1) / 2;
+			alive = (alive + 1) / 2;
+			memcpy(cands, next, alive * sizeof(*cands));
+			free(next);
+		}
+		incumbent = cands[0];
+	}
+
+	/* The winner against the constants in the tree, on the same deals */
+	pair[0] = incumbent;
+	pair[1] = t->baseline;
+	evaluate(t, batches, pair, 2, games, pwin, ploss);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	t->best = ploss[1] < ploss[0] ? t->baseline : incumbent;
+	memcpy(t->best_win, pwin[ploss[1] < ploss[0]], sizeof(t->best_win));
+	t->best_loss = ploss[ploss[1] < ploss[0]];
+	memcpy(t->baseline_win, pwin[1], sizeof(t->baseline_win));
+	t->baseline_loss = ploss[1];
+	t->final_games = games;
+	t->elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+	for (int i = 0; i < t->threads; i++)
+		batch_free(batches[i]);
+	free(batches);
+	free(cands);
+	free(rank);
+	free(win);
+	free(loss);
+}
+
+void
+print_tune(const struct tune * t, FILE * out)
+{
+	struct tune_config best = t->best, base = t->baseline;
+
+	fprintf(out, "Tuned %d parameter%s in %.3f s on %d thread%s: %ld evaluations, "
+		"%ld candidates cut early, %ld games\n", t->nparams, t->nparams == 1 ? "" : "s",
+		t->elapsed, t->threads, t->threads == 1 ? "" : "s", t->evaluations, t->cut, t->games);
+	fprintf(out, "  Seed: %#llx, %ld games per tool and species behind the figures below\n",
+		(unsigned long long)t->seed, t->final_games);
+	fprintf(out, "  Loss: %.6f, was %.6f\n", t->best_loss, t->baseline_loss);
+	fprintf(out, "%-24s %7s %7s %13s\n", "Parameter", "Value", "Was", "Bounds");
+	for (int i = 0; i < t->nparams; i++) {
+		const struct tune_param *p = &t->params[i];
+
+		char		bounds[32];
+
+		snprintf(bounds, sizeof(bounds), "%d:%d", p->lo, p->hi);
+		fprintf(out, "%-24s %7d %7d %13s\n", p->name, *field(&best, p->offset),
+			*field(&base, p->offset), bounds);
+	}
+	fprintf(out, "%-24s %7s %7s %7s\n", "Win rate", "Target", "Tuned", "Was");
+	for (int s = 0; s <= TUNE_ALL; s++) {
+		char		goal[16] = "-";
+
+		if (t->target[s] >= 0)
+			snprintf(goal, sizeof(goal), "%.3f", t->target[s]);
+		fprintf(out, "%-24s %7s %7.3f %7.3f\n", s == TUNE_ALL ? "All" : patients[s].species,
+			goal, t->best_win[s], t->baseline_win[s]);
+	}
+}
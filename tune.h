@@ -0,0 +1,85 @@
+/*
+ * BSD Zero Clause License
+ *
+ * Copyright (c) 2025 David M Crumpton david.m.crumpton [at] gmail [dot] com
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * tune.h: search chosen balance constants for values that hit target win
+ * rates
+ *
+ */
+
+#ifndef TUNE_H
+#define TUNE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "buffy.h"
+#include "engine.h"
+
+#define TUNE_MAX_PARAMS		32
+#define TUNE_CANDIDATES		64	/* per bracket unless --tune-candidates */
+#define TUNE_BRACKETS		4
+#define TUNE_MIN_GAMES		256	/* per tool and species on the first rung */
+#define TUNE_ALL		NUM_PATIENTS	/* target index of the overall win rate */
+
+/* The constants a candidate may change */
+struct tune_config {
+	int		fluoride;
+	tool		tools[NUM_TOOLS];
+	struct species_gain species[NUM_PATIENTS];
+};
+
+struct tune_param {
+	char		name[32];
+	size_t		offset;	/* of the int in struct tune_config */
+	int		lo;
+	int		hi;
+};
+
+struct tune {
+	struct tune_param params[TUNE_MAX_PARAMS];
+	int		nparams;
+	double		target[NUM_PATIENTS + 1];	/* < 0 when not a target */
+	int		candidates;
+	int		daggerset;
+	int		threads;
+	uint64_t	seed;
+
+	/* Filled in by tune_run() */
+	struct tune_config baseline;
+	struct tune_config best;
+	double		baseline_win[NUM_PATIENTS + 1];
+	double		best_win[NUM_PATIENTS + 1];
+	double		baseline_loss;
+	double		best_loss;
+	long		final_games;	/* per tool and species behind the figures */
+	long		games;
+	long		evaluations;
+	long		cut;	/* candidates dropped before the last rung */
+	double		elapsed;
+};
+
+void		tune_init(struct tune * t);
+void		tune_defaults(struct tune_config * cfg);
+int		tune_lookup(const char *name, size_t * offset, int *min, int *max);
+int		tune_parse_targets(struct tune * t, const char *spec);
+int		tune_parse_params(struct tune * t, const char *spec);
+void		tune_run(struct tune * t);
+void		print_tune(const struct tune * t, FILE * out);
+
+#endif				/* TUNE_H */
@@ -25,7 +25,26 @@
  *
  */
 
+#include <sys/time.h>
+
+#include <stdatomic.h>
+#include <math.h>
+
 #include "CUnit/Basic.h"
+#include "packed.h"
+#include "analyze.h"
+#include "balance.h"
+#include "tune.h"
+#include "cache.h"
+#include "sketch.h"
+#include "sweep.h"
+#include "wheel.h"
+#include "alias.h"
+#include "roster.h"
+#include "watch.h"
+#include "clinic.h"
+#include "tournament.h"
+#include "libbuffy.h"
 
 int		startup = 0;
 int		isclean = 0;
@@ -43,6 +62,7 @@ int
 init_suite1(void)
 {
 	startup = 1;
+	engine_tables_init();
 	return 0;
 }
 
@@ -126,6 +146,43 @@ void testALLFANGSHEALTHY(void)
 	CU_ASSERT(all_fangs_healthy(&patient) == 0);
 }
 
+/* The bitset and heap agree with a scan of the fangs after every stroke */
+void
+testDENTITION(void)
+{
+	struct dentition d;
+	patient_type	pat;
+	struct rng	r;
+
+	memset(&pat, 0, sizeof(pat));
+	for (int i = 0; i < NUM_FANGS; i++)
+		pat.fangs[i].health = MAX_HEALTH;
+	dent_init(&d, &pat);
+	CU_ASSERT(dent_all_healthy(&d.bits) && dent_next(&d.bits, 0) == NUM_FANGS && dent_dirtiest(&d) == -1);
+
+	rng_seed(&r, 11, 0);
+	rng_set_stream(&r);
+	randomize_fangs(&pat);
+	dent_init(&d, &pat);
+	for (int k = 0; k < 2000; k++) {
+		int		f = rng_uniform(NUM_FANGS), lo = -1, next = NUM_FANGS;
+
+		pat.fangs[f].health = rng_uniform(4) == 0 ? MAX_HEALTH : 50 + rng_uniform(MAX_HEALTH - 50);
+		dent_update(&d, f, pat.fangs[f].health);
+		for (int i = NUM_FANGS - 1; i >= 0; i--)
+			if (pat.fangs[i].health < MAX_HEALTH) {
+				next = i;
+				if (lo == -1 || pat.fangs[i].health <= pat.fangs[lo].health)
+					lo = i;
+			}
+		CU_ASSERT(dent_next(&d.bits, 0) == next);
+		CU_ASSERT(dent_dirtiest(&d) == lo);
+		CU_ASSERT(dent_all_healthy(&d.bits) == (all_fangs_healthy(&pat) == 0));
+		CU_ASSERT(next == NUM_FANGS || dent_next(&d.bits, next + 1) > next);
+	}
+	rng_set_stream(NULL);
+}
+
 void
 testSAVE_GAME_STATE(void)
 {
@@ -242,6 +299,1074 @@ void testPATIENTREACTION(void)
 	CU_ASSERT(reaction[0] != '\0');
 }
 	
+static _Atomic uint64_t pool_items;
+static _Atomic uint64_t pool_sum;
+
+static void
+pool_count(void *arg, int worker, uint64_t lo, uint64_t hi)
+{
+	for (uint64_t i = lo; i < hi; i++) {
+		atomic_fetch_add(&pool_items, 1);
+		atomic_fetch_add(&pool_sum, i);
+	}
+}
+
+void
+testPOOL_RUN(void)
+{
+	/* Every item must be handed out exactly once, even oversubscribed */
+	uint64_t	n = 100003;
+
+	pool_run(16, n, 7, pool_count, NULL);
+	CU_ASSERT(pool_items == n);
+	CU_ASSERT(pool_sum == n * (n - 1) / 2);
+}
+
+void
+testSOLVER_TABLE(void)
+{
+	struct solver_table table;
+	const char     *path = "test_policy.btfp";
+
+	CU_ASSERT(solver_write(path) == 0);
+	CU_ASSERT(solver_open(path, &table) == 0);
+	if (table.header == NULL)
+		return;
+
+	/* A clean fang needs nothing; a dirty one is never cheaper */
+	for (int t = 0; t < NUM_TOOLS; t++)
+		for (int s = 0; s < NUM_PATIENTS; s++) {
+			CU_ASSERT(solver_entry(&table, t, s, MAX_HEALTH)->cost == 0);
+			CU_ASSERT(solver_entry(&table, t, s, 60)->cost >= solver_entry(&table, t, s, 61)->cost);
+		}
+
+	/* The Steel Dagger cleans any Vampire fang in a single stroke */
+	CU_ASSERT(solver_entry(&table, 5, VAMPIRE, 60)->strokes == 1);
+	solver_close(&table);
+	unlink(path);
+}
+
+void
+testTABLES_VALIDATE(void)
+{
+	CU_ASSERT(engine_tables_validate(NULL) == 0);
+	/* Dragons heal at half rate, so a capped Steel Dagger stroke is 80 */
+	CU_ASSERT(TBL_GAIN(5, DRAGON, 100, 100) == 80);
+}
+
+void
+testRNG_PHILOX(void)
+{
+	/* Known answers for Philox4x32-10 from the Random123 test vectors */
+	uint32_t	zero_ctr[4] = {0, 0, 0, 0}, zero_key[2] = {0, 0};
+	uint32_t	ones_ctr[4] = {~0U, ~0U, ~0U, ~0U}, ones_key[2] = {~0U, ~0U};
+	uint32_t	out[4], buf[11];
+	struct rng	a, b;
+
+	rng_philox(zero_ctr, zero_key, out);
+	CU_ASSERT(out[0] == 0x6627e8d5 && out[1] == 0xe169c58d &&
+		  out[2] == 0xbc57ac4c && out[3] == 0x9b00dbd8);
+	rng_philox(ones_ctr, ones_key, out);
+	CU_ASSERT(out[0] == 0x408f276d && out[1] == 0x41c83b0e &&
+		  out[2] == 0xa20bc7c6 && out[3] == 0x6d5451fd);
+
+	/* Bulk fill and jumping land on the same words as single draws */
+	rng_seed(&a, 42, 7);
+	rng_seed(&b, 42, 7);
+	(void)rng_next(&a);
+	(void)rng_next(&b);
+	rng_fill(&a, buf, 11);
+	for (int i = 0; i < 11; i++)
+		CU_ASSERT(buf[i] == rng_next(&b));
+	rng_seed(&a, 42, 7);
+	rng_jump(&a, 2);
+	CU_ASSERT(rng_next(&a) == buf[7]);	/* word 8; buf holds words 1..11 */
+	rng_seed(&b, 42, 8);
+	rng_seed(&a, 42, 7);
+	CU_ASSERT(rng_next(&a) != rng_next(&b));
+}
+
+void
+testRNG_PARSE_SEED(void)
+{
+	uint64_t	seed;
+
+	CU_ASSERT(rng_parse_seed("42", &seed) == 0 && seed == 42);
+	CU_ASSERT(rng_parse_seed("010", &seed) == 0 && seed == 10);
+	CU_ASSERT(rng_parse_seed("08", &seed) == 0 && seed == 8);
+	CU_ASSERT(rng_parse_seed("0x10", &seed) == 0 && seed == 16);
+	CU_ASSERT(rng_parse_seed("0XfF", &seed) == 0 && seed == 255);
+	CU_ASSERT(rng_parse_seed("18446744073709551615", &seed) == 0 && seed == UINT64_MAX);
+	CU_ASSERT(rng_parse_seed("18446744073709551616", &seed) == -1);
+	CU_ASSERT(rng_parse_seed("", &seed) == -1);
+	CU_ASSERT(rng_parse_seed("0x", &seed) == -1);
+	CU_ASSERT(rng_parse_seed("-1", &seed) == -1);
+	CU_ASSERT(rng_parse_seed("0x-1", &seed) == -1);
+	CU_ASSERT(rng_parse_seed(" 1", &seed) == -1);
+	CU_ASSERT(rng_parse_seed("ff", &seed) == -1);
+	CU_ASSERT(rng_parse_seed("12abc", &seed) == -1);
+}
+
+void
+testSEEDED_SIMULATION(void)
+{
+	struct sim_results one, many, batched;
+
+	rng_set_seed(42);
+	simulate_games(5000, 0, 1, &one);
+	simulate_games(5000, 0, 3, &many);
+	simulate_batches(5000, 0, 2, &batched);
+	CU_ASSERT(one.seed == 42);
+	CU_ASSERT(one.wins == many.wins && one.score_sum == many.score_sum &&
+		  one.turns_sum == many.turns_sum && one.fluoride_sum == many.fluoride_sum);
+	CU_ASSERT(one.wins == batched.wins && one.score_sum == batched.score_sum &&
+		  one.turns_sum == batched.turns_sum && one.fluoride_sum == batched.fluoride_sum);
+}
+
+void
+testREPLAY(void)
+{
+	const char     *path = "test_replay.bfr";
+	struct replay_writer *w;
+	struct replay_result res;
+	struct dent_bits teeth;
+	game_state_type	state;
+	patient_type	pat;
+	struct rng	r;
+	int		dip, effort, outcome = -1;
+	uint64_t	seed;
+	struct stat	st;
+	FILE	       *fp;
+
+	/* Record a scripted game dealt the way a fresh interactive one is */
+	memset(&state, 0, sizeof(state));
+	memset(&pat, 0, sizeof(pat));
+	rng_seed(&r, 5, 0);
+	rng_set_stream(&r);
+	engine_init_state(&state);
+	patient_init(&state, &pat);
+	rng_set_stream(NULL);
+	dent_bits_init(&teeth, &pat);
+	CU_ASSERT((w = replay_writer_open(path, 5, 0)) != NULL);
+	if (w == NULL)
+		return;
+	while (outcome == -1) {
+		for (int i = dent_next(&teeth, 0); i < NUM_FANGS && outcome == -1; i = dent_next(&teeth, i + 1)) {
+			sim_scripted_input(&state, &pat, i, &dip, &effort);
+			if (engine_fang_turn(&state, &pat, i, dip, effort, NULL, 0) == -1)
+				outcome = REPLAY_NO_FLUORIDE;
+			dent_bits_update(&teeth, i, pat.fangs[i].health);
+			replay_record_stroke(w, dip, effort, engine_checksum(&state, &pat));
+		}
+		if (outcome == -1 && engine_end_round(&state, &teeth) == 0) {
+			state.score += BONUS_ALL_HEALTH;
+			outcome = REPLAY_WIN;
+		} else if (outcome == -1)
+			replay_record_answer(w, ENGINE_CONTINUE);
+	}
+	replay_record_end(w, outcome, &state);
+	replay_writer_close(w);
+
+	CU_ASSERT(replay_file(path, &res) == 0);
+	CU_ASSERT(!res.incomplete);
+	CU_ASSERT(res.outcome == outcome);
+	CU_ASSERT(res.score == state.score);
+
+	/* A changed effort no longer reproduces the recorded state */
+	if ((fp = fopen(path, "r+b")) != NULL) {
+		fseek(fp, REPLAY_HEADER + 1, SEEK_SET);
+		fputc(0, fp);
+		fclose(fp);
+	}
+	CU_ASSERT(replay_file(path, &res) == -1);
+
+	/*
+	 * Hundreds of rounds of dry strokes on an Orc, which they never
+	 * heal, run well past a few kilobytes
+	 */
+	seed = 0;
+	do {
+		memset(&state, 0, sizeof(state));
+		memset(&pat, 0, sizeof(pat));
+		rng_seed(&r, ++seed, 0);
+		rng_set_stream(&r);
+		engine_init_state(&state);
+		patient_init(&state, &pat);
+		rng_set_stream(NULL);
+	} while (state.patient_idx != ORC);
+	dent_bits_init(&teeth, &pat);
+	w = replay_writer_open(path, seed, 0);
+	for (int round = 0; round < SIM_MAX_TURNS / 2; round++) {
+		for (int i = dent_next(&teeth, 0); i < NUM_FANGS; i = dent_next(&teeth, i + 1)) {
+			engine_fang_turn(&state, &pat, i, 0, 0, NULL, 0);
+			dent_bits_update(&teeth, i, pat.fangs[i].health);
+			replay_record_stroke(w, 0, 0, engine_checksum(&state, &pat));
+		}
+		engine_end_round(&state, &teeth);
+		replay_record_answer(w, round + 1 < SIM_MAX_TURNS / 2 ? ENGINE_CONTINUE : ENGINE_QUIT);
+	}
+	replay_record_end(w, REPLAY_QUIT, &state);
+	replay_writer_close(w);
+	CU_ASSERT(stat(path, &st) == 0 && st.st_size > 8192);
+	CU_ASSERT(replay_file(path, &res) == 0);
+	CU_ASSERT(res.outcome == REPLAY_QUIT && res.strokes == SIM_MAX_TURNS / 2 * NUM_FANGS);
+	unlink(path);
+}
+
+void
+testMCTS_POLICY(void)
+{
+	struct policy_config cfg = {"mcts", NULL, 0, 300};
+	struct sim_results scripted, mcts;
+
+	/* Fixed node budget, so the search is as reproducible as the deal */
+	rng_set_seed(11);
+	simulate_games(300, 0, 1, &scripted);
+	sim_use_policy(&cfg);
+	simulate_games(300, 0, 2, &mcts);
+	CU_ASSERT(mcts.wins >= scripted.wins);
+	CU_ASSERT(mcts.no_fluoride == 0);
+	CU_ASSERT(mcts.policy.moves > 0);
+	CU_ASSERT(mcts.policy.iterations <= mcts.policy.moves * cfg.nodes);
+
+	/* Every dagger game can be won */
+	simulate_games(100, 1, 1, &mcts);
+	CU_ASSERT(mcts.wins == 100);
+	sim_use_policy(NULL);
+}
+
+void
+testPACKED_STATE(void)
+{
+	game_state_type	state, back;
+	patient_type	pat, back_pat;
+	struct packed_state ps, again;
+	struct rng	r;
+	uint64_t	hash;
+	int		mismatches = 0;
+
+	rng_seed(&r, 99, 0);
+	rng_set_stream(&r);
+	for (int game = 0; game < 200; game++) {
+		memset(&state, 0, sizeof(state));
+		memset(&pat, 0, sizeof(pat));
+		state.daggerset = game & 1;
+		engine_init_state(&state);
+		patient_init(&state, &pat);
+		packed_pack(&state, &pat, 0, &ps);
+		hash = packed_hash(&ps);
+
+		/* Random strokes through the engine and the packed state agree */
+		for (int stroke = 0; stroke < 40; stroke++) {
+			int		fang = ps.fang;
+			int		dip = rng_uniform(tools[state.tool_in_use].dip_amount + 2);
+			int		effort = rng_uniform(tools[state.tool_in_use].effort + 2);
+			int		used = engine_fang_turn(&state, &pat, fang, dip, effort, NULL, 0);
+
+			if (used != packed_fang_turn(&ps, &hash, dip, effort))
+				mismatches++;
+			if (used == -1)
+				break;
+			packed_next_fang(&ps, &hash);
+			if (ps.fang == NUM_FANGS)
+				break;
+			packed_pack(&state, &pat, ps.fang, &again);
+			mismatches += !packed_equal(&ps, &again);
+			mismatches += hash != packed_hash(&ps);
+		}
+
+		memset(&back, 0, sizeof(back));
+		memset(&back_pat, 0, sizeof(back_pat));
+		packed_unpack(&ps, &back, &back_pat);
+		packed_pack(&back, &back_pat, ps.fang, &again);
+		mismatches += !packed_equal(&ps, &again);
+	}
+	rng_set_stream(NULL);
+	CU_ASSERT(mismatches == 0);
+}
+
+void
+testANALYZE(void)
+{
+	struct analysis a;
+	struct analyze_cell all;
+	struct sim_results res;
+	double		pmf[MAX_HEALTH + 1], sum = 0;
+
+	engine_health_pmf(pmf);
+	for (int h = 0; h <= MAX_HEALTH; h++)
+		sum += pmf[h];
+	CU_ASSERT(fabs(sum - 1) < 1e-12);
+
+	analyze_all(NULL, 2, &a);
+	for (int t = 0; t < NUM_TOOLS; t++)
+		for (int s = 0; s < NUM_PATIENTS; s++) {
+			const struct analyze_cell *c = &a.cells[t][s];
+
+			CU_ASSERT(fabs(c->win + c->no_fluoride + c->stalled - 1) < 1e-9);
+		}
+
+	/* The exact figures sit inside the sampling error of a seeded run */
+	analyze_overall(&a, 0, &all);
+	rng_set_seed(7);
+	simulate_games(50000, 0, 2, &res);
+	CU_ASSERT(fabs(all.win - (double)res.wins / res.games) < 0.01);
+	CU_ASSERT(fabs(all.score - (double)res.score_sum / res.games) < 5);
+	CU_ASSERT(fabs(all.turns - (double)res.turns_sum / res.games) < 1);
+}
+
+void
+testBALANCE_SWEEP(void)
+{
+	static struct balance one, many;
+	struct analyze_cell exact;
+	const struct balance_cell *c = &one.cells[2][SERPENT];
+	long		hist = 0;
+
+	rng_set_seed(11);
+	balance_sweep(NULL, 30 * 2000, 1, NULL, &one);
+	balance_sweep(NULL, 30 * 2000, 3, NULL, &many);
+	CU_ASSERT(one.games_per_cell == 2000);
+	CU_ASSERT(memcmp(one.cells, many.cells, sizeof(one.cells)) == 0);
+
+	/* Shark Tooth against the Serpent lands near its exact win rate */
+	for (int i = 0; i < BALANCE_SCORE_BINS; i++)
+		hist += c->score_hist[i];
+	CU_ASSERT(c->games == 2000 && hist == c->games);
+	CU_ASSERT(c->wins + c->no_fluoride + c->stalled == c->games);
+	analyze_cell(NULL, 2, SERPENT, &exact);
+	CU_ASSERT(fabs((double)c->wins / c->games - exact.win) < 0.05);
+}
+
+void
+testBALANCE_STORE(void)
+{
+	static struct balance full, again, edited;
+	struct balance_store_header hdr;
+	const char     *path = "test_balance.bfbs";
+	FILE	       *fp;
+	int		was = tools[1].effectiveness;
+
+	remove(path);
+	rng_set_seed(12);
+	CU_ASSERT(balance_sweep(NULL, 30 * 500, 2, path, &full) == 0);
+	CU_ASSERT(full.reused == 0 && full.played == 30 * 500);
+	CU_ASSERT(balance_sweep(NULL, 30 * 500, 2, path, &again) == 0);
+	CU_ASSERT(again.reused == 30 && again.played == 0);
+	CU_ASSERT(memcmp(full.cells, again.cells, sizeof(full.cells)) == 0);
+
+	/* Only the Small Rock's pairs depend on its stats */
+	tools[1].effectiveness = was + 2;
+	engine_tables_init();
+	CU_ASSERT(balance_sweep(NULL, 30 * 500, 2, path, &edited) == 0);
+	CU_ASSERT(edited.reused == 25 && edited.played == 5 * 500);
+	CU_ASSERT(balance_sweep(NULL, 30 * 500, 1, NULL, &full) == 0);
+	CU_ASSERT(memcmp(full.cells, edited.cells, sizeof(full.cells)) == 0);
+	CU_ASSERT(edited.cells[1][VAMPIRE].wins != again.cells[1][VAMPIRE].wins);
+
+	/* A build with more teeth plays different games from the same store */
+	CU_ASSERT(balance_fingerprint(NULL, 1, VAMPIRE, 500, 12, NUM_FANGS) ==
+		  balance_fingerprint(NULL, 1, VAMPIRE, 500, 12, NUM_FANGS));
+	CU_ASSERT(balance_fingerprint(NULL, 1, VAMPIRE, 500, 12, NUM_FANGS) !=
+		  balance_fingerprint(NULL, 1, VAMPIRE, 500, 12, 32));
+	tools[1].effectiveness = was;
+	engine_tables_init();
+
+	/* A count the file cannot hold is refused before anything is allocated */
+	if ((fp = fopen(path, "r+b")) != NULL) {
+		CU_ASSERT(fread(&hdr, sizeof(hdr), 1, fp) == 1);
+		hdr.count = UINT32_MAX;
+		rewind(fp);
+		CU_ASSERT(fwrite(&hdr, sizeof(hdr), 1, fp) == 1);
+		fclose(fp);
+	}
+	CU_ASSERT(balance_sweep(NULL, 30 * 500, 2, path, &again) == -1);
+	remove(path);
+}
+
+void
+testCACHE(void)
+{
+	const char     *dir = "test_cache";
+	struct cache_key a, b, c, edited;
+	char		data[1000], back[1000], path[256];
+	struct timeval	old[2] = {{1000000000, 0}, {1000000000, 0}};
+	int		was = tools[0].effort;
+
+	CU_ASSERT(cache_open(dir, 3000) == 0);
+	for (size_t i = 0; i < sizeof(data); i++)
+		data[i] = (char)i;
+	cache_key_init(&a, "simulate");
+	b = c = a;
+	cache_key_int(&a, 1);
+	cache_key_int(&b, 2);
+	cache_key_int(&c, 3);
+	CU_ASSERT(memcmp(&a, &b, sizeof(a)) != 0);
+
+	/* Any balance constant is part of every key */
+	tools[0].effort = was + 1;
+	cache_key_init(&edited, "simulate");
+	cache_key_int(&edited, 1);
+	tools[0].effort = was;
+	CU_ASSERT(memcmp(&a, &edited, sizeof(a)) != 0);
+
+	CU_ASSERT(cache_put(&a, data, sizeof(data)) == 0);
+	CU_ASSERT(cache_get(&a, back, sizeof(back)) == 0 && memcmp(data, back, sizeof(data)) == 0);
+	CU_ASSERT(cache_get(&b, back, sizeof(back)) == -1);
+	CU_ASSERT(cache_get(&a, back, sizeof(back) - 1) == -1);
+
+	/* Three entries overflow 3000 bytes; the one used longest ago goes */
+	snprintf(path, sizeof(path), "%s/%016llx%016llx.bfc", dir,
+		 (unsigned long long)a.h[0], (unsigned long long)a.h[1]);
+	CU_ASSERT(utimes(path, old) == 0);
+	CU_ASSERT(cache_put(&b, data, sizeof(data)) == 0);
+	CU_ASSERT(cache_put(&c, data, sizeof(data)) == 0);
+	CU_ASSERT(cache_get(&a, back, sizeof(back)) == -1);
+	CU_ASSERT(cache_get(&b, back, sizeof(back)) == 0);
+	CU_ASSERT(cache_get(&c, back, sizeof(back)) == 0);
+
+	CU_ASSERT(cache_open(dir, 0) == 0);
+	CU_ASSERT(cache_evict() == 2);
+	CU_ASSERT(rmdir(dir) == 0);
+}
+
+void
+testSWEEP(void)
+{
+	const char     *dir = "test_sweep";
+	static struct sketch sk;
+	static struct sim_results whole, merged;
+	struct sweep	sw;
+	char		path[256];
+	int		played, resumed, n;
+
+	/* Exact below SKETCH_EXACT, within 1/32 above it */
+	for (long v = 1; v <= 100; v++)
+		sketch_add(&sk, v);
+	CU_ASSERT(sketch_quantile(&sk, 0.5) == 50 && sketch_quantile(&sk, 1) == 100);
+	CU_ASSERT(sketch_lower(sketch_bucket(5000)) <= 5000 && sketch_lower(sketch_bucket(5000)) > 5000 - 5000 / 32);
+	CU_ASSERT(sketch_bucket(UINT32_MAX) == SKETCH_BUCKETS - 1);
+
+	rng_set_seed(99);
+	simulate_games(3001, 0, 2, &whole);
+	CU_ASSERT(sweep_init(&sw, dir, 3001, 4000, 0, 1, NULL) == -1);
+	CU_ASSERT(sweep_init(&sw, dir, 3001, 3, 0, 2, NULL) == 0);
+
+	/* One shard from another process, then the rest resumed around it */
+	CU_ASSERT(sweep_run_shard(&sw, 1) == 0);
+	CU_ASSERT(sweep_merge(dir, &merged, &n) == -1);
+	CU_ASSERT(sweep_run(&sw, &played, &resumed) == 0 && played == 2 && resumed == 1);
+	CU_ASSERT(sweep_merge(dir, &merged, &n) == 0 && n == 3);
+	CU_ASSERT(merged.games == whole.games && merged.wins == whole.wins &&
+		  merged.score_sum == whole.score_sum && merged.fluoride_sum == whole.fluoride_sum);
+	CU_ASSERT(memcmp(&merged.score, &whole.score, sizeof(whole.score)) == 0 &&
+		  memcmp(&merged.turns, &whole.turns, sizeof(whole.turns)) == 0);
+
+	/* A different seed is a different sweep */
+	rng_set_seed(100);
+	CU_ASSERT(sweep_init(&sw, dir, 3001, 3, 0, 2, NULL) == 0);
+	CU_ASSERT(sweep_run_shard(&sw, 0) == -1);
+
+	for (int i = 0; i < 3; i++) {
+		snprintf(path, sizeof(path), "%s/shard-%05d-of-%05d.bfs", dir, i, 3);
+		CU_ASSERT(remove(path) == 0);
+	}
+	CU_ASSERT(rmdir(dir) == 0);
+}
+
+void
+testTOURNAMENT(void)
+{
+	static struct tournament one, many;
+	struct sim_results alone;
+	long		w[TOURNAMENT_MAX][TOURNAMENT_MAX] = {{0, 300}, {100, 0}};
+	double		elo[TOURNAMENT_MAX];
+
+	CU_ASSERT(tournament_init(&one, "scripted", NULL) == -1);
+	CU_ASSERT(tournament_init(&one, "scripted,lucky", NULL) == -1);
+	CU_ASSERT(tournament_init(&one, "scripted,optimal", NULL) == -1);
+	CU_ASSERT(tournament_init(&one, "maxdip,maxdip", NULL) == -1);
+
+	/* 3 to 1 in half points is a strength ratio of about 3 */
+	tournament_ratings(w, 2, elo);
+	CU_ASSERT(fabs(elo[0] + elo[1]) < 1e-9);
+	CU_ASSERT(fabs(elo[0] - elo[1] - 400 * log10(301.0 / 101.0)) < 1e-6);
+
+	CU_ASSERT(tournament_init(&one, "scripted,greedy,maxdip", NULL) == 0);
+	CU_ASSERT(tournament_init(&many, "scripted,greedy,maxdip", NULL) == 0);
+	one.games = many.games = 2000;
+	many.threads = 3;
+	rng_set_seed(5);
+	tournament_run(&one);
+	tournament_run(&many);
+	CU_ASSERT(memcmp(one.beat, many.beat, sizeof(one.beat)) == 0);
+	CU_ASSERT(memcmp(one.elo, many.elo, sizeof(one.elo)) == 0);
+	for (int i = 0; i < 3; i++) {
+		CU_ASSERT(one.beat[i][i] == 0);
+		for (int j = 0; j < 3; j++)
+			CU_ASSERT(one.beat[i][j] + one.beat[j][i] <= one.games);
+	}
+
+	/* The scripted side plays exactly the simulator's games */
+	sim_use_policy(NULL);
+	simulate_games(2000, 0, 1, &alone);
+	CU_ASSERT(one.wins[0] == alone.wins && one.score_sum[0] == alone.score_sum);
+}
+
+/*
+ * Many games stepped in turn on one thread end exactly as the simulator
+ * plays them one at a time
+ */
+void
+testLIBBUFFY(void)
+{
+	static struct buffy_ctx ctx[64];
+	struct buffy_event ev[BUFFY_MAX_EVENTS];
+	struct buffy_input in = {0, 0, ENGINE_CONTINUE};
+	struct sim_results res;
+	long		wins = 0, score = 0;
+	int		live;
+
+	for (int i = 0; i < 64; i++)
+		buffy_new_game(&ctx[i], 21, i, 0);
+	CU_ASSERT(buffy_step(&ctx[0], NULL, ev) > 0);
+	CU_ASSERT(ctx[0].need == BUFFY_NEED_STROKE && buffy_step(&ctx[0], NULL, ev) == -1);
+	do {
+		live = 0;
+		for (int i = 0; i < 64; i++) {
+			int		n;
+
+			if (ctx[i].need == BUFFY_NEED_NONE)
+				continue;
+			live++;
+			if (ctx[i].need == BUFFY_NEED_STROKE)
+				sim_scripted_input(&ctx[i].state, &ctx[i].pat, ctx[i].fang, &in.dip, &in.effort);
+			in.answer = ctx[i].state.turns > SIM_MAX_TURNS ? ENGINE_QUIT : ENGINE_CONTINUE;
+			n = buffy_step(&ctx[i], &in, ev);
+			CU_ASSERT(n >= 0 && n <= BUFFY_MAX_EVENTS);
+			for (int k = 0; k < n; k++) {
+				if (ev[k].type == BUFFY_EV_STROKE)
+					CU_ASSERT(ev[k].checksum == engine_checksum(&ctx[i].state, &ctx[i].pat));
+				if (ev[k].type == BUFFY_EV_OVER) {
+					wins += ev[k].outcome == BUFFY_WIN;
+					score += ctx[i].state.score;
+					CU_ASSERT(ev[k].score == ctx[i].state.score);
+				}
+			}
+		}
+	} while (live);
+	CU_ASSERT(buffy_step(&ctx[0], &in, ev) == 0);
+
+	rng_set_seed(21);
+	sim_use_policy(NULL);
+	simulate_games(64, 0, 1, &res);
+	CU_ASSERT(wins == res.wins && score == res.score_sum);
+}
+
+void
+testPREVIEW(void)
+{
+	struct buffy_ctx ctx, before;
+	struct buffy_event ev[BUFFY_MAX_EVENTS];
+	struct buffy_input in[3] = {{1, 2, ENGINE_CONTINUE}, {4, 9, ENGINE_CONTINUE}, {999, 1, ENGINE_CONTINUE}};
+	struct buffy_preview out[3];
+
+	buffy_new_game(&ctx, 5, 0, 0);
+	CU_ASSERT(buffy_preview(&ctx, in, 3, out) == -1);
+	buffy_step(&ctx, NULL, ev);
+	before = ctx;
+	CU_ASSERT(buffy_preview(&ctx, in, 3, out) == 3);
+	CU_ASSERT(memcmp(&before, &ctx, sizeof(ctx)) == 0);
+	for (int i = 0; i < 3; i++) {
+		struct buffy_ctx c = before;
+		int		n = buffy_step(&c, &in[i], ev);
+
+		CU_ASSERT(out[i].fluoride == c.state.fluoride && out[i].score == c.state.score);
+		CU_ASSERT(out[i].health == c.pat.fangs[before.fang].health);
+		CU_ASSERT(out[i].mood == c.pat.mood && out[i].patience_level == c.pat.patience_level);
+		CU_ASSERT(n > 0 && (out[i].used == -1) == (ev[n - 1].type == BUFFY_EV_OVER));
+	}
+}
+
+/* Everything a stroke, a round or an answer can change */
+static int
+same_game(const struct buffy_ctx * a, const struct buffy_ctx * b)
+{
+	return engine_checksum(&a->state, &a->pat) == engine_checksum(&b->state, &b->pat) &&
+	    a->state.tool_dip == b->state.tool_dip && a->state.tool_effort == b->state.tool_effort &&
+	    a->state.fluoride_used == b->state.fluoride_used &&
+	    memcmp(a->state.last_tool_dip, b->state.last_tool_dip, sizeof(a->state.last_tool_dip)) == 0 &&
+	    memcmp(a->state.last_tool_effort, b->state.last_tool_effort, sizeof(a->state.last_tool_effort)) == 0 &&
+	    a->need == b->need && a->fang == b->fang && a->outcome == b->outcome;
+}
+
+void
+testHISTORY(void)
+{
+	static struct buffy_history hist;
+	static struct buffy_ctx before[300];
+	struct buffy_ctx ctx, end;
+	struct buffy_event ev[BUFFY_MAX_EVENTS];
+	struct buffy_input in = {0, 0, ENGINE_CONTINUE};
+	int		strokes = 0;
+
+	/* Dips of nothing never finish, so the ring fills and wraps */
+	buffy_new_game(&ctx, 3, 1, 0);
+	buffy_history_init(&hist);
+	CU_ASSERT(buffy_undo(&ctx, &hist, ev) == -1);
+	while (strokes < 300) {
+		if (ctx.need == BUFFY_NEED_STROKE) {
+			in.dip = strokes % 3 == 0;
+			in.effort = strokes % 4;
+			before[strokes++] = ctx;
+		}
+		CU_ASSERT(buffy_play(&ctx, &hist, &in, ev) >= 0);
+	}
+	CU_ASSERT(buffy_undos(&hist) == BUFFY_HISTORY && !buffy_can_redo(&ctx, &hist));
+	end = ctx;
+
+	for (int i = strokes - 1; i >= strokes - BUFFY_HISTORY; i--) {
+		CU_ASSERT(buffy_undo(&ctx, &hist, ev) == 1 && ev[0].type == BUFFY_EV_ASK_STROKE);
+		CU_ASSERT(same_game(&ctx, &before[i]));
+	}
+	CU_ASSERT(buffy_undo(&ctx, &hist, ev) == -1);
+
+	/* Redo comes back the way the game went */
+	for (int i = 0; i < BUFFY_HISTORY; i++) {
+		while (ctx.need != BUFFY_NEED_STROKE)
+			buffy_play(&ctx, &hist, &in, ev);
+		CU_ASSERT(buffy_redo(&ctx, &hist, ev) > 0);
+	}
+	CU_ASSERT(same_game(&ctx, &end));
+
+	/* A new stroke drops what was left to redo */
+	buffy_undo(&ctx, &hist, ev);
+	buffy_undo(&ctx, &hist, ev);
+	CU_ASSERT(buffy_can_redo(&ctx, &hist));
+	CU_ASSERT(buffy_play(&ctx, &hist, &in, ev) > 0);
+	CU_ASSERT(buffy_undos(&hist) == BUFFY_HISTORY - 1 && !buffy_can_redo(&ctx, &hist));
+
+	/* A stroke that ends the game can be taken back too */
+	buffy_new_game(&ctx, 3, 2, 0);
+	buffy_history_init(&hist);
+	in.dip = 1000;
+	in.effort = 1;
+	while (ctx.need != BUFFY_NEED_NONE) {
+		if (ctx.need == BUFFY_NEED_STROKE)
+			before[0] = ctx;
+		buffy_play(&ctx, &hist, &in, ev);
+	}
+	CU_ASSERT(buffy_undo(&ctx, &hist, ev) == 1 && same_game(&ctx, &before[0]));
+}
+
+void
+testALIAS(void)
+{
+	const double	weight[] = {5, 0, 1, 3, 0.5, 7};
+	const int	n = sizeof(weight) / sizeof(weight[0]);
+	double		total = 16.5, count[sizeof(weight) / sizeof(weight[0])] = {0};
+	const double	bad[] = {1, -1};
+	struct alias	a;
+	patient_type	pat;
+	struct rng	r;
+	long		bucket[NUM_HEALTH_BUCKETS] = {0}, stray = 0;
+
+	CU_ASSERT(alias_init(&a, weight, 0) == -1);
+	CU_ASSERT(alias_init(&a, bad, 2) == -1);
+	CU_ASSERT(alias_init(&a, bad, 1) == 0 && alias_pick(&a, 0) == 0 && alias_pick(&a, UINT32_MAX) == 0);
+	CU_ASSERT(alias_init(&a, weight + 1, 1) == -1);
+
+	/* The table holds the weights, and even words land on them */
+	CU_ASSERT(alias_init(&a, weight, n) == 0);
+	for (int i = 0; i < n; i++)
+		CU_ASSERT(fabs(alias_probability(&a, i) - weight[i] / total) < 1e-9);
+	for (uint32_t k = 0; k < 1U << 20; k++)
+		count[alias_pick(&a, k << 12 | 0x800)]++;
+	CU_ASSERT(count[1] == 0);
+	for (int i = 0; i < n; i++)
+		CU_ASSERT(fabs(count[i] / (1 << 20) - weight[i] / total) < 1e-5);
+
+	/* The deal keeps to health_buckets[] */
+	rng_seed(&r, 5, 0);
+	rng_set_stream(&r);
+	for (int g = 0; g < 50000; g++) {
+		randomize_fangs(&pat);
+		for (int f = 0; f < NUM_FANGS; f++) {
+			int		b = 0;
+
+			while (b < NUM_HEALTH_BUCKETS && (pat.fangs[f].health < health_buckets[b].lo ||
+			    pat.fangs[f].health > health_buckets[b].hi))
+				b++;
+			if (b == NUM_HEALTH_BUCKETS)
+				stray++;
+			else
+				bucket[b]++;
+		}
+	}
+	rng_set_stream(NULL);
+	CU_ASSERT(stray == 0);
+	for (int b = 0; b < NUM_HEALTH_BUCKETS; b++)
+		CU_ASSERT(fabs((double)bucket[b] / (50000 * NUM_FANGS) - health_buckets[b].weight / 100) < 0.01);
+
+	/* Every reaction has more than one comment, each the same for a key */
+	for (int cell = 0; cell < 9; cell++) {
+		char		first[160], text[160];
+		int		other = 0;
+
+		patient_comment(first, sizeof(first), cell, 0, "Dracula");
+		for (uint32_t key = 1; key < 1000; key++) {
+			patient_comment(text, sizeof(text), cell, key, "Dracula");
+			other += strcmp(text, first) != 0;
+		}
+		patient_comment(text, sizeof(text), cell, 0, "Dracula");
+		CU_ASSERT(other > 0 && strcmp(text, first) == 0 && strstr(first, "Dracula") != NULL);
+	}
+}
+
+static int
+roster_file(const char *path, const char *text)
+{
+	FILE	       *fp = fopen(path, "w");
+	struct roster	r;
+	int		ret;
+
+	fputs(text, fp);
+	fclose(fp);
+	if ((ret = roster_load(path, &r)) == 0)
+		roster_free(&r);
+	return ret;
+}
+
+void
+testROSTER(void)
+{
+	const char     *path = "test_roster.tsv";
+	const int	n = 100000;
+	struct roster	r;
+	struct timeval	start, end;
+	uint32_t	first, count, seen = 0;
+	FILE	       *fp;
+	long		i;
+
+	fp = fopen(path, "w");
+	fprintf(fp, "# name\tspecies\tage\tpatience\tpain tolerance\tdifficulty\r\n\n");
+	for (int k = 0; k < n; k++)
+		fprintf(fp, "patient\tCreature %d\t%s\t%d\t%d\t%d\t%d\n", k, patients[k % NUM_PATIENTS].species,
+			100 + k % 50, k % 12, k % 3, (k * 7919) % (ROSTER_DIFFICULTY_MAX + 1));
+	for (int k = 0; k < 100; k++)
+		fprintf(fp, "tool\tTool %d\t%d\t%d\t%d\t5\t50\t2\t%d\tA\ttabbed description\n", k, 1 + k % 10,
+			1 + k % 15, 1 + k % 15, k % 4 == 0);
+	fclose(fp);
+
+	gettimeofday(&start, NULL);
+	i = roster_load(path, &r);
+	gettimeofday(&end, NULL);
+	CU_ASSERT(i == 0);
+	if (i != 0)
+		return;
+	/* Milliseconds in a release build; allow for a slow or busy test host */
+	CU_ASSERT((end.tv_sec - start.tv_sec) * 1e3 + (end.tv_usec - start.tv_usec) / 1e3 < 1000);
+	CU_ASSERT(r.npatients == (uint32_t)n && r.ntools == 100);
+
+	i = roster_find_patient(&r, "Creature 4242");
+	CU_ASSERT(i == 4242 && r.patient[i].species == 4242 % NUM_PATIENTS && r.patient[i].age == 100 + 4242 % 50);
+	CU_ASSERT(roster_find_patient(&r, "Creature") == -1 && roster_find_tool(&r, "Creature 1") == -1);
+	i = roster_find_tool(&r, "Tool 99");
+	CU_ASSERT(i == 99 && roster_find_patient(&r, "Tool 99") == -1);
+	CU_ASSERT(strcmp(roster_str(&r, r.tool[i].description), "A\ttabbed description") == 0);
+
+	for (uint32_t k = 1; k < r.npatients; k++)
+		CU_ASSERT(r.patient[r.by_difficulty[k - 1]].difficulty <= r.patient[r.by_difficulty[k]].difficulty);
+	for (int s = 0; s < NUM_PATIENTS; s++)
+		for (uint32_t k = r.species_start[s]; k < r.species_start[s + 1]; k++)
+			seen += r.patient[r.by_species[k]].species == s;
+	CU_ASSERT(seen == r.npatients);
+
+	roster_band(&r, 100, 199, &first, &count);
+	CU_ASSERT(count > 0);
+	for (uint32_t k = 0; k < n; k++)
+		count -= r.patient[k].difficulty >= 100 && r.patient[k].difficulty <= 199;
+	CU_ASSERT(count == 0);
+	for (int k = 0; k < 1000; k++) {
+		long		p = roster_pick_patient(&r, 100, 199);
+		long		t = roster_pick_tool(&r, k & 1);
+
+		CU_ASSERT(p >= 0 && r.patient[p].difficulty >= 100 && r.patient[p].difficulty <= 199);
+		CU_ASSERT(t >= 0 && r.tool[t].dagger == (k & 1));
+	}
+	roster_band(&r, 5, 4, &first, &count);
+	CU_ASSERT(count == 0 && roster_pick_patient(&r, 5, 4) == -1);
+	roster_free(&r);
+
+	CU_ASSERT(roster_file(path, "") == 0);
+	CU_ASSERT(roster_file(path, "patient\tBob\tVampire\t1\t2\t3\t4") == 0);
+	CU_ASSERT(roster_file(path, "patient\tBob\tGhoul\t1\t2\t3\t4\n") == -1);
+	CU_ASSERT(roster_file(path, "patient\tBob\tVampire\t1\t2\t3\t1001\n") == -1);
+	CU_ASSERT(roster_file(path, "patient\tBob\tVampire\t1\t2\t3\n") == -1);
+	CU_ASSERT(roster_file(path, "patient\tBob\tOrc\t1\t2\t3\t4\ntool\tBob\t1\t1\t1\t1\t1\t1\t0\t\n") == -1);
+	CU_ASSERT(roster_file(path, "tool\tSpoon\t1\t16\t1\t1\t1\t1\t0\tToo deep\n") == -1);
+	CU_ASSERT(roster_file(path, "creature\tBob\n") == -1);
+	unlink(path);
+}
+
+#define WHEEL_TEST_TIMERS	20000
+#define WHEEL_TEST_TICKS	5000
+
+static struct wheel wheel_test;
+static struct wheel_timer wheel_timers[WHEEL_TEST_TIMERS];
+static long	wheel_count[WHEEL_TEST_TIMERS];
+static uint64_t	wheel_last[WHEEL_TEST_TIMERS];
+
+static void
+wheel_test_fire(void *arg)
+{
+	long		i = (long)(intptr_t)arg;
+
+	wheel_count[i]++;
+	wheel_last[i] = wheel_test.tick;
+	/* Timer 0 takes down timer 1, due on the same tick */
+	if (i == 0)
+		wheel_cancel(&wheel_test, &wheel_timers[1]);
+}
+
+void
+testWHEEL(void)
+{
+	static uint64_t	delay[WHEEL_TEST_TIMERS], period[WHEEL_TEST_TIMERS];
+	const uint64_t	tick_ns = 1000000;
+	struct rng	r;
+	long		fired = 0;
+
+	rng_seed(&r, 21, 0);
+	rng_set_stream(&r);
+	memset(wheel_count, 0, sizeof(wheel_count));
+	wheel_init(&wheel_test, tick_ns);
+	for (long i = 0; i < WHEEL_TEST_TIMERS; i++) {
+		/* Well past a turn of the wheel, and a few at once */
+		delay[i] = i < 2 ? 100 : rng_uniform(3000);
+		period[i] = i >= 2 && i % 10 == 0 ? 1 + rng_uniform(50) : 0;
+		wheel_add(&wheel_test, &wheel_timers[i], delay[i] * tick_ns, period[i] * tick_ns,
+			  wheel_test_fire, (void *)(intptr_t)i);
+	}
+	rng_set_stream(NULL);
+	CU_ASSERT(wheel_test.active == WHEEL_TEST_TIMERS);
+	for (long i = 2; i < WHEEL_TEST_TIMERS; i += 7)
+		wheel_cancel(&wheel_test, &wheel_timers[i]);
+
+	/* A tick at a time, then the rest in one late catch up */
+	for (uint64_t k = 1; k <= WHEEL_TEST_TICKS / 2; k++)
+		fired += wheel_run(&wheel_test, wheel_test.start_ns + k * tick_ns);
+	fired += wheel_run(&wheel_test, wheel_test.start_ns + WHEEL_TEST_TICKS * tick_ns + tick_ns / 2);
+	CU_ASSERT(wheel_test.tick == WHEEL_TEST_TICKS);
+	CU_ASSERT((uint64_t)fired == wheel_test.fired);
+
+	CU_ASSERT(wheel_count[0] == 1 && wheel_last[0] == 100);
+	CU_ASSERT(wheel_count[1] == 0 && !wheel_pending(&wheel_timers[1]));
+	for (long i = 2; i < WHEEL_TEST_TIMERS; i++) {
+		uint64_t	first = delay[i] ? delay[i] : 1;
+
+		if (i % 7 == 2)
+			CU_ASSERT(wheel_count[i] == 0);
+		else if (period[i] == 0)
+			CU_ASSERT(wheel_count[i] == 1 && wheel_last[i] == first);
+		else {
+			long		n = (long)((WHEEL_TEST_TICKS - first) / period[i]) + 1;
+
+			CU_ASSERT(wheel_count[i] == n);
+			CU_ASSERT(wheel_last[i] == first + (uint64_t)(n - 1) * period[i]);
+			CU_ASSERT(wheel_pending(&wheel_timers[i]));
+		}
+	}
+}
+
+static void
+watch_write(const char *path, const char *text)
+{
+	FILE	       *fp = fopen("test_balance.tmp", "w");
+
+	fputs(text, fp);
+	fclose(fp);
+	rename("test_balance.tmp", path);
+}
+
+/* Take up the watcher's rules until they are generation gen, for 5 s at most */
+static int
+watch_until(struct watch * w, int gen)
+{
+	for (int i = 0; i < 500; i++) {
+		watch_quiesce(w);
+		if (atomic_load(&w->seen) >= (unsigned long)gen)
+			return 1;
+		usleep(10000);
+	}
+	return 0;
+}
+
+void
+testWATCH(void)
+{
+	const char     *path = "test_balance.txt";
+	static struct engine_rules r, base;
+	static struct watch w;
+	game_state_type	state;
+	char		why[256], *note;
+
+	watch_write(path, "# rock\nrock.effectiveness = 7\n\n  bonus.fang_cleaned=2   # was 1\nDragon.percent = 60\n");
+	CU_ASSERT(watch_parse(path, &engine_rules, &r, why, sizeof(why)) == 0);
+	CU_ASSERT(r.tools[1].effectiveness == 7 && r.tools[0].effectiveness == tools[0].effectiveness);
+	CU_ASSERT(r.species[DRAGON].percent == 60 && r.bonus.fang_cleaned == 2);
+	CU_ASSERT(r.bonus.all_health == BONUS_ALL_HEALTH);
+	CU_ASSERT(r.tables.gain[1][DRAGON][6][4] == health_gain_for(&r.tools[1], &r.species[DRAGON], 4, 6));
+
+	/* Over other rules, such as a tool dealt from a roster */
+	base = engine_rules;
+	base.tools[0].effectiveness = 9;
+	CU_ASSERT(engine_rules_build(&base) == 0);
+	CU_ASSERT(watch_parse(path, &base, &r, why, sizeof(why)) == 0);
+	CU_ASSERT(r.tools[0].effectiveness == 9 && r.tools[1].effectiveness == 7);
+
+	watch_write(path, "fluoride = 300\n");
+	CU_ASSERT(watch_parse(path, &engine_rules, &r, why, sizeof(why)) == -1);
+	watch_write(path, "rock.dip = 99\n");
+	CU_ASSERT(watch_parse(path, &engine_rules, &r, why, sizeof(why)) == -1);
+	watch_write(path, "bonus.fang_cleaned 2\n");
+	CU_ASSERT(watch_parse(path, &engine_rules, &r, why, sizeof(why)) == -1);
+	watch_write(path, "rock.sharpness = 3\n");
+	CU_ASSERT(watch_parse(path, &engine_rules, &r, why, sizeof(why)) == -1);
+	CU_ASSERT(strcmp(why, "line 1: rock.sharpness: not a balance constant") == 0);
+
+	/* A game on the file's rules sees each good edit between strokes */
+	watch_write(path, "bonus.fang_cleaned = 2\n");
+	CU_ASSERT(watch_init(&w, path) == 0);
+	engine_live = &base;
+	CU_ASSERT(watch_start(&w) == 0);
+	CU_ASSERT(engine_live != &base && engine_live->bonus.fang_cleaned == 2);
+	CU_ASSERT(engine_live->tools[0].effectiveness == 9);
+	watch_stop(&w);
+	CU_ASSERT(engine_live == &base);
+	engine_live = &engine_rules;
+	CU_ASSERT(watch_init(&w, path) == 0);
+	CU_ASSERT(watch_start(&w) == 0);
+	CU_ASSERT(engine_live != &engine_rules && engine_live->bonus.fang_cleaned == 2);
+	free(watch_note(&w));
+
+	memset(&state, 0, sizeof(state));
+	state.tool_in_use = 1;
+	state.patient_idx = VAMPIRE;
+	watch_write(path, "bonus.fang_cleaned = 4\nrock.effectiveness = 0\n");
+	CU_ASSERT(watch_until(&w, 2));
+	CU_ASSERT(engine_live->bonus.fang_cleaned == 4);
+	CU_ASSERT(fang_health_gain(&state, 4, 6) == species_gain[VAMPIRE].bonus);
+	CU_ASSERT((note = watch_note(&w)) != NULL && strncmp(note, "Balance 2 loaded", 16) == 0);
+	free(note);
+
+	/* A bad edit leaves the rules in play alone */
+	watch_write(path, "rock.effectiveness = many\n");
+	for (int i = 0; i < 500 && (note = watch_note(&w)) == NULL; i++)
+		usleep(10000);
+	CU_ASSERT(note != NULL && strstr(note, "the balance is unchanged") != NULL);
+	free(note);
+	watch_quiesce(&w);
+	CU_ASSERT(engine_live->bonus.fang_cleaned == 4 && w.failures == 1);
+
+	watch_stop(&w);
+	CU_ASSERT(engine_live == &engine_rules && w.reloads == 2 && w.retired == NULL);
+	CU_ASSERT(fang_health_gain(&state, 4, 6) == fang_health_gain_formula(&state, 4, 6));
+	unlink(path);
+}
+
+void
+testCLINIC(void)
+{
+	static struct clinic_results one, again;
+	struct clinic_config cfg;
+
+	memset(&cfg, 0, sizeof(cfg));
+	cfg.patients = 20000;
+	cfg.hygienists = CLINIC_HYGIENISTS;
+	cfg.arrival_s = CLINIC_ARRIVAL_S;
+	cfg.stock = (long long)cfg.patients * DEFAULT_FLUORIDE * 10;
+	cfg.seed = 11;
+	clinic_run(&cfg, &one);
+	clinic_run(&cfg, &again);
+	one.elapsed = again.elapsed = 0;
+	CU_ASSERT(memcmp(&one, &again, sizeof(one)) == 0);
+
+	/* Everyone who came left one way or another */
+	CU_ASSERT(one.arrived == cfg.patients && one.exhausted_ms == -1 && one.unserved == 0);
+	CU_ASSERT(one.treated + one.gave_up + one.turned_away == one.arrived);
+	CU_ASSERT(one.seated == one.treated + one.gave_up && one.wait.count == (uint64_t)one.seated);
+	CU_ASSERT(one.treated > 0 && one.stay.count == (uint64_t)one.treated);
+	CU_ASSERT(one.events == one.arrived + one.strokes);
+	CU_ASSERT(one.busy_ms <= one.end_ms * (long long)cfg.hygienists + CLINIC_STROKE_S * 1000 * 16);
+
+	/* One hygienist and a patient a second fills the waiting room */
+	cfg.hygienists = 1;
+	cfg.arrival_s = 1;
+	cfg.patients = 1000;
+	clinic_run(&cfg, &one);
+	CU_ASSERT(one.turned_away > one.arrived / 2);
+
+	/* A small stock runs out, and no stroke draws past it */
+	cfg.hygienists = 8;
+	cfg.arrival_s = 60;
+	cfg.stock = 5000;
+	clinic_run(&cfg, &one);
+	CU_ASSERT(one.exhausted_ms >= 0 && one.exhausted_ms == one.end_ms);
+	CU_ASSERT(one.used <= cfg.stock && one.unserved > 0 && one.arrived < cfg.patients);
+}
+
+void
+testTUNE(void)
+{
+	static struct tune one, many;
+
+	tune_init(&one);
+	CU_ASSERT(tune_parse_targets(&one, "dragon=2") == -1);
+	CU_ASSERT(tune_parse_targets(&one, "hydra=0.5") == -1);
+	CU_ASSERT(tune_parse_params(&one, "rock.dip=0:99") == -1);
+	CU_ASSERT(tune_parse_params(&one, "rock.sharpness=1:5") == -1);
+	CU_ASSERT(one.nparams == 0);
+	CU_ASSERT(tune_parse_targets(&one, "Dragon=0.5,all=0.6") == 0);
+	CU_ASSERT(tune_parse_params(&one, "dragon.percent=30:100,fluoride=250:350") == 0);
+	CU_ASSERT(one.nparams == 2 && one.target[DRAGON] == 0.5 && one.target[TUNE_ALL] == 0.6);
+
+	one.candidates = 4;
+	many = one;
+	many.threads = 3;
+	rng_set_seed(3);
+	tune_run(&one);
+	tune_run(&many);
+	CU_ASSERT(memcmp(&one.best, &many.best, sizeof(one.best)) == 0);
+	CU_ASSERT(one.best_loss == many.best_loss);
+	CU_ASSERT(one.best_loss <= one.baseline_loss);
+	CU_ASSERT(one.best.fluoride >= 250 && one.best.fluoride <= 350);
+
+	/* The tree's own constants play like the engine does */
+	CU_ASSERT(fabs(one.baseline_win[TUNE_ALL] - 0.373) < 0.02);
+}
+
+void
+testBATCH_KERNELS(void)
+{
+	struct batch   *b = batch_new(BATCH_LANES);
+	struct batch_cell cell;
+	struct sim_results res;
+
+	CU_ASSERT(batch_check_kernels(NULL) == 0);
+
+	/* A Steel Dagger finishes any Vampire fang in one stroke */
+	batch_cell_init(&cell, 5, VAMPIRE);
+	batch_deal(b, &cell, 100, 0, NULL);
+	batch_play(b, BATCH_KERNEL_AUTO);
+	memset(&res, 0, sizeof(res));
+	batch_tally(b, &res);
+	CU_ASSERT(res.games == 100);
+	CU_ASSERT(res.wins == 100);
+	CU_ASSERT(res.turns_sum == 100 * (DEFAULT_TURNS + 1));
+	batch_free(b);
+}
+
 int
 main()
 {
@@ -269,7 +1394,33 @@ main()
 	    (NULL == CU_add_test(pSuite, "test validate game_file()", testVALIDATE_GAME_FILE)) ||
 	    (NULL == CU_add_test(pSuite, "test of return_concat_homedir()", testCONCAT_PATH)) ||
 	    (NULL == CU_add_test(pSuite, "test of all_fangs_healthy()", testALLFANGSHEALTHY)) ||
-	    (NULL == CU_add_test(pSuite, "test of patient_reaction()", testPATIENTREACTION))) {
+	    (NULL == CU_add_test(pSuite, "test of the dirty teeth bitset and heap", testDENTITION)) ||
+	    (NULL == CU_add_test(pSuite, "test of patient_reaction()", testPATIENTREACTION)) ||
+	    (NULL == CU_add_test(pSuite, "test of pool_run()", testPOOL_RUN)) ||
+	    (NULL == CU_add_test(pSuite, "test of the solver table", testSOLVER_TABLE)) ||
+	    (NULL == CU_add_test(pSuite, "test of the turn tables", testTABLES_VALIDATE)) ||
+	    (NULL == CU_add_test(pSuite, "test of the batch kernels", testBATCH_KERNELS)) ||
+	    (NULL == CU_add_test(pSuite, "test of the Philox streams", testRNG_PHILOX)) ||
+	    (NULL == CU_add_test(pSuite, "test of seed parsing", testRNG_PARSE_SEED)) ||
+	    (NULL == CU_add_test(pSuite, "test of seeded simulation", testSEEDED_SIMULATION)) ||
+	    (NULL == CU_add_test(pSuite, "test of replay recordings", testREPLAY)) ||
+	    (NULL == CU_add_test(pSuite, "test of the MCTS policy", testMCTS_POLICY)) ||
+	    (NULL == CU_add_test(pSuite, "test of packed states", testPACKED_STATE)) ||
+	    (NULL == CU_add_test(pSuite, "test of the exact analyzer", testANALYZE)) ||
+	    (NULL == CU_add_test(pSuite, "test of the balance sweep", testBALANCE_SWEEP)) ||
+	    (NULL == CU_add_test(pSuite, "test of the balance tuner", testTUNE)) ||
+	    (NULL == CU_add_test(pSuite, "test of the balance store", testBALANCE_STORE)) ||
+	    (NULL == CU_add_test(pSuite, "test of the result cache", testCACHE)) ||
+	    (NULL == CU_add_test(pSuite, "test of sharded sweeps", testSWEEP)) ||
+	    (NULL == CU_add_test(pSuite, "test of the policy tournament", testTOURNAMENT)) ||
+	    (NULL == CU_add_test(pSuite, "test of the step driven engine", testLIBBUFFY)) ||
+	    (NULL == CU_add_test(pSuite, "test of the what-if preview", testPREVIEW)) ||
+	    (NULL == CU_add_test(pSuite, "test of undo and redo", testHISTORY)) ||
+	    (NULL == CU_add_test(pSuite, "test of the timing wheel", testWHEEL)) ||
+	    (NULL == CU_add_test(pSuite, "test of the alias sampler", testALIAS)) ||
+	    (NULL == CU_add_test(pSuite, "test of rosters", testROSTER)) ||
+	    (NULL == CU_add_test(pSuite, "test of the balance file watcher", testWATCH)) ||
+	    (NULL == CU_add_test(pSuite, "test of the clinic simulator", testCLINIC))) {
 		CU_cleanup_registry();
 		return CU_get_error();
 	}
@@ -0,0 +1,463 @@
+/*
+ * BSD Zero Clause License
+ *
+ * Copyright (c) 2025 David M Crumpton david.m.crumpton [at] gmail [dot] com
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * watch.c: hot reloading of the balance constants. A thread waits on the
+ * balance file's directory (inotify, or kqueue where there is none),
+ * parses the file when it is written or renamed into place, builds the
+ * turn tables from it and publishes them with one atomic pointer swap.
+ * The game picks the newest rules up between strokes without a lock, so
+ * a turn reads one set of tables from start to end, and tells the watcher
+ * which generation it has moved to; rules the game can no longer be
+ * reading are freed on the watcher's side, as read-copy-update would.
+ *
+ */
+#include <sys/types.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#else
+#include <sys/event.h>
+#endif
+
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "buffy.h"
+#include "engine.h"
+#include "tables.h"
+#include "tune.h"
+#include "watch.h"
+
+/* The bonuses, which the tuner does not change */
+static const struct {
+	const char     *name;
+	size_t		offset;
+}		bonus_fields[] = {
+	{"bonus.fang_cleaned", offsetof(struct engine_bonus, fang_cleaned)},
+	{"bonus.fang_health", offsetof(struct engine_bonus, fang_health)},
+	{"bonus.turn_complete", offsetof(struct engine_bonus, turn_complete)},
+	{"bonus.all_health", offsetof(struct engine_bonus, all_health)},
+};
+
+#define BONUS_MAX	1000
+
+
+static int
+why_line(char *why, size_t why_len, int line, const char *fmt,...)
+{
+	va_list		ap;
+	int		n;
+
+	n = snprintf(why, why_len, "line %d: ", line);
+	va_start(ap, fmt);
+	vsnprintf(why + n, why_len > (size_t)n ? why_len - n : 0, fmt, ap);
+	va_end(ap);
+	return -1;
+}
+
+/* Strip leading and trailing blanks in place */
+static char    *
+trim(char *s)
+{
+	char	       *end;
+
+	while (*s == ' ' || *s == '\t')
+		s++;
+	end = s + strlen(s);
+	while (end > s && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\n' || end[-1] == '\r'))
+		*--end = '\0';
+	return s;
+}
+
+/*
+ * Read a balance file over the rules in base into r: "name = value" per
+ * line, where name is a tool or species constant as --tune-params names
+ * them or one of the bonus.* scores; "#" starts a comment. Constants the
+ * file leaves out keep their values from base. Returns -1 with the reason
+ * in why if the file cannot be used.
+ */
+int
+watch_parse(const char *path, const struct engine_rules * base, struct engine_rules * r, char *why, size_t why_len)
+{
+	struct tune_config cfg;
+	FILE	       *fp;
+	char	       *buf = NULL;
+	size_t		size = 0;
+	int		line = 0, rv = 0;
+
+	if ((fp = fopen(path, "r")) == NULL) {
+		snprintf(why, why_len, "%s", strerror(errno));
+		return -1;
+	}
+	*r = *base;
+	memcpy(cfg.tools, r->tools, sizeof(cfg.tools));
+	memcpy(cfg.species, r->species, sizeof(cfg.species));
+	while (rv == 0 && getline(&buf, &size, fp) != -1) {
+		char	       *name, *value, *end, *hash;
+		size_t		offset;
+		int		min = 0, max = 0, *field = NULL;
+		long		v;
+
+		line++;
+		if ((hash = strchr(buf, '#')) != NULL)
+			*hash = '\0';
+		name = trim(buf);
+		if (*name == '\0')
+			continue;
+		if ((value = strchr(name, '=')) == NULL) {
+			rv = why_line(why, why_len, line, "want name = value");
+			break;
+		}
+		*value++ = '\0';
+		name = trim(name);
+		value = trim(value);
+
+		for (size_t i = 0; i < sizeof(bonus_fields) / sizeof(bonus_fields[0]); i++)
+			if (strcmp(name, bonus_fields[i].name) == 0) {
+				field = (int *)((char *)&r->bonus + bonus_fields[i].offset);
+				max = BONUS_MAX;
+			}
+		if (field == NULL && strcmp(name, "fluoride") == 0) {
+			rv = why_line(why, why_len, line, "fluoride is dealt before play, not a turn rule");
+			break;
+		}
+		if (field == NULL && tune_lookup(name, &offset, &min, &max) == 0)
+			field = (int *)((char *)&cfg + offset);
+		if (field == NULL) {
+			rv = why_line(why, why_len, line, "%s: not a balance constant", name);
+			break;
+		}
+		v = strtol(value, &end, 10);
+		if (end == value || *end != '\0' || v < min || v > max) {
+			rv = why_line(why, why_len, line, "%s must be a number from %d to %d", name, min, max);
+			break;
+		}
+		*field = (int)v;
+	}
+	if (rv == 0 && ferror(fp)) {
+		snprintf(why, why_len, "%s", strerror(errno));
+		rv = -1;
+	}
+	free(buf);
+	fclose(fp);
+	if (rv == -1)
+		return -1;
+
+	memcpy(r->tools, cfg.tools, sizeof(r->tools));
+	memcpy(r->species, cfg.species, sizeof(r->species));
+	if (engine_rules_build(r) == -1) {
+		snprintf(why, why_len, "a tool does not fit the turn tables");
+		return -1;
+	}
+	return 0;
+}
+
+/* Hand the game a message, dropping one it has not printed yet */
+static void
+post(struct watch * w, const char *fmt,...)
+{
+	va_list		ap;
+	char		msg[PATH_MAX + 256];
+
+	va_start(ap, fmt);
+	vsnprintf(msg, sizeof(msg), fmt, ap);
+	va_end(ap);
+	free(atomic_exchange(&w->note, strdup(msg)));
+}
+
+/* Free the retired rules the game has moved past */
+static void
+reap(struct watch * w)
+{
+	unsigned long	seen = atomic_load_explicit(&w->seen, memory_order_acquire);
+	struct watch_rules **pp = &w->retired;
+
+	while (*pp != NULL) {
+		struct watch_rules *old = *pp;
+
+		if (old->freeable <= seen) {
+			*pp = old->retired;
+			free(old);
+		} else
+			pp = &old->retired;
+	}
+}
+
+/* Parse the file and publish what it says, or post why not */
+static int
+reload(struct watch * w)
+{
+	struct watch_rules *next, *old;
+	struct timespec	start, end;
+	char		why[256];
+
+	if ((next = malloc(sizeof(*next))) == NULL) {
+		post(w, "%s: %s", w->path, strerror(errno));
+		return -1;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if (watch_parse(w->path, w->base, &next->rules, why, sizeof(why)) == -1) {
+		free(next);
+		w->failures++;
+		post(w, "%s: %s; the balance is unchanged", w->path, why);
+		return -1;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	next->generation = ++w->generation;
+	next->freeable = 0;
+	next->retired = NULL;
+
+	old = atomic_exchange_explicit(&w->published, next, memory_order_acq_rel);
+	if (old != NULL) {
+		/* The game may be on it until it says it has seen next */
+		old->freeable = next->generation;
+		old->retired = w->retired;
+		w->retired = old;
+	}
+	w->reloads++;
+	post(w, "Balance %lu loaded from %s in %.2f ms.", next->generation, w->path,
+	     (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6);
+	reap(w);
+	return 0;
+}
+
+#ifdef __linux__
+static int
+watch_open(struct watch * w)
+{
+	if ((w->fd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK)) == -1)
+		return -1;
+	/* The directory, so a file renamed into place is seen too */
+	if (inotify_add_watch(w->fd, w->dir, IN_CLOSE_WRITE | IN_MOVED_TO) == -1) {
+		close(w->fd);
+		return -1;
+	}
+	return 0;
+}
+
+/* Wait for a change, or WATCH_REAP_MS. Returns 1 if the file changed. */
+static int
+watch_wait(struct watch * w)
+{
+	struct pollfd	pfd[2] = {{w->fd, POLLIN, 0}, {w->stop[0], POLLIN, 0}};
+	char		buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	ssize_t		n;
+	int		changed = 0;
+
+	if (poll(pfd, 2, WATCH_REAP_MS) <= 0 || pfd[1].revents != 0)
+		return pfd[1].revents != 0 ? -1 : 0;
+	while ((n = read(w->fd, buf, sizeof(buf))) > 0)
+		for (char *p = buf; p < buf + n;) {
+			struct inotify_event *ev = (struct inotify_event *)p;
+
+			if (ev->len > 0 && strcmp(ev->name, w->name) == 0)
+				changed = 1;
+			p += sizeof(*ev) + ev->len;
+		}
+	return changed;
+}
+#else
+static int
+watch_open(struct watch * w)
+{
+	struct kevent	ev[2];
+
+	if ((w->fd = kqueue()) == -1)
+		return -1;
+	/* The directory is written when a file is renamed into place */
+	if ((w->dirfd = open(w->dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) == -1) {
+		close(w->fd);
+		return -1;
+	}
+	EV_SET(&ev[0], w->dirfd, EVFILT_VNODE, EV_ADD | EV_CLEAR, NOTE_WRITE, 0, NULL);
+	EV_SET(&ev[1], w->stop[0], EVFILT_READ, EV_ADD, 0, 0, NULL);
+	if (kevent(w->fd, ev, 2, NULL, 0, NULL) == -1) {
+		close(w->dirfd);
+		close(w->fd);
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Wait for a change, or WATCH_REAP_MS. The file itself is watched from
+ * one open to the next, so a write in place is seen as well as a rename.
+ * Returns 1 if the file may have changed.
+ */
+static int
+watch_wait(struct watch * w)
+{
+	struct timespec	ts = {WATCH_REAP_MS / 1000, WATCH_REAP_MS % 1000 * 1000000L};
+	struct kevent	ev;
+	int		n;
+
+	if (w->filefd == -1 && (w->filefd = open(w->path, O_RDONLY | O_CLOEXEC)) != -1) {
+		EV_SET(&ev, w->filefd, EVFILT_VNODE, EV_ADD | EV_CLEAR,
+		       NOTE_WRITE | NOTE_EXTEND | NOTE_DELETE | NOTE_RENAME, 0, NULL);
+		kevent(w->fd, &ev, 1, NULL, 0, NULL);
+	}
+	if ((n = kevent(w->fd, NULL, 0, &ev, 1, &ts)) <= 0)
+		return 0;
+	if ((int)ev.ident == w->stop[0])
+		return -1;
+	if ((int)ev.ident == w->filefd && (ev.fflags & (NOTE_DELETE | NOTE_RENAME))) {
+		close(w->filefd);	/* and the kevent with it */
+		w->filefd = -1;
+	}
+	return 1;
+}
+#endif
+
+static void    *
+watcher(void *arg)
+{
+	struct watch   *w = arg;
+	int		changed;
+
+	while ((changed = watch_wait(w)) != -1) {
+		if (changed)
+			reload(w);
+		else
+			reap(w);
+	}
+	return NULL;
+}
+
+/* Check the file can be used before the game starts */
+int
+watch_init(struct watch * w, const char *path)
+{
+	struct engine_rules *r;
+	char		why[256], *slash;
+	int		rv;
+
+	memset(w, 0, sizeof(*w));
+	w->fd = w->dirfd = w->filefd = -1;
+	if (strlcpy(w->path, path, sizeof(w->path)) >= sizeof(w->path)) {
+		warnx("%s: name too long", path);
+		return -1;
+	}
+	strlcpy(w->dir, path, sizeof(w->dir));
+	if ((slash = strrchr(w->dir, '/')) == NULL) {
+		strlcpy(w->dir, ".", sizeof(w->dir));
+		w->name = w->path;
+	} else {
+		*slash = '\0';
+		if (slash == w->dir)
+			strlcpy(w->dir, "/", sizeof(w->dir));
+		w->name = w->path + (slash - w->dir) + 1;
+	}
+	if ((r = malloc(sizeof(*r))) == NULL)
+		err(1, "watch");
+	if ((rv = watch_parse(w->path, engine_live, r, why, sizeof(why))) == -1)
+		warnx("%s: %s", w->path, why);
+	free(r);
+	return rv;
+}
+
+/*
+ * Put the file's rules in play and watch it for changes. Takes the rules
+ * as they are now for the built-in ones, so call it once the game is
+ * dealt, from the thread that plays it.
+ */
+int
+watch_start(struct watch * w)
+{
+	w->base = engine_live;
+	if (reload(w) == -1) {
+		char	       *why = watch_note(w);
+
+		warnx("%s", why != NULL ? why : w->path);
+		free(why);
+		return -1;
+	}
+	watch_quiesce(w);
+	if (pipe(w->stop) == -1) {
+		warn("watch");
+		return -1;
+	}
+	if (watch_open(w) == -1) {
+		warn("%s", w->dir);
+		return -1;
+	}
+	if (pthread_create(&w->thread, NULL, watcher, w) != 0) {
+		warnx("watch: cannot start the watcher");
+		return -1;
+	}
+	w->running = 1;
+	return 0;
+}
+
+/*
+ * Move the game to the newest rules. Call between strokes from the thread
+ * that plays the game: once it returns, the game reads nothing older.
+ */
+void
+watch_quiesce(struct watch * w)
+{
+	struct watch_rules *p = atomic_load_explicit(&w->published, memory_order_acquire);
+
+	if (p == NULL)
+		return;
+	engine_live = &p->rules;
+	atomic_store_explicit(&w->seen, p->generation, memory_order_release);
+}
+
+/* The watcher's latest message for the game, to free, or NULL */
+char	       *
+watch_note(struct watch * w)
+{
+	return atomic_exchange(&w->note, NULL);
+}
+
+/* Stop watching and go back to the rules the game started on */
+void
+watch_stop(struct watch * w)
+{
+	struct watch_rules *p;
+
+	if (w->running) {
+		if (write(w->stop[1], "", 1) == -1)
+			warn("watch");
+		pthread_join(w->thread, NULL);
+		close(w->fd);
+		if (w->dirfd != -1)
+			close(w->dirfd);
+		if (w->filefd != -1)
+			close(w->filefd);
+		close(w->stop[0]);
+		close(w->stop[1]);
+		w->running = 0;
+	}
+	engine_live = w->base != NULL ? w->base : &engine_rules;
+	atomic_store(&w->seen, w->generation);
+	reap(w);
+	if ((p = atomic_exchange(&w->published, NULL)) != NULL)
+		free(p);
+	free(watch_note(w));
+}
@@ -0,0 +1,80 @@
+/*
+ * BSD Zero Clause License
+ *
+ * Copyright (c) 2025 David M Crumpton david.m.crumpton [at] gmail [dot] com
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * watch.h: the balance constants read from a file while a game is played,
+ * and read again whenever the file changes
+ *
+ */
+
+#ifndef WATCH_H
+#define WATCH_H
+
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+
+#include "tables.h"
+
+#define WATCH_REAP_MS	1000	/* between looks for rules nobody reads */
+
+/* One published set of rules, and the older ones it retired */
+struct watch_rules {
+	struct engine_rules rules;
+	unsigned long	generation;
+	unsigned long	freeable;	/* once the game has seen this generation */
+	struct watch_rules *retired;
+};
+
+struct watch {
+	char		path[PATH_MAX];
+	char		dir[PATH_MAX];
+	const char     *name;	/* of the file in dir */
+
+	/*
+	 * The watcher publishes, the game moves engine_live to the newest
+	 * rules between strokes and says which generation it is on. Neither
+	 * waits for the other.
+	 */
+	_Atomic(struct watch_rules *) published;
+	_Atomic unsigned long seen;
+	_Atomic(char *) note;	/* for the game to print, then free */
+
+	/* The watcher's own */
+	const struct engine_rules *base;	/* what the file is read over */
+	struct watch_rules *retired;
+	unsigned long	generation;
+	int		fd;	/* inotify or kqueue */
+	int		dirfd;	/* kqueue: the directory */
+	int		filefd;	/* kqueue: the file, while it is there */
+	int		stop[2];
+	pthread_t	thread;
+	int		running;
+	long		reloads;
+	long		failures;
+};
+
+int		watch_parse(const char *path, const struct engine_rules * base, struct engine_rules * r,
+		    char *why, size_t why_len);
+int		watch_init(struct watch * w, const char *path);
+int		watch_start(struct watch * w);
+void		watch_quiesce(struct watch * w);
+char	       *watch_note(struct watch * w);
+void		watch_stop(struct watch * w);
+
+#endif				/* WATCH_H */
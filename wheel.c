@@ -0,0 +1,152 @@
+/*
+ * BSD Zero Clause License
+ *
+ * Copyright (c) 2025 David M Crumpton david.m.crumpton [at] gmail [dot] com
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * wheel.c: the timing wheel. Tick n is due at start_ns + n * tick_ns;
+ * wheel_run() catches up on every tick that is due, so a late wakeup
+ * delays timers but never loses them.
+ *
+ */
+#include <string.h>
+#include <time.h>
+
+#include "sketch.h"
+#include "wheel.h"
+
+
+uint64_t
+wheel_clock(void)
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void
+list_init(struct wheel_timer * head)
+{
+	head->next = head->prev = head;
+}
+
+static void
+list_insert(struct wheel_timer * head, struct wheel_timer * t)
+{
+	t->prev = head->prev;
+	t->next = head;
+	head->prev->next = t;
+	head->prev = t;
+}
+
+static void
+list_remove(struct wheel_timer * t)
+{
+	t->prev->next = t->next;
+	t->next->prev = t->prev;
+	t->next = t->prev = NULL;
+}
+
+void
+wheel_init(struct wheel * w, uint64_t tick_ns)
+{
+	memset(w, 0, sizeof(*w));
+	for (int i = 0; i < WHEEL_SLOTS; i++)
+		list_init(&w->slot[i]);
+	list_init(&w->due);
+	w->tick_ns = tick_ns;
+	w->start_ns = wheel_clock();
+}
+
+static void
+wheel_link(struct wheel * w, struct wheel_timer * t)
+{
+	list_insert(&w->slot[t->expires & (WHEEL_SLOTS - 1)], t);
+	w->active++;
+}
+
+/*
+ * Fire fn(arg) delay_ns from the tick now running, rounded up to whole
+ * ticks and at least one, then every period_ns if that is not 0. t must
+ * not be pending.
+ */
+void
+wheel_add(struct wheel * w, struct wheel_timer * t, uint64_t delay_ns, uint64_t period_ns,
+	  void (*fn) (void *), void *arg)
+{
+	uint64_t	ticks = (delay_ns + w->tick_ns - 1) / w->tick_ns;
+
+	t->expires = w->tick + (ticks ? ticks : 1);
+	t->period = (period_ns + w->tick_ns - 1) / w->tick_ns;
+	t->fn = fn;
+	t->arg = arg;
+	wheel_link(w, t);
+}
+
+/* Stop t if it is pending, even from a timer of the same tick */
+void
+wheel_cancel(struct wheel * w, struct wheel_timer * t)
+{
+	if (!wheel_pending(t))
+		return;
+	list_remove(t);
+	w->active--;
+}
+
+/* When the next tick is due, on wheel_clock() */
+uint64_t
+wheel_next(const struct wheel * w)
+{
+	return w->start_ns + (w->tick + 1) * w->tick_ns;
+}
+
+/* Run every tick due by now_ns. Returns the timers fired. */
+int
+wheel_run(struct wheel * w, uint64_t now_ns)
+{
+	int		fired = 0;
+
+	while (wheel_next(w) <= now_ns) {
+		struct wheel_timer *head = &w->slot[++w->tick & (WHEEL_SLOTS - 1)], *t, *next;
+
+		sketch_add(&w->late, (long)(now_ns - (w->start_ns + w->tick * w->tick_ns)));
+
+		/*
+		 * Move this tick's timers aside first, so a timer may add or
+		 * cancel any other, this slot's included
+		 */
+		for (t = head->next; t != head; t = next) {
+			next = t->next;
+			if (t->expires != w->tick)
+				continue;
+			list_remove(t);
+			list_insert(&w->due, t);
+		}
+		while ((t = w->due.next) != &w->due) {
+			list_remove(t);
+			w->active--;
+			if (t->period) {
+				t->expires = w->tick + t->period;
+				wheel_link(w, t);
+			}
+			t->fn(t->arg);
+			fired++;
+		}
+	}
+	w->fired += fired;
+	w->work_ns += wheel_clock() - now_ns;
+	return fired;
+}
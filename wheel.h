@@ -0,0 +1,74 @@
+/*
+ * BSD Zero Clause License
+ *
+ * Copyright (c) 2025 David M Crumpton david.m.crumpton [at] gmail [dot] com
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * wheel.h: a hashed timing wheel on the monotonic clock, for the timers of
+ * real time play
+ *
+ */
+
+#ifndef WHEEL_H
+#define WHEEL_H
+
+#include <stdint.h>
+
+#include "sketch.h"
+
+#define WHEEL_SLOTS	256	/* a power of 2 */
+
+/*
+ * Timers are linked into the slot of the tick they expire on, modulo
+ * WHEEL_SLOTS, so adding and cancelling take constant time and a tick
+ * looks at one slot. A timer further out than a turn of the wheel waits in
+ * its slot until its own tick comes round.
+ */
+struct wheel_timer {
+	struct wheel_timer *next;
+	struct wheel_timer *prev;
+	uint64_t	expires;	/* tick */
+	uint64_t	period;		/* ticks, 0 to fire once */
+	void		(*fn) (void *arg);
+	void	       *arg;
+};
+
+struct wheel {
+	struct wheel_timer slot[WHEEL_SLOTS];	/* list heads */
+	struct wheel_timer due;	/* the timers of the tick being run */
+	uint64_t	start_ns;
+	uint64_t	tick_ns;
+	uint64_t	tick;	/* ticks run */
+	long		active;
+	uint64_t	fired;
+	uint64_t	work_ns;	/* spent in wheel_run() */
+	struct sketch	late;	/* ns each tick ran past its time */
+};
+
+uint64_t	wheel_clock(void);
+void		wheel_init(struct wheel * w, uint64_t tick_ns);
+void		wheel_add(struct wheel * w, struct wheel_timer * t, uint64_t delay_ns, uint64_t period_ns,
+			  void (*fn) (void *), void *arg);
+void		wheel_cancel(struct wheel * w, struct wheel_timer * t);
+uint64_t	wheel_next(const struct wheel * w);
+int		wheel_run(struct wheel * w, uint64_t now_ns);
+
+static inline int
+wheel_pending(const struct wheel_timer * t)
+{
+	return t->next != NULL;
+}
+
+#endif				/* WHEEL_H */